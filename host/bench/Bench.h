@@ -0,0 +1,70 @@
+// Shared by the benches: argument handling, checks, and running a device's loop() on the virtual clock
+#ifndef HOST_BENCH_H
+#define HOST_BENCH_H
+
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+#include "HostSupport.h"
+
+namespace bench {
+
+// --quick runs fewer iterations, for ctest
+inline bool quick(int argc, char **argv) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--quick") == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int &failures();
+
+inline bool check(bool condition, const char *what) {
+	if (!condition) {
+		printf("FAIL: %s\n", what);
+		failures()++;
+	}
+	return condition;
+}
+
+// Calls step every stepMs of virtual time until done() or timeoutMs has passed. Returns done().
+inline bool runUntil(std::function<void()> step, std::function<bool()> done, unsigned long timeoutMs, unsigned long stepMs = 10) {
+	for (unsigned long waited = 0; !done() && waited < timeoutMs; waited += stepMs) {
+		step();
+		host::advance(stepMs);
+	}
+	return done();
+}
+
+// Allocations and bytes between construction and delta()
+class HeapDelta {
+public:
+	HeapDelta() : _start(host::heap()) {
+	}
+	uint64_t allocations() const {
+		return host::heap().allocations - _start.allocations;
+	}
+	long bytes() const {
+		return (long)host::heap().current - (long)_start.current;
+	}
+
+private:
+	host::HeapStats _start;
+};
+
+inline int finish(const char *name) {
+	if (failures() == 0) {
+		printf("%s: ok\n", name);
+		return 0;
+	}
+	printf("%s: %d failed\n", name, failures());
+	return 1;
+}
+
+}
+
+#define BENCH_MAIN_STATE namespace bench { int &failures() { static int count = 0; return count; } }
+
+#endif
@@ -0,0 +1,168 @@
+// Captive DNS over real UDP sockets on the loopback: bursts of phone probe queries answered by
+// CaptiveDNSServer and by the stock DNSServer. Prints queries/s and allocations per query while
+// draining, and how many loop() passes each takes to answer a burst that arrived between two. On
+// the host the socket calls dominate the draining rate; on a device the loop() passes do, so the
+// rate at a 10 ms loop() is what a phone sees.
+#include <AsyncWiFiManager.h>
+#include <CaptiveDNSServer.h>
+#include <DNSServer.h>
+#include <chrono>
+#include <lwip/sockets.h>
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+static const char *const PROBES[] = {
+	"connectivitycheck.gstatic.com", "www.google.com", "captive.apple.com", "www.apple.com",
+	"www.msftconnecttest.com", "dns.msftncsi.com", "detectportal.firefox.com", "nmcheck.gnome.org"
+};
+
+// A phone: sends A queries for the probe hosts and checks the answers point at the portal
+class Client {
+public:
+	Client(uint16_t port) {
+		_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		memset(&_server, 0, sizeof(_server));
+		_server.sin_family = AF_INET;
+		_server.sin_port = htons(port);
+		_server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	}
+	~Client() {
+		close(_socket);
+	}
+
+	void send(int count) {
+		for (int i = 0; i < count; i++) {
+			uint8_t query[64] = { (uint8_t)(_id >> 8), (uint8_t)_id, 0x01, 0, 0, 1, 0, 0, 0, 0, 0, 0 };
+			_id++;
+			size_t length = 12;
+			const char *name = PROBES[i % (sizeof(PROBES) / sizeof(PROBES[0]))];
+			while (*name != 0) {
+				const char *dot = strchr(name, '.');
+				size_t label = dot != NULL ? dot - name : strlen(name);
+				query[length++] = label;
+				memcpy(query + length, name, label);
+				length += label;
+				name += label + (dot != NULL ? 1 : 0);
+			}
+			const uint8_t question[] = { 0, 0, 1, 0, 1 };	// Root, type A, class IN
+			memcpy(query + length, question, sizeof(question));
+			length += sizeof(question);
+			sendto(_socket, query, length, 0, (struct sockaddr *)&_server, sizeof(_server));
+		}
+	}
+
+	// Answers waiting, counting those that aren't one A record with the portal address as wrong
+	int receive() {
+		int count = 0;
+		uint8_t answer[512];
+		int size;
+		while ((size = recv(_socket, answer, sizeof(answer), MSG_DONTWAIT)) > 0) {
+			count++;
+			if (size < 16 || answer[7] != 1 || memcmp(answer + size - 4, PORTAL, 4) != 0) {
+				wrong++;
+			}
+		}
+		return count;
+	}
+
+	int wrong = 0;
+	static const uint8_t PORTAL[4];
+
+private:
+	int _socket;
+	struct sockaddr_in _server;
+	uint16_t _id = 1;
+};
+
+const uint8_t Client::PORTAL[4] = { 192, 168, 4, 1 };
+
+class Result {
+public:
+	double queriesPerSecond;
+	double allocations;			// Per query
+	int passes;					// loop() passes to answer one burst
+};
+
+// Runs bursts of burst queries through the server, process() being what one loop() pass does
+static Result run(uint16_t port, int bursts, int burst, std::function<int()> process) {
+	Result result;
+	Client client(port);
+	double micros = 0;
+	int answered = 0;
+	bench::HeapDelta delta;
+	for (int i = 0; i < bursts; i++) {
+		client.send(burst);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int pending = burst; pending > 0; ) {
+			pending -= process();
+		}
+		micros += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		answered += client.receive();
+	}
+	result.queriesPerSecond = bursts * burst / (micros / 1e6);
+	result.allocations = (double)delta.allocations() / (bursts * burst);
+
+	client.send(burst);
+	result.passes = 0;
+	for (int pending = burst; pending > 0; result.passes++) {
+		pending -= process();
+	}
+	answered += client.receive();
+
+	bench::check(answered == (bursts + 1) * burst && client.wrong == 0, "every query answered with the portal");
+	return result;
+}
+
+// A port of our own, so that parallel runs don't collide
+template<typename Start>
+static uint16_t bindPort(Start start) {
+	for (uint16_t port = 15353 + getpid() % 1000; port < 65000; port += 1000) {
+		if (start(port)) {
+			return port;
+		}
+	}
+	return 0;
+}
+
+static double atLoopRate(const Result &result, int burst) {
+	return (double)burst / result.passes * 100;
+}
+
+static void report(const char *what, const Result &result, int burst) {
+	printf("  %-16s %8.0f queries/s draining  %5.2f allocations/query  %3d passes for %d queries, %5.0f queries/s at a 10 ms loop()\n",
+			what, result.queriesPerSecond, result.allocations, result.passes, burst, atLoopRate(result, burst));
+}
+
+int main(int argc, char **argv) {
+	int bursts = bench::quick(argc, argv) ? 20 : 2000;
+	const int burst = 40;	// A few phones probing at once
+	IPAddress portal(192, 168, 4, 1);
+
+	CaptiveDNSServer captive;
+	uint16_t captivePort = bindPort([&](uint16_t port) { return captive.start(port, portal, 60); });
+	bench::check(captivePort != 0, "CaptiveDNSServer started");
+	Result captiveResult = run(captivePort, bursts, burst, [&]() {
+		return captive.processRequests(WIFI_MANAGER_DNS_BATCH);
+	});
+	captive.stop();
+
+	// The stock server answers one query per call and doesn't say whether there was one
+	DNSServer stock;
+	uint16_t stockPort = bindPort([&](uint16_t port) { return stock.start(port, "*", portal); });
+	bench::check(stockPort != 0, "DNSServer started");
+	Result stockResult = run(stockPort, bursts, burst, [&]() {
+		stock.processNextRequest();
+		return 1;
+	});
+	stock.stop();
+
+	printf("captive DNS, %d bursts of %d queries over loopback UDP:\n", bursts, burst);
+	report("DNSServer", stockResult, burst);
+	report("CaptiveDNSServer", captiveResult, burst);
+
+	bench::check(captiveResult.allocations == 0, "no allocations per query");
+	bench::check(captiveResult.passes < stockResult.passes, "a burst is drained in fewer loop() passes");
+	bench::check(atLoopRate(captiveResult, burst) >= WIFI_MANAGER_DNS_BATCH * 100 * 0.8, "close to a batch per loop() pass");
+	return bench::finish("dns_bench");
+}
@@ -0,0 +1,189 @@
+// Requests a phone makes for one setup, with the pages reloading themselves to poll and with
+// server-sent events: open /wifi, scan, save, and wait for the device to report the connection.
+// The browser follows meta refreshes, fetches each linked asset once and listens on /events when
+// the page loads the events script. Prints requests, bytes and how long the results took to show.
+#include <AsyncWiFiManager.h>
+#include <set>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+class Browser {
+public:
+	Browser(AsyncWebServer &server) : _server(server) {
+	}
+
+	int requests = 0;
+	size_t bytes = 0;
+	size_t messages = 0;
+	std::string page;
+	std::shared_ptr<host::EventClient> events;
+
+	void open(const char *url, const char *form = NULL) {
+		if (events) {
+			events->open = false;	// Leaving the page closes its stream
+			events.reset();
+		}
+		_refreshUrl.clear();
+
+		host::Response response = form != NULL ? host::post(_server, url, form) : host::fetch(_server, url);
+		requests++;
+		bytes += response.body.length();
+		page = response.body;
+		_messagesSeen = 0;
+
+		// Assets have versioned URLs, so they are fetched once
+		for (size_t at = page.find("\"/wm"); at != std::string::npos; at = page.find("\"/wm", at + 1)) {
+			std::string asset = page.substr(at + 1, page.find('"', at + 1) - at - 1);
+			if (_cached.insert(asset).second) {
+				requests++;
+				bytes += host::fetch(_server, asset.c_str()).body.length();
+			}
+			if (asset.compare(0, 7, "/wme.js") == 0) {
+				requests++;
+				events = host::fetch(_server, "/events").events;
+			}
+		}
+
+		size_t refresh = page.find("http-equiv=\"refresh\" content=\"");
+		if (refresh != std::string::npos) {
+			refresh += 30;
+			_refreshAt = millis() + 1000 * strtoul(page.c_str() + refresh, NULL, 10);
+			size_t url = page.find("url=", refresh) + 4;
+			_refreshUrl = page.substr(url, page.find('"', url) - url);
+		}
+	}
+
+	// The scan link: the events script fetches /api/scan instead of leaving the page
+	void tapScan() {
+		if (events) {
+			requests++;
+			bytes += host::fetch(_server, "/api/scan?scan=1").body.length();
+		} else {
+			open("/wifi?scan=1");
+		}
+	}
+
+	// Follows a due refresh and takes in the event messages that arrived
+	void tick() {
+		if (!_refreshUrl.empty() && millis() >= _refreshAt) {
+			std::string url = _refreshUrl;
+			open(url.c_str());
+		}
+		if (events) {
+			for (; _messagesSeen < events->messages.size(); _messagesSeen++) {
+				messages++;
+				bytes += events->messages[_messagesSeen].data.length();
+			}
+		}
+	}
+
+	// Whether the page, or an event it received, shows text
+	bool shows(const char *text) {
+		if (page.find(text) != std::string::npos) {
+			return true;
+		}
+		if (events) {
+			for (const host::EventClient::Message &message : events->messages) {
+				if (message.data.find(text) != std::string::npos) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+private:
+	AsyncWebServer &_server;
+	std::set<std::string> _cached;
+	std::string _refreshUrl;
+	unsigned long _refreshAt = 0;
+	size_t _messagesSeen = 0;
+};
+
+class Session {
+public:
+	int requests;
+	size_t bytes;
+	size_t messages;
+	unsigned long scanShownMs;		// Scan tapped to the network listed
+	unsigned long connectShownMs;	// Device connected to the page showing it
+};
+
+static Session run(bool events) {
+	Session session;
+	host::air().clear();
+	host::AccessPoint &router = host::air().add("HomeNet", "correct horse", -55, 6);
+	router.dhcpMs = 40000;		// A slow lease, so the info page has to wait for it
+	host::air().addNeighbours(10, 8);
+
+	host::Radio radio;		// A fresh device each run
+	host::Radio::select(&radio);
+	AsyncWebServer server(80);
+	DNSServer dns;
+	AsyncWiFiManager wm(&server, &dns);
+	wm.setAPCredentials("Clock-Setup", "");
+	wm.setConnectTimeout(1000);		// No credentials yet, straight to the portal
+	wm.setServerEvents(events);
+	wm.startAsync();
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.isAP(); }, 60000, 100);
+	bench::check(wm.isAP(), "portal up");
+	wm.setConnectTimeout(60000);
+	if (!events) {
+		// Turned on with the portal already up: there is no /events until it restarts, nor a link to it
+		wm.setServerEvents(true);
+		bench::check(host::fetch(server, "/wifi").body.find("/wme.js") == std::string::npos, "no events script without /events");
+		wm.setServerEvents(false);
+	}
+	host::air().accessPoints.front().up = false;	// Out of the first scan, so the results come from the one tapped
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return host::Radio::current().scans > 0; }, 10000, 100);
+	bench::runUntil([&]() { wm.loop(); }, []() { return false; }, host::Radio::current().scanMs + 500, 100);
+	host::air().accessPoints.front().up = true;
+
+	Browser browser(server);
+	browser.open("/wifi");
+	bench::check(!browser.shows("HomeNet"), "network not in the first scan");
+
+	unsigned long tapped = millis();
+	browser.tapScan();
+	bench::runUntil([&]() { wm.loop(); browser.tick(); }, [&]() { return browser.shows("HomeNet"); }, 30000, 100);
+	session.scanShownMs = millis() - tapped;
+	bench::check(browser.shows("HomeNet"), "scan result shown");
+
+	browser.open("/wifisave", "s=HomeNet&p=correct+horse");
+	bench::runUntil([&]() { wm.loop(); browser.tick(); }, [&]() { return WiFi.isConnected(); }, 60000, 100);
+	bench::check(WiFi.isConnected(), "device connected");
+	unsigned long connected = millis();
+	std::function<bool()> shown = [&]() {
+		return browser.shows("<dt>Station IP</dt><dd id='ip'>192.168.") || browser.shows("\"connected\":true");
+	};
+	bench::runUntil([&]() { wm.loop(); browser.tick(); }, shown, 30000, 100);
+	session.connectShownMs = millis() - connected;
+	bench::check(shown(), "connection shown");
+
+	session.requests = browser.requests;
+	session.bytes = browser.bytes;
+	session.messages = browser.messages;
+	host::Radio::select(NULL);
+	return session;
+}
+
+static void report(const char *what, const Session &session) {
+	printf("  %-14s %3d requests %3zu events %7zu bytes   scan shown after %5.1f s, connection after %5.1f s\n", what,
+			session.requests, session.messages, session.bytes, session.scanShownMs / 1000.0, session.connectShownMs / 1000.0);
+}
+
+int main(int argc, char **argv) {
+	bench::quick(argc, argv);
+
+	Session polling = run(false);
+	Session events = run(true);
+	printf("one setup: open /wifi, scan, save, wait for the connection (40 s DHCP):\n");
+	report("meta refresh", polling);
+	report("events", events);
+
+	bench::check(events.requests < polling.requests, "fewer requests with events");
+	bench::check(events.scanShownMs < polling.scanShownMs, "scan results shown sooner with events");
+	return bench::finish("events_bench");
+}
@@ -0,0 +1,60 @@
+// Boot to connected with setFastReconnect(): a cold boot with nothing in RTC memory, a warm boot
+// that reuses the cached AP, channel and lease, and a warm boot after the router was replaced, so
+// the cached BSSID is stale and the device has to fall back to the normal connect. Prints the time
+// from startAsync() to connected for each, and checks that the fallback refreshes the cache.
+#include <AsyncWiFiManager.h>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+/** A boot of the device, the RTC cache of the library surviving from the previous one. 0 if it didn't connect. */
+static unsigned long boot(unsigned long &begins) {
+	host::Radio radio;
+	host::Radio::select(&radio);
+	AsyncWebServer server(80);
+	DNSServer dns;
+	AsyncWiFiManager wm(&server, &dns);
+	wm.setRouterCredentials("HomeNet", "correct horse");
+	wm.setConnectTimeout(10000);
+	wm.setFastReconnect(true);
+
+	unsigned long started = millis();
+	wm.startAsync();
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.getStartState() != AsyncWiFiManager::START_CONNECTING; }, 15000, 5);
+	unsigned long took = wm.getStartState() == AsyncWiFiManager::START_CONNECTED ? millis() - started : 0;
+	begins = radio.begins;
+
+	// Let it settle, so that the lease is cached before the next boot
+	bench::runUntil([&]() { wm.loop(); }, []() { return false; }, 100);
+	host::Radio::select(NULL);
+	return took;
+}
+
+int main(int argc, char **argv) {
+	bench::quick(argc, argv);
+	host::air().add("HomeNet", "correct horse", -55, 6);
+	host::air().addNeighbours(20, 15);
+
+	unsigned long coldBegins, warmBegins, staleBegins, afterBegins;
+	unsigned long cold = boot(coldBegins);
+	unsigned long warm = boot(warmBegins);
+
+	// The router is swapped for one with another BSSID on another channel
+	host::air().clear();
+	host::air().add("HomeNet", "correct horse", -55, 11);
+	host::air().addNeighbours(20, 15);
+	unsigned long stale = boot(staleBegins);
+	unsigned long after = boot(afterBegins);
+
+	printf("startAsync() to connected:\n");
+	printf("  cold boot, nothing cached     %5lu ms, %lu begin()\n", cold, coldBegins);
+	printf("  warm boot, cached AP          %5lu ms, %lu begin()\n", warm, warmBegins);
+	printf("  warm boot, stale BSSID        %5lu ms, %lu begin()\n", stale, staleBegins);
+	printf("  the boot after the fallback   %5lu ms, %lu begin()\n", after, afterBegins);
+	bench::check(cold > 0 && warm > 0 && stale > 0 && after > 0, "connected on every boot");
+	bench::check(warm < cold, "warm boot faster than cold");
+	bench::check(stale >= WIFI_MANAGER_FAST_CONNECT_TIMEOUT && staleBegins == 2, "stale BSSID falls back to the normal connect");
+	bench::check(after == warm, "fallback caches the new AP");
+	return bench::finish("fastconnect_bench");
+}
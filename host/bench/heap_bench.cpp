@@ -0,0 +1,79 @@
+// Peak heap while serving /wifi, buffered in an AsyncResponseStream and as a chunked render, as the
+// page grows with the number of parameters. The buffered peak follows the page length, the chunked
+// one should stay at about the send window whatever the page length.
+#include <AsyncWiFiManager.h>
+#include <vector>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+class Peak {
+public:
+	size_t page;
+	size_t buffered;
+	size_t chunked;
+};
+
+static size_t peak(AsyncWebServer &server, int iterations, size_t &length) {
+	size_t worst = 0;
+	for (int i = 0; i < iterations; i++) {
+		host::resetPeak();
+		size_t before = host::heap().current;
+		host::Response response = host::fetch(server, "/wifi");
+		length = response.body.length();
+		worst = std::max(worst, host::heap().peak - before);
+	}
+	return worst;
+}
+
+int main(int argc, char **argv) {
+	int iterations = bench::quick(argc, argv) ? 3 : 50;
+
+	host::air().add("HomeNet", "correct horse", -55, 6);
+	host::air().addNeighbours(WIFI_MANAGER_MAX_SCAN_RESULTS, WIFI_MANAGER_MAX_SCAN_RESULTS);
+	host::Radio::current().rssiJitter = 0;
+
+	AsyncWebServer server(80);
+	DNSServer dns;
+	AsyncWiFiManager wm(&server, &dns);
+	wm.setAPCredentials("Clock-Setup", "");
+	wm.startAsync();
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.isAP(); }, 5000);
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return host::Radio::current().scans > 0; }, 10000, 100);
+	bench::runUntil([&]() { wm.loop(); }, []() { return false; }, host::Radio::current().scanMs + 500, 100);
+	bench::check(host::fetch(server, "/wifi").body.find("HomeNet") != std::string::npos, "portal up with the scan");
+
+	// Parameters live as long as the program
+	static char ids[64][8];
+	const int counts[] = { 0, 8, 24, 64 };
+	std::vector<Peak> peaks;
+	int added = 0;
+	for (int count : counts) {
+		for (; added < count; added++) {
+			snprintf(ids[added], sizeof(ids[added]), "p%d", added);
+			wm.addParameter(new AsyncWiFiManagerParameter(ids[added], "A setting with a long description", "its value, also quite long", 40));
+		}
+
+		Peak result;
+		wm.setChunkedPages(false);
+		result.buffered = peak(server, iterations, result.page);
+		wm.setChunkedPages(true);
+		result.chunked = peak(server, iterations, result.page);
+		peaks.push_back(result);
+	}
+
+	printf("/wifi with %d networks, peak heap per request:\n", WIFI_MANAGER_MAX_SCAN_RESULTS);
+	printf("  %10s %8s  %14s %14s\n", "parameters", "bytes", "buffered", "chunked");
+	for (size_t i = 0; i < peaks.size(); i++) {
+		printf("  %10d %8zu  %14zu %14zu\n", counts[i], peaks[i].page, peaks[i].buffered, peaks[i].chunked);
+	}
+	printf("  send window %zu bytes\n", host::sendWindow);
+
+	const Peak &smallest = peaks.front();
+	const Peak &largest = peaks.back();
+	bench::check(largest.chunked < largest.buffered, "chunked peak below the buffered one");
+	bench::check(largest.buffered - smallest.buffered > (largest.page - smallest.page) / 2, "buffered peak follows the page");
+	bench::check(largest.chunked < smallest.chunked + 1024, "chunked peak doesn't follow the page");
+	return bench::finish("heap_bench");
+}
@@ -0,0 +1,136 @@
+// A herd of devices on one router that reboots: each device loses it after the beacon timeout and
+// retries until it is back. Prints the attempts the router sees per 10 s, from the outage on, with
+// the fixed 10 s retry and with exponential backoff and jitter, the busiest second once it is back,
+// and how long until the whole herd is connected again.
+#include <AsyncWiFiManager.h>
+#include <vector>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+static const unsigned long OUTAGE_MS = 60000;
+static const unsigned long BIN_MS = 10000;
+static const int BINS = 18;
+
+class Device {
+public:
+	host::Radio radio;
+	AsyncWebServer server{80};
+	DNSServer dns;
+	AsyncWiFiManager wm{&server, &dns};
+
+	void loop() {
+		host::Radio::select(&radio);
+		wm.loop();
+	}
+	bool connected() {
+		host::Radio::select(&radio);
+		return WiFi.isConnected();
+	}
+};
+
+class Herd {
+public:
+	unsigned long peak = 0;			// Most attempts within one second after the router is back
+	unsigned long recoverMs = 0;	// Router back to the last device connected
+	unsigned long bins[BINS] = {};	// Attempts per BIN_MS from the start of the outage
+};
+
+static bool allConnected(std::vector<Device *> &devices) {
+	for (Device *device : devices) {
+		if (!device->connected()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void step(std::vector<Device *> &devices) {
+	for (Device *device : devices) {
+		device->loop();
+	}
+}
+
+static Herd run(int count, std::function<void(AsyncWiFiManager &)> configure) {
+	Herd herd;
+	std::vector<unsigned long> attempts;
+
+	host::air().clear();
+	host::AccessPoint &router = host::air().add("Router", "secret", -55, 6);
+	router.onAttempt = [&attempts](unsigned long ms) {
+		host::Untracked untracked;
+		attempts.push_back(ms);
+	};
+
+	std::vector<Device *> devices;
+	for (int i = 0; i < count; i++) {
+		Device *device = new Device();
+		host::Radio::select(&device->radio);
+		device->wm.setAPCredentials("Clock-Setup", "");
+		device->wm.setConnectTimeout(30000);
+		device->wm.setRouterCredentials("Router", "secret");
+		configure(device->wm);
+		device->wm.startAsync();
+		devices.push_back(device);
+	}
+	bench::runUntil([&]() { step(devices); }, [&]() { return allConnected(devices); }, 120000, 20);
+	bench::check(allConnected(devices), "the herd connects");
+
+	attempts.clear();
+	router.capacity = 20;		// Only once the devices are up, the first connect isn't the point
+	unsigned long downMs = millis();
+	host::air().setUp(router, false);
+	bench::runUntil([&]() { step(devices); }, []() { return false; }, OUTAGE_MS, 20);
+	host::air().setUp(router, true);
+
+	unsigned long upMs = millis();
+	bench::runUntil([&]() { step(devices); }, [&]() { return allConnected(devices); }, BIN_MS * BINS, 20);
+	herd.recoverMs = millis() - upMs;
+	bench::check(allConnected(devices), "the herd reconnects");
+
+	for (size_t i = 0; i < attempts.size(); i++) {
+		unsigned long bin = (attempts[i] - downMs) / BIN_MS;
+		if (bin < BINS) {
+			herd.bins[bin]++;
+		}
+		unsigned long window = 0;
+		for (size_t j = i; j < attempts.size() && attempts[j] - attempts[i] < 1000; j++) {
+			window++;
+		}
+		if (attempts[i] >= upMs && window > herd.peak) {
+			herd.peak = window;
+		}
+	}
+
+	for (Device *device : devices) {
+		delete device;
+	}
+	host::Radio::select(NULL);
+	return herd;
+}
+
+static void report(const char *what, const Herd &herd) {
+	printf("  %-22s", what);
+	for (int i = 0; i < BINS; i++) {
+		printf(" %4lu", herd.bins[i]);
+	}
+	printf("   peak %3lu/s, back %5.1f s\n", herd.peak, herd.recoverMs / 1000.0);
+}
+
+int main(int argc, char **argv) {
+	int count = bench::quick(argc, argv) ? 20 : 200;
+
+	printf("%d devices, router down for %lu s and serving 20 attempts/s, attempts per %lu s:\n", count, OUTAGE_MS / 1000, BIN_MS / 1000);
+	Herd fixed = run(count, [](AsyncWiFiManager &wm) {
+	});
+	Herd backoff = run(count, [](AsyncWiFiManager &wm) {
+		wm.setConnectRetryBackoff(2000, 30000, 50);
+	});
+	report("fixed 10 s", fixed);
+	report("2-30 s backoff, 50%", backoff);
+
+	bench::check(backoff.peak < fixed.peak, "jitter spreads the retries out");
+	bench::check(fixed.peak >= (unsigned long)count, "the fixed retry comes in lock-step");
+	return bench::finish("herd_bench");
+}
@@ -0,0 +1,432 @@
+// The portal under load over real TCP sockets: phones at once against a socket-backed stand-in for
+// the web server, with loop() on a thread of its own and the clock in real time, as on a device.
+// Scenarios are the captive probes of phones joining, repeated scans, form saves, and all of those
+// as phones actually go through them. Prints requests/s, p50/p99 latency, peak heap over the
+// portal at rest and failed requests per scenario.
+#include <AsyncWiFiManager.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <lwip/sockets.h>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<int> saves{0};
+
+static void onSave() {
+	saves++;
+}
+
+// Puts a response back together as the connection sends it, closing the connection after it
+class SocketSink : public host::ResponseSink {
+public:
+	bool chunked = false;
+	std::string head;
+	std::string content;
+
+	void status(int code, const char *contentType, bool isChunked, size_t contentLength) override {
+		host::Untracked untracked;
+		chunked = isChunked;
+		head = "HTTP/1.1 " + std::to_string(code) + "\r\n";
+		if (*contentType != 0) {
+			head += std::string("Content-Type: ") + contentType + "\r\n";
+		}
+	}
+	void header(const char *name, const char *value) override {
+		host::Untracked untracked;
+		head += std::string(name) + ": " + value + "\r\n";
+	}
+	void body(const uint8_t *data, size_t length) override {
+		host::Untracked untracked;
+		if (chunked) {
+			char size[12];
+			snprintf(size, sizeof(size), "%zx\r\n", length);
+			content += size;
+		}
+		content.append((const char *)data, length);
+		if (chunked) {
+			content += "\r\n";
+		}
+	}
+
+	std::string text() const {
+		if (chunked) {
+			return head + "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n" + content + "0\r\n\r\n";
+		}
+		return head + "Content-Length: " + std::to_string(content.length()) + "\r\nConnection: close\r\n\r\n" + content;
+	}
+};
+
+// Stand-in for the AsyncTCP side of the server: accepts on the loopback and runs each request
+// through host::serve() once it has fully arrived, one at a time on a thread of its own as the
+// async_tcp task does. A request the handlers leave unanswered is closed without a response.
+class SocketServer {
+public:
+	SocketServer(AsyncWebServer &server) : _server(server) {
+	}
+	~SocketServer() {
+		end();
+	}
+
+	uint16_t port = 0;
+
+	bool begin() {
+		host::Untracked untracked;
+		_listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		struct sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t length = sizeof(address);
+		if (bind(_listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(_listener, 128) != 0
+				|| getsockname(_listener, (struct sockaddr *)&address, &length) != 0) {
+			close(_listener);
+			return false;
+		}
+		fcntl(_listener, F_SETFL, O_NONBLOCK);
+		port = ntohs(address.sin_port);
+		_running = true;
+		_thread = std::thread([this]() { run(); });
+		return true;
+	}
+
+	void end() {
+		if (_running) {
+			_running = false;
+			_thread.join();
+			close(_listener);
+		}
+	}
+
+private:
+	class Connection {
+	public:
+		int socket;
+		std::string received;
+	};
+
+	AsyncWebServer &_server;
+	int _listener = -1;
+	std::atomic<bool> _running{false};
+	std::thread _thread;
+
+	void run() {
+		std::vector<Connection> connections;
+		std::vector<struct pollfd> polled;
+		while (_running) {
+			{
+				host::Untracked untracked;
+				polled.assign(1, { _listener, POLLIN, 0 });
+				for (const Connection &connection : connections) {
+					polled.push_back({ connection.socket, POLLIN, 0 });
+				}
+			}
+			if (poll(polled.data(), polled.size(), 10) <= 0) {
+				continue;
+			}
+
+			for (size_t i = connections.size(); i-- > 0; ) {
+				if ((polled[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) != 0 && receive(connections[i])) {
+					close(connections[i].socket);
+					host::Untracked untracked;
+					connections.erase(connections.begin() + i);
+				}
+			}
+
+			int accepted;
+			while ((accepted = accept(_listener, NULL, NULL)) >= 0) {
+				fcntl(accepted, F_SETFL, O_NONBLOCK);
+				host::Untracked untracked;
+				connections.push_back({ accepted, std::string() });
+			}
+		}
+		for (const Connection &connection : connections) {
+			close(connection.socket);
+		}
+		host::Untracked untracked;
+		connections.clear();
+		polled.clear();
+		polled.shrink_to_fit();
+	}
+
+	/** Reads what arrived and serves the request once it is complete. True when the connection is done with. */
+	bool receive(Connection &connection) {
+		std::unique_ptr<host::Request> request;
+		{
+			host::Untracked untracked;
+			char buffer[2048];
+			ssize_t size;
+			while ((size = recv(connection.socket, buffer, sizeof(buffer), 0)) > 0) {
+				connection.received.append(buffer, size);
+			}
+			if (size == 0 || (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+				return true;
+			}
+			request.reset(parse(connection.received));
+			if (!request) {
+				return false;
+			}
+		}
+
+		SocketSink sink;
+		bool answered = host::serve(_server, *request, sink);
+
+		host::Untracked untracked;
+		request.reset();
+		if (answered) {
+			fcntl(connection.socket, F_SETFL, 0);
+			std::string text = sink.text();
+			for (size_t sent = 0; sent < text.length(); ) {
+				ssize_t size = send(connection.socket, text.data() + sent, text.length() - sent, MSG_NOSIGNAL);
+				if (size <= 0) {
+					break;
+				}
+				sent += size;
+			}
+		}
+		return true;
+	}
+
+	/** The request once its head, and the body the head announces, have arrived; NULL before */
+	static host::Request* parse(const std::string &text) {
+		size_t end = text.find("\r\n\r\n");
+		if (end == std::string::npos) {
+			return NULL;
+		}
+		host::Request *request = new host::Request();
+		size_t space = text.find(' ');
+		request->method = text.substr(0, space);
+		request->url = text.substr(space + 1, text.find(' ', space + 1) - space - 1);
+		size_t contentLength = 0;
+		for (size_t line = text.find("\r\n") + 2; line < end; line = text.find("\r\n", line) + 2) {
+			size_t colon = text.find(':', line);
+			size_t eol = text.find("\r\n", line);
+			std::string name = text.substr(line, colon - line);
+			std::string value = text.substr(colon + 2, eol - colon - 2);
+			if (strcasecmp(name.c_str(), "Host") == 0) {
+				request->host = value;
+			} else if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+				contentLength = strtoul(value.c_str(), NULL, 10);
+			} else {
+				request->headers.push_back(std::make_pair(name, value));
+			}
+		}
+		if (text.length() < end + 4 + contentLength) {
+			delete request;
+			return NULL;
+		}
+		request->form = text.substr(end + 4, contentLength);
+		return request;
+	}
+};
+
+static std::string get(const char *host, const char *url) {
+	return std::string("GET ") + url + " HTTP/1.1\r\nHost: " + host + "\r\nAccept-Encoding: gzip, deflate\r\n\r\n";
+}
+
+static std::string post(const char *url, const char *form) {
+	return std::string("POST ") + url + " HTTP/1.1\r\nHost: 192.168.4.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+			+ "Content-Length: " + std::to_string(strlen(form)) + "\r\n\r\n" + form;
+}
+
+// What the OSes ask for when they join, each on the host it expects
+static std::vector<std::string> probes() {
+	return {
+		get("connectivitycheck.gstatic.com", "/generate_204"),
+		get("www.google.com", "/gen_204"),
+		get("captive.apple.com", "/hotspot-detect.html"),
+		get("www.apple.com", "/library/test/success.html"),
+		get("www.msftconnecttest.com", "/connecttest.txt"),
+		get("www.msftncsi.com", "/ncsi.txt"),
+		get("detectportal.firefox.com", "/canonical.html"),
+		get("detectportal.firefox.com", "/success.txt"),
+		get("clients3.google.com", "/")
+	};
+}
+
+// A network that isn't there, so that the device tries it, gives up and goes on serving the portal
+static const char *const SAVE_FORM = "s=Elsewhere&p=secret+phrase&ip=&gw=&sn=&dns1=";
+
+class Scenario {
+public:
+	const char *name;
+	std::vector<std::string> requests;	// Each phone goes round these, starting at one of its own
+};
+
+class Result {
+public:
+	int requests = 0;
+	int failed = 0;				// Not answered, or answered with an error
+	double perSecond = 0;
+	double p50Ms = 0;
+	double p99Ms = 0;
+	size_t peakHeap = 0;		// Over the heap with the portal at rest
+};
+
+/** One request on a connection of its own; the status code, or 0 if there was no response */
+static int exchange(uint16_t port, const std::string &request) {
+	int client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	struct timeval timeout = { 5, 0 };
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(client, (struct sockaddr *)&address, sizeof(address)) != 0
+			|| send(client, request.data(), request.length(), MSG_NOSIGNAL) != (ssize_t)request.length()) {
+		close(client);
+		return 0;
+	}
+
+	std::string response;
+	char buffer[4096];
+	ssize_t size;
+	while ((size = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+		response.append(buffer, size);
+	}
+	close(client);
+	if (size < 0 || response.compare(0, 9, "HTTP/1.1 ") != 0) {
+		return 0;
+	}
+	return atoi(response.c_str() + 9);
+}
+
+static Result run(const Scenario &scenario, uint16_t port, int phones, unsigned long durationMs) {
+	Result result;
+	std::vector<std::vector<double> > latencies;
+	std::vector<int> failures;
+	std::vector<std::thread> threads;
+	{
+		host::Untracked untracked;
+		latencies.resize(phones);
+		failures.resize(phones);
+	}
+
+	size_t rest = host::heap().current;
+	host::resetPeak();
+	Clock::time_point start = Clock::now();
+	Clock::time_point until = start + std::chrono::milliseconds(durationMs);
+	for (int phone = 0; phone < phones; phone++) {
+		host::Untracked untracked;
+		threads.push_back(std::thread([&, phone]() {
+			host::Untracked untracked;	// The phones aren't part of the device's heap
+			for (size_t i = phone; Clock::now() < until; i++) {
+				Clock::time_point sent = Clock::now();
+				int code = exchange(port, scenario.requests[i % scenario.requests.size()]);
+				latencies[phone].push_back(std::chrono::duration<double, std::milli>(Clock::now() - sent).count());
+				if (code == 0 || code >= 400) {
+					failures[phone]++;
+				}
+			}
+		}));
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	result.peakHeap = host::heap().peak - rest;
+
+	host::Untracked untracked;
+	std::vector<double> all;
+	for (int phone = 0; phone < phones; phone++) {
+		all.insert(all.end(), latencies[phone].begin(), latencies[phone].end());
+		result.failed += failures[phone];
+	}
+	std::sort(all.begin(), all.end());
+	result.requests = all.size();
+	result.perSecond = all.size() / seconds;
+	if (!all.empty()) {
+		result.p50Ms = all[all.size() / 2];
+		result.p99Ms = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+	}
+	return result;
+}
+
+int main(int argc, char **argv) {
+	bool quick = bench::quick(argc, argv);
+	int phones = quick ? 8 : 24;
+	unsigned long durationMs = quick ? 1000 : 10000;
+
+	host::air().add("HomeNet", "correct horse", -55, 6);
+	host::air().addNeighbours(20, 15);
+
+	AsyncWebServer server(80);
+	DNSServer dns;
+	AsyncWiFiManager wm(&server, &dns);
+	wm.setAPCredentials("Clock-Setup", "");
+	wm.setSaveConfigCallback(onSave);
+	wm.setConnectTimeout(1000);
+	wm.startAsync();
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_PORTAL; }, 10000);
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return host::fetch(server, "/wifi").body.find("HomeNet") != std::string::npos; }, 10000, 100);
+	bench::check(wm.getStartState() == AsyncWiFiManager::START_PORTAL, "portal up");
+
+	// From here on the clock is the wall clock, with loop() every 10 ms as the sketch would call it
+	host::setRealTime(true);
+	std::atomic<bool> looping{true};
+	std::thread loop([&]() {
+		while (looping) {
+			wm.loop();
+			host::advance(10);
+		}
+	});
+
+	SocketServer sockets(server);
+	bench::check(sockets.begin(), "listening on the loopback");
+
+	std::vector<Scenario> scenarios;
+	{
+		host::Untracked untracked;
+		scenarios.push_back({ "probe storm", probes() });
+		scenarios.push_back({ "scans", { get("192.168.4.1", "/wifi?scan=1"), get("192.168.4.1", "/wifi"), get("192.168.4.1", "/wm.css") } });
+		scenarios.push_back({ "saves", { post("/wifisave", SAVE_FORM), get("192.168.4.1", "/i") } });
+		std::vector<std::string> joining = probes();
+		joining.resize(3);
+		std::vector<std::string> setup = { get("192.168.4.1", "/"), get("192.168.4.1", "/wm.css"), get("192.168.4.1", "/wifi"),
+				get("192.168.4.1", "/wifi?scan=1"), get("192.168.4.1", "/wifi"), post("/wifisave", SAVE_FORM) };
+		joining.insert(joining.end(), setup.begin(), setup.end());
+		scenarios.push_back({ "phones joining", joining });
+	}
+
+	printf("%d phones for %.0f s each, one connection per request:\n", phones, durationMs / 1000.0);
+	printf("  %-16s %8s %10s %9s %9s %10s %7s\n", "", "requests", "requests/s", "p50 ms", "p99 ms", "peak heap", "failed");
+	std::vector<Result> results;
+	for (const Scenario &scenario : scenarios) {
+		Result result = run(scenario, sockets.port, phones, durationMs);
+		printf("  %-16s %8d %10.0f %9.2f %9.2f %10zu %7d\n", scenario.name, result.requests, result.perSecond,
+				result.p50Ms, result.p99Ms, result.peakHeap, result.failed);
+		bench::check(result.requests >= phones, scenario.name);
+		results.push_back(result);
+
+		// Back to the portal at rest after the saves, so the next scenario starts from the same place
+		for (int waited = 0; wm.getStartState() != AsyncWiFiManager::START_PORTAL && waited < 10000; waited += 10) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		bench::check(wm.getStartState() == AsyncWiFiManager::START_PORTAL, "back to the portal");
+	}
+
+	bench::check(saves > 0, "saves applied");
+
+	sockets.end();
+	looping = false;
+	loop.join();
+	host::setRealTime(false);
+
+	for (size_t i = 0; i < results.size(); i++) {
+		if (results[i].failed != 0) {
+			printf("FAIL: %s: %d of %d requests failed\n", scenarios[i].name, results[i].failed, results[i].requests);
+			bench::failures()++;
+		}
+	}
+	return bench::finish("load_bench");
+}
@@ -0,0 +1,73 @@
+// /metrics on a device that connects straight to its router and never runs the portal: the
+// endpoint has to start the web server itself. Prints what a scrape returns after a disconnect,
+// and checks it against the Prometheus naming conventions: durations in seconds, counters ending
+// in _total, and no series per disconnect.
+#include <AsyncWiFiManager.h>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+static host::Response scrape(AsyncWebServer &server) {
+	host::Request request;
+	request.url = "/metrics";
+	request.ap = false;		// On the station interface
+	return host::fetch(server, request);
+}
+
+int main(int argc, char **argv) {
+	bench::quick(argc, argv);
+	host::AccessPoint &router = host::air().add("HomeNet", "correct horse", -55, 6);
+
+	// Turned on before the start
+	{
+		host::Radio radio;
+		host::Radio::select(&radio);
+		AsyncWebServer server(80);
+		DNSServer dns;
+		AsyncWiFiManager wm(&server, &dns);
+		wm.setRouterCredentials("HomeNet", "correct horse");
+		wm.setConnectTimeout(10000);
+		wm.setMetricsEndpoint(true);
+		wm.startAsync();
+		bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_CONNECTED; }, 10000);
+		bench::check(wm.getStartState() == AsyncWiFiManager::START_CONNECTED && !wm.isAP(), "connected without the portal");
+		bench::check(server.begun() && scrape(server).code == 200, "/metrics served once connected");
+
+		// A router reboot, for a disconnect to report
+		host::air().setUp(router, false);
+		bench::runUntil([&]() { wm.loop(); }, []() { return !WiFi.isConnected(); }, 10000);
+		host::air().setUp(router, true);
+		bench::runUntil([&]() { wm.loop(); }, []() { return WiFi.isConnected(); }, 30000);
+		bench::runUntil([&]() { wm.loop(); }, []() { return false; }, 100);
+
+		host::Response metrics = scrape(server);
+		printf("/metrics after a disconnect, %zu bytes:\n%s", metrics.body.length(), metrics.body.c_str());
+		bench::check(metrics.code == 200 && metrics.body.find("wifi_disconnects_total 1\n") != std::string::npos, "disconnect counted");
+		bench::check(metrics.body.find("milliseconds") == std::string::npos, "durations in seconds");
+		bench::check(metrics.body.find("wifi_connect_seconds_bucket{le=\"0.25\"}") != std::string::npos
+				&& metrics.body.find("wifi_connect_seconds_sum 1.2\n") != std::string::npos, "bounds and sum in seconds");
+		bench::check(metrics.body.find("# TYPE wifi_uptime_seconds_total counter\n") != std::string::npos, "counters end in _total");
+		bench::check(metrics.body.find("reason=") == std::string::npos, "no series per disconnect");
+		bench::check(wm.getStats().routes[AsyncWiFiManagerStats::ROUTE_METRICS].requests == 2, "scrapes counted");
+		host::Radio::select(NULL);
+	}
+
+	// Turned on once connected
+	{
+		host::Radio radio;
+		host::Radio::select(&radio);
+		AsyncWebServer server(80);
+		DNSServer dns;
+		AsyncWiFiManager wm(&server, &dns);
+		wm.setRouterCredentials("HomeNet", "correct horse");
+		wm.setConnectTimeout(10000);
+		wm.startAsync();
+		bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_CONNECTED; }, 10000);
+		bench::check(!server.begun(), "no server without the portal or /metrics");
+		wm.setMetricsEndpoint(true);
+		bench::check(server.begun() && scrape(server).code == 200, "/metrics served when turned on while connected");
+		host::Radio::select(NULL);
+	}
+	return bench::finish("metrics_bench");
+}
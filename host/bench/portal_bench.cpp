@@ -0,0 +1,172 @@
+// End to end run of the portal on the host: a device without credentials starts, brings up the
+// portal, a phone loads the pages and saves the router, and the device connects. Prints what each
+// route costs in allocations and bytes, and fails if any step doesn't happen as on a device.
+#include <AsyncWiFiManager.h>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+static int saves = 0;
+static bool connected = false;
+
+static void onSave() {
+	saves++;
+}
+
+static void onStart(bool isConnected) {
+	connected = isConnected;
+}
+
+// The connected callback has to come from loop(), not from a WiFi event or start()
+static bool inLoop = false;
+static int connectedCalls = 0;
+static bool connectedOutsideLoop = false;
+
+static void onConnected() {
+	connectedCalls++;
+	connectedOutsideLoop |= !inLoop;
+}
+
+static void step(AsyncWiFiManager &wm) {
+	inLoop = true;
+	wm.loop();
+	inLoop = false;
+}
+
+static void route(AsyncWebServer &server, const char *url, const char *acceptEncoding, int iterations) {
+	host::Request request;
+	request.url = url;
+	if (acceptEncoding != NULL) {
+		request.headers.push_back(std::make_pair(std::string("Accept-Encoding"), std::string(acceptEncoding)));
+	}
+
+	host::Response response;
+	bench::HeapDelta delta;
+	for (int i = 0; i < iterations; i++) {
+		response = host::fetch(server, request);
+	}
+	printf("  %-24s %3d  %6zu bytes  %5.1f allocations\n", url, response.code, response.body.length(),
+			(double)delta.allocations() / iterations);
+	bench::check(response.code == 200 || response.code == 302, url);
+}
+
+int main(int argc, char **argv) {
+	int iterations = bench::quick(argc, argv) ? 5 : 200;
+
+	host::AccessPoint &router = host::air().add("HomeNet", "correct horse", -55, 6);
+	host::air().addNeighbours(20, 15);
+
+	AsyncWebServer server(80);
+	DNSServer dns;
+	AsyncWiFiManager wm(&server, &dns);
+	wm.setSaveConfigCallback(onSave);
+	wm.setStartCallback(onStart);
+	wm.setConnectedCallback(onConnected);
+	wm.setAPCredentials("Clock-Setup", "");
+	wm.setCaptiveDNS(true);
+	wm.setConnectTimeout(5000);
+
+	// No credentials: the start falls back to the portal
+	wm.startAsync();
+	bench::runUntil([&]() { step(wm); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_PORTAL; }, 10000);
+	bench::check(wm.getStartState() == AsyncWiFiManager::START_PORTAL, "portal after a start without credentials");
+	bench::check(wm.isAP() && server.begun(), "portal up and served");
+	bench::check(WiFi.softAPIP() == IPAddress(192, 168, 4, 1), "soft AP address");
+
+	// The background scan the portal starts
+	bench::runUntil([&]() { step(wm); }, [&]() { return host::fetch(server, "/wifi").body.find("HomeNet") != std::string::npos; }, 10000, 100);
+	bench::check(host::fetch(server, "/wifi").body.find("HomeNet") != std::string::npos, "scan results on /wifi");
+
+	printf("routes, %d requests each:\n", iterations);
+	route(server, "/", NULL, iterations);
+	route(server, "/wifi", NULL, iterations);
+	route(server, "/i", NULL, iterations);
+	route(server, "/wm.css", "gzip, deflate", iterations);
+	route(server, "/api/scan", NULL, iterations);
+	route(server, "/api/info", NULL, iterations);
+	route(server, "/api/status", NULL, iterations);
+	route(server, "/generate_204", NULL, iterations);
+
+	// Only the gzipped copy is built in, a client that rules gzip out can't have it
+	const char *const refusals[] = { "identity", "gzip;q=0, deflate", "deflate, *;q=0" };
+	for (const char *refusal : refusals) {
+		host::Request css;
+		css.url = "/wm.css";
+		css.headers.push_back(std::make_pair(std::string("Accept-Encoding"), std::string(refusal)));
+		host::Response response = host::fetch(server, css);
+		bench::check(response.code == 406 && response.header("Content-Encoding") == NULL, "no gzip where it is ruled out");
+	}
+	host::Request css;
+	css.url = "/wm.css";
+	css.headers.push_back(std::make_pair(std::string("Accept-Encoding"), std::string("deflate;q=0.5, gzip;q=0.8")));
+	bench::check(host::fetch(server, css).header("Content-Encoding") != NULL, "gzip with a weight");
+
+	// Sketches that inline the assets themselves
+	bench::check(strncmp(HTTP_STYLE, "<style>", 7) == 0 && strcmp(HTTP_STYLE + strlen(HTTP_STYLE) - 8, "</style>") == 0
+			&& strncmp(HTTP_STYLE + 7, HTTP_STYLE_CSS, strlen(HTTP_STYLE_CSS)) == 0, "HTTP_STYLE is a <style> element");
+	bench::check(strncmp(HTTP_SCRIPT, "<script>", 8) == 0 && strcmp(HTTP_SCRIPT + strlen(HTTP_SCRIPT) - 9, "</script>") == 0
+			&& strncmp(HTTP_SCRIPT + 8, HTTP_SCRIPT_JS, strlen(HTTP_SCRIPT_JS)) == 0, "HTTP_SCRIPT is a <script> element");
+
+	host::Response scan = host::fetch(server, "/api/scan");
+	bench::check(scan.chunked && scan.body.find("\"ssid\":\"HomeNet\"") != std::string::npos, "/api/scan streamed in chunks");
+
+	// A probe for some other host gets sent to the portal
+	host::Request other;
+	other.url = "/anything";
+	other.host = "example.com";
+	host::Response redirected = host::fetch(server, other);
+	bench::check(redirected.code == 302 && redirected.header("Location") != NULL, "redirect to the portal");
+
+	// A mistyped password, corrected while the device is still trying it
+	host::Response save = host::post(server, "/wifisave", "s=HomeNet&p=wrong+horse");
+	bench::check(save.code == 200, "save answered");
+	bench::runUntil([&]() { step(wm); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_CONNECTING; }, 1000);
+	bench::check(wm.getStartState() == AsyncWiFiManager::START_CONNECTING, "connecting after the save");
+	save = host::post(server, "/wifisave", "s=HomeNet&p=correct+horse");
+	bench::check(save.code == 200, "second save answered");
+
+	bench::runUntil([&]() { step(wm); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_CONNECTED; }, 20000);
+	bench::check(wm.getStartState() == AsyncWiFiManager::START_CONNECTED && WiFi.isConnected(), "connected after the second save");
+	bench::check(saves == 2, "save callback after each attempt");
+	bench::check(connected, "start callback reported the connection");
+	bench::runUntil([&]() { step(wm); }, [&]() { return connectedCalls > 0; }, 1000);
+	bench::check(connectedCalls == 1 && !connectedOutsideLoop, "connected callback once, from loop()");
+
+	// A blocking start with the saved network leaves the callback to the next loop() as well
+	bench::check(wm.start(), "blocking start connects");
+	bench::check(connectedCalls == 1, "no connected callback inside start()");
+	bench::runUntil([&]() { step(wm); }, [&]() { return connectedCalls > 1; }, 1000);
+	bench::check(connectedCalls == 2 && !connectedOutsideLoop, "connected callback from loop() after start()");
+	bench::check(WiFi.SSID() == "HomeNet", "connected to the saved network");
+
+	// A device whose router is down ends in the portal. A save with the SSID left empty only changes
+	// parameters, the device goes on trying the saved network and connects once the router is back.
+	host::air().setUp(router, false);
+	{
+		host::Radio radio;
+		host::Radio::select(&radio);
+		AsyncWebServer server(80);
+		DNSServer dns;
+		AsyncWiFiManager wm(&server, &dns);
+		wm.setAPCredentials("Clock-Setup", "");
+		wm.setRouterCredentials("HomeNet", "correct horse");
+		wm.setConnectTimeout(5000);
+		wm.startAsync();
+		bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_PORTAL; }, 10000);
+		bench::check(wm.getStartState() == AsyncWiFiManager::START_PORTAL, "portal while the router is down");
+
+		uint32_t begins = radio.begins;
+		bench::check(host::post(server, "/wifisave", "s=&p=").code == 200, "parameters-only save answered");
+		bench::runUntil([&]() { wm.loop(); }, [&]() { return radio.begins > begins; }, 100);
+		bench::check(radio.begins > begins && radio.configSSID == "HomeNet", "saved network tried right after a parameters-only save");
+		host::air().setUp(router, true);
+		bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_CONNECTED; }, 20000);
+		bench::check(WiFi.isConnected() && WiFi.SSID() == "HomeNet", "connected after a parameters-only save");
+		host::Radio::select(NULL);
+	}
+
+	host::HeapStats heap = host::heap();
+	printf("heap: %zu bytes in use, peak %zu, %llu allocations\n", heap.current, heap.peak, (unsigned long long)heap.allocations);
+	return bench::finish("portal_bench");
+}
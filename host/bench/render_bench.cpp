@@ -0,0 +1,186 @@
+// Allocations per render of /wifi, against a reference that builds the page the way the library did
+// before templates were streamed: String::replace() chains per form field and printf() per network.
+// Both go through the same server, so the request handling around them costs the same.
+#include <AsyncWiFiManager.h>
+#include <vector>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+// The templates as they were, {v} of the head filled in once at start as the library did
+static const char LEGACY_HEAD[] PROGMEM = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>Config ESP</title>";
+static const char LEGACY_STYLE[] PROGMEM = "<style>.c{text-align: center;} div,input{padding:5px;font-size:1em;} input{width:95%;} body{text-align: center;font-family:verdana;} button{border:0;border-radius:0.3rem;background-color:#1fa3ec;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;} .q{float: right;width: 64px;text-align: right;} .l{background: url(\"data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAALVBMVEX///8EBwfBwsLw8PAzNjaCg4NTVVUjJiZDRUUUFxdiZGSho6OSk5Pg4eFydHTCjaf3AAAAZElEQVQ4je2NSw7AIAhEBamKn97/uMXEGBvozkWb9C2Zx4xzWykBhFAeYp9gkLyZE0zIMno9n4g19hmdY39scwqVkOXaxph0ZCXQcqxSpgQpONa59wkRDOL93eAXvimwlbPbwwVAegLS1HGfZAAAAABJRU5ErkJggg==\") no-repeat left center;background-size: 1em;}</style>";
+static const char LEGACY_SCRIPT[] PROGMEM = "<script>function c(l){document.getElementById('s').value=l.innerText||l.textContent;document.getElementById('p').focus();};function t(){var x=document.getElementById('p');if(x.type === 'password'){x.type='text';}else{x.type='password';}}</script>";
+static const char LEGACY_HEAD_END[] PROGMEM = "</head><body><div style='text-align:left;display:inline-block;min-width:260px;'>";
+static const char LEGACY_ITEM[] = "<div><a href='#p' onclick='c(this)'>%s</a>&nbsp;<span class='q %c'>%d%%</span></div>";
+static const char LEGACY_FORM_START[] PROGMEM = "<form method='get' action='wifisave'><input id='s' name='s' autocapitalize='none' length=32 placeholder='SSID'><br/><input id='p' name='p' length=64 type='password' placeholder='password'><p><input type='checkbox' style='width:auto' onclick='t()'><label for='p'>Show Password</label><br>";
+static const char LEGACY_FORM_PARAM[] PROGMEM = "<br/><label for='{i}'>{p}</label><input id='{i}' name='{n}' length={l} value='{v}' {c}>";
+static const char LEGACY_FORM_END[] PROGMEM = "<br/><button type='submit'>save</button></form>";
+static const char LEGACY_SCAN_LINK[] PROGMEM = "<br/><div class=\"c\"><a href=\"/wifi?static={s}&scan=1\"><button>Scan</button></a></div>";
+static const char LEGACY_END[] PROGMEM = "</div></body></html>";
+
+class LegacyNetwork {
+public:
+	std::string ssid;
+	int quality;
+	bool locked;
+};
+
+static std::vector<LegacyNetwork> *legacyNetworks;
+static AsyncWiFiManagerParameter *legacyParams[3];
+
+static void legacyField(AsyncResponseStream *response, const char *id, const char *placeholder, const char *length, const String &value) {
+	String item = FPSTR(LEGACY_FORM_PARAM);
+	item.replace("{i}", id);
+	item.replace("{n}", id);
+	item.replace("{p}", placeholder);
+	item.replace("{l}", length);
+	item.replace("{v}", value);
+	response->print(item);
+}
+
+static void handleLegacyWifi(AsyncWebServerRequest *request) {
+	String useStatic = request->arg("static");
+	AsyncResponseStream *response = request->beginResponseStream("text/html");
+
+	response->print(FPSTR(LEGACY_HEAD));
+	response->print(FPSTR(LEGACY_SCRIPT));
+	response->print(FPSTR(LEGACY_STYLE));
+	response->print(FPSTR(LEGACY_HEAD_END));
+
+	for (const LegacyNetwork &network : *legacyNetworks) {
+		response->printf(LEGACY_ITEM, network.ssid.c_str(), network.locked ? 'l' : ' ', network.quality);
+	}
+	response->print("<br/>");
+
+	response->print(FPSTR(LEGACY_FORM_START));
+	char parLength[3];
+	for (AsyncWiFiManagerParameter *param : legacyParams) {
+		String pitem = FPSTR(LEGACY_FORM_PARAM);
+		pitem.replace("{i}", param->getID());
+		pitem.replace("{n}", param->getID());
+		pitem.replace("{p}", param->getPlaceholder());
+		snprintf(parLength, sizeof(parLength), "%d", param->getValueLength());
+		pitem.replace("{l}", parLength);
+		pitem.replace("{v}", param->getValue());
+		pitem.replace("{c}", param->getCustomHTML());
+		response->print(pitem);
+	}
+	response->print("<br/>");
+
+	if (useStatic == "1") {
+		legacyField(response, "ip", "Static IP", "15", IPAddress(192, 168, 1, 50).toString());
+		legacyField(response, "gw", "Static Gateway", "15", IPAddress(192, 168, 1, 1).toString());
+		legacyField(response, "sn", "Subnet", "15", IPAddress(255, 255, 255, 0).toString());
+		legacyField(response, "dns1", "DNS1", "15", IPAddress(192, 168, 1, 1).toString());
+		legacyField(response, "dns2", "DNS2", "15", IPAddress(0, 0, 0, 0).toString());
+		response->print("<br/>");
+	}
+
+	response->print(FPSTR(LEGACY_FORM_END));
+	String scanLink = String(FPSTR(LEGACY_SCAN_LINK));
+	scanLink.replace("{s}", useStatic);
+	response->print(scanLink);
+	response->print(FPSTR(LEGACY_END));
+
+	request->send(response);
+}
+
+class Render {
+public:
+	double allocations;
+	size_t bytes;
+	size_t peak;
+};
+
+static Render render(AsyncWebServer &server, const char *url, int iterations) {
+	Render result;
+	host::Response response;
+	bench::HeapDelta delta;
+	host::resetPeak();
+	size_t before = host::heap().current;
+	for (int i = 0; i < iterations; i++) {
+		response = host::fetch(server, url);
+	}
+	result.allocations = (double)delta.allocations() / iterations;
+	result.bytes = response.body.length();
+	result.peak = host::heap().peak - before;
+	bench::check(response.code == 200, url);
+	return result;
+}
+
+static void report(const char *what, const Render &render) {
+	printf("  %-34s %6zu bytes  %6.1f allocations  %6zu bytes peak\n", what, render.bytes, render.allocations, render.peak);
+}
+
+int main(int argc, char **argv) {
+	int iterations = bench::quick(argc, argv) ? 5 : 500;
+
+	host::air().add("HomeNet", "correct horse", -55, 6);
+	host::air().addNeighbours(20, 15);
+	host::Radio::current().rssiJitter = 0;
+
+	AsyncWebServer server(80);
+	DNSServer dns;
+	AsyncWiFiManager wm(&server, &dns);
+	legacyParams[0] = new AsyncWiFiManagerParameter("server", "MQTT server", "broker.local", 40);
+	legacyParams[1] = new AsyncWiFiManagerParameter("port", "MQTT port", "1883", 6);
+	legacyParams[2] = new AsyncWiFiManagerParameter("name", "Device name", "clock", 32);
+	for (AsyncWiFiManagerParameter *param : legacyParams) {
+		wm.addParameter(param);
+	}
+	wm.setAPCredentials("Clock-Setup", "");
+	wm.setSTAStaticIPConfig(IPAddress(192, 168, 1, 50), IPAddress(192, 168, 1, 1), IPAddress(255, 255, 255, 0), IPAddress(192, 168, 1, 1));
+	wm.startAsync();
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.isAP(); }, 5000);
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return host::Radio::current().scans > 0; }, 10000, 100);
+	for (int i = 0; i < 10; i++) {
+		wm.loop();
+	}
+	bench::check(wm.isAP(), "portal up");
+
+	// The same networks for the reference: strongest per SSID, as it de-duplicated
+	{
+		host::Untracked untracked;
+		legacyNetworks = new std::vector<LegacyNetwork>();
+		for (const host::AccessPoint &ap : host::air().accessPoints) {
+			bool stronger = false;
+			for (LegacyNetwork &network : *legacyNetworks) {
+				stronger |= network.ssid == ap.ssid.c_str();
+			}
+			if (!stronger) {
+				LegacyNetwork network;
+				network.ssid = ap.ssid.c_str();
+				network.quality = ap.rssi <= -100 ? 0 : ap.rssi >= -50 ? 100 : 2 * (ap.rssi + 100);
+				network.locked = ap.pass.length() > 0;
+				legacyNetworks->push_back(network);
+			}
+		}
+	}
+	server.on("/legacy", HTTP_GET, handleLegacyWifi);
+
+	printf("/wifi, %d renders each, %zu networks, 3 parameters:\n", iterations, legacyNetworks->size());
+	Render legacy = render(server, "/legacy", iterations);
+	Render legacyStatic = render(server, "/legacy?static=1", iterations);
+	report("String::replace reference", legacy);
+	report("String::replace reference, static", legacyStatic);
+
+	Render streamed = render(server, "/wifi", iterations);
+	Render streamedStatic = render(server, "/wifi?static=1", iterations);
+	report("streamed templates", streamed);
+	report("streamed templates, static", streamedStatic);
+
+	wm.setChunkedPages(true);
+	report("streamed templates, chunked", render(server, "/wifi", iterations));
+	wm.setChunkedPages(false);
+
+	wm.setPageCache(true);
+	host::fetch(server, "/wifi");
+	report("page cache hit", render(server, "/wifi", iterations));
+	wm.setPageCache(false);
+
+	bench::check(streamed.allocations < legacy.allocations, "streaming allocates less than the replace chains");
+	bench::check(streamedStatic.allocations < legacyStatic.allocations, "streaming allocates less than the replace chains, static");
+	return bench::finish("render_bench");
+}
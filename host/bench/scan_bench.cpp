@@ -0,0 +1,173 @@
+// Cost of collecting a finished scan in loop(), at 10, 100 and 500 BSSIDs, against a reference that
+// copies, sorts and de-duplicates the way the library did before: every result into a String-holding
+// array, an O(n^2) exchange sort and an O(n^2) String comparison for duplicates. Checks that the
+// networks listed are the strongest of the de-duplicated reference.
+#include <AsyncWiFiManager.h>
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+class LegacyResult {
+public:
+	bool duplicate;
+	String SSID;
+	uint8_t encryptionType;
+	int32_t RSSI;
+	uint8_t *BSSID;
+	int32_t channel;
+	bool isHidden;
+};
+
+static LegacyResult *legacyResults = NULL;
+static int16_t legacyCount = 0;
+
+static void legacyCopy(int16_t n) {
+	delete[] legacyResults;
+	legacyResults = new LegacyResult[n];
+	legacyCount = n;
+
+	for (int16_t i = 0; i < n; i++) {
+		legacyResults[i].duplicate = false;
+		WiFi.getNetworkInfo(i, legacyResults[i].SSID, legacyResults[i].encryptionType, legacyResults[i].RSSI, legacyResults[i].BSSID, legacyResults[i].channel);
+	}
+
+	for (int i = 0; i < n; i++) {
+		for (int j = i + 1; j < n; j++) {
+			if (legacyResults[j].RSSI > legacyResults[i].RSSI) {
+				std::swap(legacyResults[i], legacyResults[j]);
+			}
+		}
+	}
+
+	String cssid;
+	for (int i = 0; i < n; i++) {
+		if (legacyResults[i].duplicate) {
+			continue;
+		}
+		cssid = legacyResults[i].SSID;
+		for (int j = i + 1; j < n; j++) {
+			if (cssid == legacyResults[j].SSID) {
+				legacyResults[j].duplicate = true;
+			}
+		}
+	}
+
+	WiFi.scanDelete();
+}
+
+static double elapsedMicros(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string firstSSID(AsyncWebServer &server) {
+	std::string body = host::fetch(server, "/api/scan").body;
+	size_t start = body.find("\"ssid\":\"");
+	if (start == std::string::npos) {
+		return "";
+	}
+	start += 8;
+	return body.substr(start, body.find('"', start) - start);
+}
+
+// SSID and RSSI of each listed network, in order
+static std::vector<std::pair<std::string, int>> listed(AsyncWebServer &server) {
+	std::vector<std::pair<std::string, int>> networks;
+	std::string body = host::fetch(server, "/api/scan").body;
+	for (size_t start = body.find("\"ssid\":\""); start != std::string::npos; start = body.find("\"ssid\":\"", start)) {
+		start += 8;
+		std::string ssid = body.substr(start, body.find('"', start) - start);
+		size_t rssi = body.find("\"rssi\":", start) + 7;
+		networks.push_back(std::make_pair(ssid, atoi(body.c_str() + rssi)));
+	}
+	return networks;
+}
+
+int main(int argc, char **argv) {
+	int rounds = bench::quick(argc, argv) ? 3 : 100;
+	host::Radio &radio = host::Radio::current();
+	radio.rssiJitter = 0;
+	radio.scanMs = 100;
+
+	AsyncWebServer server(80);
+	DNSServer dns;
+	AsyncWiFiManager wm(&server, &dns);
+	wm.setAPCredentials("Clock-Setup", "");
+	wm.start();
+	bench::check(wm.isAP(), "portal up");
+
+	// loop() with nothing to do, taken off the collecting loop() below
+	std::chrono::steady_clock::time_point idleStart = std::chrono::steady_clock::now();
+	for (int i = 0; i < 1000; i++) {
+		wm.loop();
+	}
+	double idle = elapsedMicros(idleStart) / 1000;
+
+	printf("collecting a scan, %d rounds each, idle loop() %.2f us:\n", rounds, idle);
+	printf("  %5s  %14s %12s  %14s %12s\n", "BSSIDs", "loop() us", "allocations", "reference us", "allocations");
+	const int sizes[] = { 10, 100, 500 };
+	for (int size : sizes) {
+		host::air().clear();
+		host::air().addNeighbours(size, size * 2 / 3);
+
+		double library = 0;
+		uint64_t libraryAllocations = 0;
+		for (int round = 0; round < rounds; round++) {
+			host::fetch(server, "/wifi?scan=1");
+			wm.loop();		// Starts the scan
+			host::advance(radio.scanMs);
+
+			bench::HeapDelta delta;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			wm.loop();
+			library += elapsedMicros(start) - idle;
+			libraryAllocations += delta.allocations();
+		}
+
+		double legacy = 0;
+		uint64_t legacyAllocations = 0;
+		for (int round = 0; round < rounds; round++) {
+			int16_t n = WiFi.scanNetworks(false);
+
+			bench::HeapDelta delta;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			legacyCopy(n);
+			legacy += elapsedMicros(start);
+			legacyAllocations += delta.allocations();
+		}
+
+		printf("  %5d  %14.1f %12.1f  %14.1f %12.1f\n", size, library / rounds, (double)libraryAllocations / rounds,
+				legacy / rounds, (double)legacyAllocations / rounds);
+
+		std::string expected = legacyResults[0].SSID.c_str();
+		bench::check(firstSSID(server) == expected, "strongest network listed first");
+
+		// De-duplicated before the cut: the strongest networks of the de-duplicated reference, one
+		// entry per SSID. Equal signals may come in another order, the reference sort isn't stable.
+		std::vector<std::pair<std::string, int>> networks = listed(server);
+		std::vector<int> expectedRSSIs;
+		for (int i = 0; i < legacyCount && expectedRSSIs.size() < WIFI_MANAGER_MAX_SCAN_RESULTS; i++) {
+			if (!legacyResults[i].duplicate) {
+				expectedRSSIs.push_back(legacyResults[i].RSSI);
+			}
+		}
+		std::set<std::string> ssids;
+		std::vector<int> rssis;
+		for (const std::pair<std::string, int> &network : networks) {
+			ssids.insert(network.first);
+			rssis.push_back(network.second);
+		}
+		bench::check(ssids.size() == networks.size(), "one entry per SSID");
+		bench::check(rssis == expectedRSSIs, "strongest SSIDs kept after removing duplicates");
+		if (size == 500) {
+			bench::check(library < legacy, "collecting 500 BSSIDs is faster than the reference");
+		}
+	}
+
+	delete[] legacyResults;
+	return bench::finish("scan_bench");
+}
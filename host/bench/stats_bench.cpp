@@ -0,0 +1,64 @@
+// Route counters of a WIFI_MANAGER_STATS build against what the client received: each portal page and
+// API route is fetched buffered and as a chunked render, and the bytes counted for the route have to
+// add up to the bodies. Prints the counters of each route.
+#include <AsyncWiFiManager.h>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+class Route {
+public:
+	const char *url;
+	AsyncWiFiManagerStats::Route route;
+};
+
+static const Route routes[] = {
+	{ "/", AsyncWiFiManagerStats::ROUTE_ROOT },
+	{ "/wifi", AsyncWiFiManagerStats::ROUTE_WIFI },
+	{ "/i", AsyncWiFiManagerStats::ROUTE_INFO },
+	{ "/api/scan", AsyncWiFiManagerStats::ROUTE_API_SCAN },
+	{ "/api/info", AsyncWiFiManagerStats::ROUTE_API_INFO },
+	{ "/api/status", AsyncWiFiManagerStats::ROUTE_API_STATUS },
+};
+
+int main(int argc, char **argv) {
+	int iterations = bench::quick(argc, argv) ? 3 : 20;
+
+	host::air().add("HomeNet", "correct horse", -55, 6);
+	host::air().addNeighbours(20, 15);
+
+	AsyncWebServer server(80);
+	DNSServer dns;
+	AsyncWiFiManager wm(&server, &dns);
+	wm.setAPCredentials("Clock-Setup", "");
+	wm.setConnectTimeout(1000);
+	wm.startAsync();
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_PORTAL; }, 10000);
+	bench::runUntil([&]() { wm.loop(); }, [&]() { return host::fetch(server, "/api/scan").body.find("HomeNet") != std::string::npos; }, 10000, 100);
+	bench::check(wm.isAP(), "portal up");
+
+	printf("route counters, %d requests each:\n", iterations);
+	printf("  %-12s %-8s %8s %10s %10s\n", "route", "sent", "requests", "bytes", "received");
+	for (int chunked = 0; chunked < 2; chunked++) {
+		wm.setChunkedPages(chunked == 1);
+		for (const Route &route : routes) {
+			AsyncWiFiManagerStats::RouteStats before = wm.getStats().routes[route.route];
+			size_t received = 0;
+			bool streamed = true;
+			for (int i = 0; i < iterations; i++) {
+				host::Response response = host::fetch(server, route.url);
+				received += response.body.length();
+				streamed &= response.chunked;
+			}
+			AsyncWiFiManagerStats::RouteStats after = wm.getStats().routes[route.route];
+
+			printf("  %-12s %-8s %8u %10u %10zu\n", route.url, streamed ? "chunked" : "buffered",
+					after.requests - before.requests, after.bytes - before.bytes, received);
+			bench::check(after.requests - before.requests == (uint32_t)iterations, "requests counted");
+			bench::check(after.bytes - before.bytes == received, "bytes counted as received");
+		}
+	}
+
+	return bench::finish("stats_bench");
+}
@@ -0,0 +1,133 @@
+// WPS push-button provisioning on the host radio: a device without credentials brings up the
+// portal, startWPS() is called and the router's button pressed. Prints how long from the press to
+// the device being connected, for a press after startWPS() and one just before it, and checks that
+// the credentials go through the save callback, that loop() keeps serving the portal meanwhile and
+// that an unanswered WPS times out and can be started again.
+#include <AsyncWiFiManager.h>
+#include "HostRadio.h"
+#include "Bench.h"
+
+BENCH_MAIN_STATE
+
+static int saves = 0;
+
+static void onSave() {
+	saves++;
+}
+
+class Device {
+public:
+	host::Radio radio;
+	AsyncWebServer server{80};
+	DNSServer dns;
+	AsyncWiFiManager wm{&server, &dns};
+
+	Device() {
+		host::Radio::select(&radio);
+		wm.setAPCredentials("Clock-Setup", "");
+		wm.setSaveConfigCallback(onSave);
+		wm.setConnectTimeout(1000);
+	}
+	~Device() {
+		host::Radio::select(NULL);
+	}
+
+	void loop() {
+		wm.loop();
+	}
+
+	// No credentials, so the start ends in the portal
+	bool portal() {
+		wm.startAsync();
+		return bench::runUntil([&]() { loop(); }, [&]() { return wm.getStartState() == AsyncWiFiManager::START_PORTAL; }, 10000);
+	}
+};
+
+static host::AccessPoint& router() {
+	host::air().clear();	// Also forgets earlier button presses
+	host::AccessPoint &router = host::air().add("HomeNet", "correct horse", -55, 6);
+	host::air().addNeighbours(10, 8);
+	return router;
+}
+
+/**
+ * Press, or startWPS() if the button was pressed first, to connected. 0 if it didn't connect.
+ * pressEarly presses 3 s before startWPS() instead of 5 s after.
+ */
+static unsigned long provision(bool pressEarly) {
+	host::AccessPoint &ap = router();
+	Device device;
+	saves = 0;
+	bench::check(device.portal(), "portal without credentials");
+
+	unsigned long pressed = 0;
+	if (pressEarly) {
+		host::air().pressWPS(ap);
+		bench::runUntil([&]() { device.loop(); }, []() { return false; }, 3000);
+		pressed = millis();
+	}
+	bench::check(device.wm.startWPS(30000) && device.wm.isWPSRunning(), "WPS started");
+	if (!pressEarly) {
+		bench::runUntil([&]() { device.loop(); }, []() { return false; }, 5000);
+		bench::check(device.wm.isWPSRunning(), "waiting for the button");
+		bench::check(host::fetch(device.server, "/wifi").code == 200, "portal served while waiting");
+		pressed = millis();
+		host::air().pressWPS(ap);
+	}
+
+	bench::runUntil([&]() { device.loop(); }, []() { return WiFi.isConnected(); }, 30000);
+	unsigned long took = WiFi.isConnected() ? millis() - pressed : 0;
+	bench::runUntil([&]() { device.loop(); }, []() { return saves > 0; }, 1000);
+	bench::check(!device.wm.isWPSRunning(), "WPS done");
+	bench::check(WiFi.isConnected() && WiFi.SSID() == "HomeNet", "connected with the credentials from WPS");
+	bench::check(saves == 1, "save callback once");
+	return took;
+}
+
+int main(int argc, char **argv) {
+	bench::quick(argc, argv);
+	host::Radio::current().rssiJitter = 0;
+
+	unsigned long after = provision(false);
+	unsigned long before = provision(true);
+
+	// Nobody presses the button: WPS gives up at the timeout, the portal stays, and WPS can be tried again
+	host::AccessPoint &ap = router();
+	unsigned long timedOut;
+	{
+		Device device;
+		saves = 0;
+		device.portal();
+		unsigned long started = millis();
+		bench::check(device.wm.startWPS(10000), "WPS started");
+		bench::runUntil([&]() { device.loop(); }, [&]() { return !device.wm.isWPSRunning(); }, 20000);
+		timedOut = millis() - started;
+		bench::check(timedOut >= 10000 && timedOut < 10500, "WPS given up at the timeout");
+		bench::check(device.wm.isAP() && host::fetch(device.server, "/").code == 200, "portal up after the timeout");
+		bench::check(saves == 0 && !WiFi.isConnected(), "nothing saved");
+
+		bench::check(device.wm.startWPS(30000), "WPS started again");
+		host::air().pressWPS(ap);
+		bench::runUntil([&]() { device.loop(); }, []() { return WiFi.isConnected(); }, 30000);
+		bench::check(WiFi.isConnected(), "connected on the second try");
+	}
+
+	// Not while the device is already trying the router
+	router();
+	{
+		Device device;
+		device.wm.setRouterCredentials("HomeNet", "correct horse");
+		device.wm.startAsync();
+		device.loop();
+		bench::check(device.wm.getStartState() == AsyncWiFiManager::START_CONNECTING, "connecting");
+		bench::check(!device.wm.startWPS(30000) && !device.wm.isWPSRunning(), "WPS refused while connecting");
+	}
+
+	printf("WPS push button, %lu ms to the credentials:\n", host::Radio::current().wpsMs);
+	printf("  pressed after startWPS()  %5.1f s from the press to connected\n", after / 1000.0);
+	printf("  pressed before            %5.1f s from startWPS() to connected\n", before / 1000.0);
+	printf("  not pressed               %5.1f s to giving up, with a 10 s timeout\n", timedOut / 1000.0);
+	bench::check(after > 0 && after < 5000, "connected within seconds of the press");
+	bench::check(before > 0, "an earlier press within the walk time counts");
+	return bench::finish("wps_bench");
+}
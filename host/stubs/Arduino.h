@@ -0,0 +1,43 @@
+// Host stand-in for the Arduino core of the ESP32, enough to build the library on a workstation.
+// millis(), micros() and delay() run on the virtual clock of HostSupport.h.
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "pgmspace.h"
+#include "esp_attr.h"
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+#include "HardwareSerial.h"
+#include "Esp.h"
+
+#define ESP_ARDUINO_VERSION_MAJOR 2
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// Only the ESP8266 build uses these, the ESP32 build takes a mutex instead
+inline void noInterrupts() {
+}
+inline void interrupts() {
+}
+
+char* dtostrf(double number, signed char width, unsigned char prec, char *s);
+
+#endif
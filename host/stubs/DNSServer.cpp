@@ -0,0 +1,121 @@
+#include "DNSServer.h"
+#include <lwip/sockets.h>
+
+#define DNS_HEADER_SIZE 12
+#define UDP_RX_BUFFER 1460
+
+DNSServer::DNSServer() {
+}
+
+DNSServer::~DNSServer() {
+	stop();
+}
+
+void DNSServer::setErrorReplyCode(const DNSReplyCode &replyCode) {
+	_errorReplyCode = replyCode;
+}
+
+void DNSServer::setTTL(const uint32_t &ttl) {
+	_ttl = ttl;
+}
+
+bool DNSServer::start(const uint16_t &port, const String &domainName, const IPAddress &resolvedIP) {
+	stop();
+	_domainName = domainName;
+	_domainName.toLowerCase();
+	for (int i = 0; i < 4; i++) {
+		_resolvedIP[i] = resolvedIP[i];
+	}
+
+	_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (_socket < 0) {
+		return false;
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(_socket);
+		_socket = -1;
+		return false;
+	}
+	return true;
+}
+
+void DNSServer::stop() {
+	if (_socket >= 0) {
+		close(_socket);
+		_socket = -1;
+	}
+}
+
+/** Whether the question names the configured domain ("*" matches all), end is set past its class */
+bool DNSServer::_matches(const uint8_t *query, size_t length, size_t &end) {
+	String name;
+	size_t pos = DNS_HEADER_SIZE;
+	while (pos < length && query[pos] != 0) {
+		uint8_t label = query[pos++];
+		if (pos + label > length) {
+			return false;
+		}
+		if (name.length() > 0) {
+			name += '.';
+		}
+		name.concat((const char *)query + pos, label);
+		pos += label;
+	}
+	if (pos + 5 > length) {
+		return false;
+	}
+	end = pos + 5;
+	name.toLowerCase();
+	return _domainName == "*" || name == _domainName;
+}
+
+void DNSServer::processNextRequest() {
+	if (_socket < 0) {
+		return;
+	}
+
+	// WiFiUDP::parsePacket()
+	uint8_t *rx = new uint8_t[UDP_RX_BUFFER];
+	struct sockaddr_in from;
+	socklen_t fromLength = sizeof(from);
+	int size = recvfrom(_socket, rx, UDP_RX_BUFFER, MSG_DONTWAIT, (struct sockaddr *)&from, &fromLength);
+	if (size <= 0) {
+		delete[] rx;
+		return;
+	}
+
+	// processNextRequest() reads the packet into a buffer of its own, with room for the answer
+	uint8_t *buffer = new uint8_t[size + 16];
+	memcpy(buffer, rx, size);
+	delete[] rx;
+
+	size_t length = 0;
+	size_t end;
+	bool query = size >= DNS_HEADER_SIZE && (buffer[2] & 0x80) == 0 && buffer[4] == 0 && buffer[5] == 1;
+	if (query && _matches(buffer, size, end)) {
+		buffer[2] = 0x84 | (buffer[2] & 0x01);
+		buffer[3] = 0x80;
+		buffer[7] = 1;
+		buffer[8] = buffer[9] = buffer[10] = buffer[11] = 0;
+		uint8_t answer[16] = { 0xC0, DNS_HEADER_SIZE, 0, 1, 0, 1,
+			(uint8_t)(_ttl >> 24), (uint8_t)(_ttl >> 16), (uint8_t)(_ttl >> 8), (uint8_t)_ttl, 0, 4,
+			_resolvedIP[0], _resolvedIP[1], _resolvedIP[2], _resolvedIP[3] };
+		memcpy(buffer + end, answer, sizeof(answer));
+		length = end + sizeof(answer);
+	} else if (size >= DNS_HEADER_SIZE) {
+		buffer[2] |= 0x80;
+		buffer[3] = (uint8_t)_errorReplyCode;
+		length = DNS_HEADER_SIZE;
+		memset(buffer + 6, 0, 6);
+		buffer[4] = buffer[5] = 0;
+	}
+	if (length > 0) {
+		sendto(_socket, buffer, length, 0, (struct sockaddr *)&from, fromLength);
+	}
+	delete[] buffer;
+}
@@ -0,0 +1,44 @@
+// Host stand-in for the DNSServer library of the ESP32 core, for comparing against CaptiveDNSServer.
+// It does what the stock server does per packet: WiFiUDP::parsePacket() copies the datagram into a
+// freshly allocated 1460 byte buffer, processNextRequest() copies it again into a buffer of its own
+// and answers one query per call.
+#ifndef HOST_DNSSERVER_H
+#define HOST_DNSSERVER_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+enum class DNSReplyCode {
+	NoError = 0,
+	FormError = 1,
+	ServerFailure = 2,
+	NonExistentDomain = 3,
+	NotImplemented = 4,
+	Refused = 5,
+	YXDomain = 6,
+	YXRRSet = 7,
+	NXRRSet = 8
+};
+
+class DNSServer {
+public:
+	DNSServer();
+	~DNSServer();
+
+	void processNextRequest();
+	void setErrorReplyCode(const DNSReplyCode &replyCode);
+	void setTTL(const uint32_t &ttl);
+	bool start(const uint16_t &port, const String &domainName, const IPAddress &resolvedIP);
+	void stop();
+
+private:
+	int _socket = -1;
+	uint32_t _ttl = 60;
+	DNSReplyCode _errorReplyCode = DNSReplyCode::NonExistentDomain;
+	String _domainName;
+	uint8_t _resolvedIP[4];
+
+	bool _matches(const uint8_t *query, size_t length, size_t &end);
+};
+
+#endif
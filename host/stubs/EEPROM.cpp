@@ -0,0 +1,70 @@
+#include "EEPROM.h"
+#include <string.h>
+
+EEPROMClass EEPROM;
+
+/** Like the core, reallocates the buffer and reads it back from flash. Erased flash reads as 0xFF. */
+bool EEPROMClass::begin(size_t size) {
+	if (size == 0) {
+		return false;
+	}
+	if (_data != NULL && size == _size) {
+		return true;
+	}
+	delete[] _data;
+	_data = new uint8_t[size];
+	_size = size;
+	memset(_data, 0xFF, size);
+	if (_flash != NULL) {
+		memcpy(_data, _flash, size < _flashSize ? size : _flashSize);
+	}
+	begins++;
+	return true;
+}
+
+void EEPROMClass::end() {
+	delete[] _data;
+	_data = NULL;
+	_size = 0;
+}
+
+bool EEPROMClass::commit() {
+	if (_data == NULL) {
+		return false;
+	}
+	if (_flashSize < _size) {
+		uint8_t *flash = new uint8_t[_size];
+		memset(flash, 0xFF, _size);
+		if (_flash != NULL) {
+			memcpy(flash, _flash, _flashSize);
+		}
+		delete[] _flash;
+		_flash = flash;
+		_flashSize = _size;
+	}
+	memcpy(_flash, _data, _size);
+	commits++;
+	return true;
+}
+
+size_t EEPROMClass::length() {
+	return _size;
+}
+
+uint8_t* EEPROMClass::getDataPtr() {
+	return _data;
+}
+
+const uint8_t* EEPROMClass::getConstDataPtr() const {
+	return _data;
+}
+
+uint8_t EEPROMClass::read(int address) {
+	return address >= 0 && (size_t)address < _size ? _data[address] : 0;
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+	if (address >= 0 && (size_t)address < _size) {
+		_data[address] = value;
+	}
+}
@@ -0,0 +1,30 @@
+// Emulated flash sector in RAM, with the ESP32 core's API
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class EEPROMClass {
+public:
+	bool begin(size_t size);
+	void end();
+	bool commit();
+	size_t length();
+	uint8_t* getDataPtr();
+	const uint8_t* getConstDataPtr() const;
+	uint8_t read(int address);
+	void write(int address, uint8_t value);
+
+	uint32_t begins = 0;		// begin() calls that (re)allocated the buffer
+	uint32_t commits = 0;
+private:
+	uint8_t *_data = NULL;
+	size_t _size = 0;
+	uint8_t *_flash = NULL;		// What the last commit left in flash, survives end()
+	size_t _flashSize = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
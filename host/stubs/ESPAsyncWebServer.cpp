@@ -0,0 +1,617 @@
+#include "ESPAsyncWebServer.h"
+#include "HostSupport.h"
+
+bool ON_STA_FILTER(AsyncWebServerRequest *request) {
+	return WiFi.localIP() == request->client()->localIP();
+}
+
+bool ON_AP_FILTER(AsyncWebServerRequest *request) {
+	return WiFi.localIP() != request->client()->localIP();
+}
+
+/*
+ * Responses
+ */
+
+static const char* statusText(int code) {
+	switch (code) {
+	case 200: return "OK";
+	case 204: return "No Content";
+	case 302: return "Found";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 404: return "Not Found";
+	case 406: return "Not Acceptable";
+	case 409: return "Conflict";
+	case 500: return "Internal Server Error";
+	case 503: return "Service Unavailable";
+	default: return "";
+	}
+}
+
+AsyncWebServerResponse::AsyncWebServerResponse() {
+}
+
+AsyncWebServerResponse::~AsyncWebServerResponse() {
+	for (AsyncWebHeader *header : _headers) {
+		delete header;
+	}
+}
+
+void AsyncWebServerResponse::addHeader(const String &name, const String &value) {
+	_headers.push_back(new AsyncWebHeader(name, value));
+}
+
+AsyncBasicResponse::AsyncBasicResponse(int code, const String &contentType, const String &content) : _body(content) {
+	_code = code;
+	_contentType = contentType;
+	_contentLength = _body.length();
+	if (_contentLength > 0 && _contentType.length() == 0) {
+		_contentType = "text/plain";
+	}
+}
+
+size_t AsyncBasicResponse::_fill(uint8_t *buffer, size_t maxLen) {
+	size_t count = std::min(maxLen, _body.length() - _sent);
+	memcpy(buffer, _body.c_str() + _sent, count);
+	_sent += count;
+	return count;
+}
+
+AsyncProgmemResponse::AsyncProgmemResponse(int code, const String &contentType, const uint8_t *content, size_t len) : _data(content) {
+	_code = code;
+	_contentType = contentType;
+	_contentLength = len;
+}
+
+size_t AsyncProgmemResponse::_fill(uint8_t *buffer, size_t maxLen) {
+	size_t count = std::min(maxLen, _contentLength - _sent);
+	memcpy_P(buffer, _data + _sent, count);
+	_sent += count;
+	return count;
+}
+
+AsyncCallbackResponse::AsyncCallbackResponse(const String &contentType, size_t len, AwsResponseFiller callback) : _callback(callback) {
+	_code = 200;
+	_contentType = contentType;
+	_contentLength = len;
+}
+
+size_t AsyncCallbackResponse::_fill(uint8_t *buffer, size_t maxLen) {
+	if (!_chunked) {
+		maxLen = std::min(maxLen, _contentLength - _index);
+		if (maxLen == 0) {
+			return 0;
+		}
+	}
+	size_t count = _callback(buffer, maxLen, _index);
+	_index += count;
+	return count;
+}
+
+AsyncChunkedResponse::AsyncChunkedResponse(const String &contentType, AwsResponseFiller callback)
+		: AsyncCallbackResponse(contentType, 0, callback) {
+	_chunked = true;
+	_sendContentLength = false;
+}
+
+AsyncResponseStream::AsyncResponseStream(const String &contentType, size_t bufferSize) : _size(bufferSize) {
+	_code = 200;
+	_contentType = contentType;
+	_buffer = new uint8_t[_size];
+}
+
+AsyncResponseStream::~AsyncResponseStream() {
+	delete[] _buffer;
+}
+
+size_t AsyncResponseStream::write(const uint8_t *data, size_t len) {
+	if (_length + len > _size) {
+		// cbuf::resizeAdd(), by exactly what doesn't fit
+		size_t size = _length + len;
+		uint8_t *buffer = new uint8_t[size];
+		memcpy(buffer, _buffer, _length);
+		delete[] _buffer;
+		_buffer = buffer;
+		_size = size;
+	}
+	memcpy(_buffer + _length, data, len);
+	_length += len;
+	_contentLength = _length;
+	return len;
+}
+
+size_t AsyncResponseStream::write(uint8_t data) {
+	return write(&data, 1);
+}
+
+size_t AsyncResponseStream::_fill(uint8_t *buffer, size_t maxLen) {
+	size_t count = std::min(maxLen, available());
+	memcpy(buffer, _buffer + _read, count);
+	_read += count;
+	return count;
+}
+
+/*
+ * Requests
+ */
+
+AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer *server) : _server(server) {
+}
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+	for (AsyncWebHeader *header : _headers) {
+		delete header;
+	}
+	for (AsyncWebParameter *param : _params) {
+		delete param;
+	}
+	delete _response;
+}
+
+bool AsyncWebServerRequest::hasHeader(const String &name) const {
+	return getHeader(name) != NULL;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String &name) const {
+	for (AsyncWebHeader *header : _headers) {
+		if (header->name().equalsIgnoreCase(name)) {
+			return header;
+		}
+	}
+	return NULL;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(size_t num) const {
+	return num < _headers.size() ? _headers[num] : NULL;
+}
+
+bool AsyncWebServerRequest::hasParam(const String &name, bool post, bool file) const {
+	return getParam(name, post, file) != NULL;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(const String &name, bool post, bool file) const {
+	for (AsyncWebParameter *param : _params) {
+		if (param->name() == name && param->isPost() == post && param->isFile() == file) {
+			return param;
+		}
+	}
+	return NULL;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(size_t num) const {
+	return num < _params.size() ? _params[num] : NULL;
+}
+
+static const String emptyString;
+
+const String& AsyncWebServerRequest::arg(const String &name) const {
+	for (AsyncWebParameter *param : _params) {
+		if (param->name() == name) {
+			return param->value();
+		}
+	}
+	return emptyString;
+}
+
+const String& AsyncWebServerRequest::arg(size_t i) const {
+	return i < _params.size() ? _params[i]->value() : emptyString;
+}
+
+const String& AsyncWebServerRequest::argName(size_t i) const {
+	return i < _params.size() ? _params[i]->name() : emptyString;
+}
+
+bool AsyncWebServerRequest::hasArg(const char *name) const {
+	for (AsyncWebParameter *param : _params) {
+		if (param->name() == name) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+	delete _response;
+	_response = response;
+}
+
+void AsyncWebServerRequest::send(int code, const String &contentType, const String &content) {
+	send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::redirect(const String &url) {
+	AsyncWebServerResponse *response = beginResponse(302);
+	response->addHeader("Location", url);
+	send(response);
+}
+
+void AsyncWebServerRequest::onDisconnect(ArDisconnectHandler fn) {
+	_onDisconnect = fn;
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String &contentType, const String &content) {
+	return new AsyncBasicResponse(code, contentType, content);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(const String &contentType, size_t len, AwsResponseFiller callback) {
+	return new AsyncCallbackResponse(contentType, len, callback);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginChunkedResponse(const String &contentType, AwsResponseFiller callback) {
+	return new AsyncChunkedResponse(contentType, callback);
+}
+
+AsyncResponseStream* AsyncWebServerRequest::beginResponseStream(const String &contentType, size_t bufferSize) {
+	return new AsyncResponseStream(contentType, bufferSize);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len) {
+	return new AsyncProgmemResponse(code, contentType, content, len);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String &contentType, PGM_P content) {
+	return beginResponse_P(code, contentType, (const uint8_t *)content, strlen_P(content));
+}
+
+/*
+ * Handlers
+ */
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest *request) {
+	if (!_onRequest || !(_method & request->method())) {
+		return false;
+	}
+	if (_uri.length() > 0 && _uri != request->url() && !request->url().startsWith(_uri + "/")) {
+		return false;
+	}
+	return true;
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest *request) {
+	_onRequest(request);
+}
+
+AsyncEventSource::AsyncEventSource(const String &url) : _url(url) {
+}
+
+AsyncEventSource::~AsyncEventSource() {
+	close();
+	host::Untracked untracked;
+	_clients.clear();
+	_lastConnected.reset();
+}
+
+void AsyncEventSource::close() {
+	for (const std::shared_ptr<host::EventClient> &client : _clients) {
+		client->open = false;
+	}
+}
+
+size_t AsyncEventSource::count() const {
+	size_t open = 0;
+	for (const std::shared_ptr<host::EventClient> &client : _clients) {
+		if (client->open) {
+			open++;
+		}
+	}
+	return open;
+}
+
+/** The message is formatted for all clients at once and queued on each, as the library does */
+void AsyncEventSource::send(const char *message, const char *event, uint32_t id, uint32_t reconnect) {
+	String formatted;
+	if (event != NULL) {
+		formatted += "event: ";
+		formatted += event;
+		formatted += "\r\n";
+	}
+	formatted += "data: ";
+	formatted += message;
+	formatted += "\r\n\r\n";
+
+	host::Untracked untracked;
+	for (const std::shared_ptr<host::EventClient> &client : _clients) {
+		if (client->open) {
+			host::EventClient::Message sent;
+			sent.event = event != NULL ? event : "";
+			sent.data = message;
+			client->messages.push_back(sent);
+		}
+	}
+}
+
+bool AsyncEventSource::canHandle(AsyncWebServerRequest *request) {
+	return request->method() == HTTP_GET && request->url() == _url;
+}
+
+void AsyncEventSource::handleRequest(AsyncWebServerRequest *request) {
+	{
+		host::Untracked untracked;
+		_lastConnected = std::make_shared<host::EventClient>();
+		_clients.push_back(_lastConnected);
+	}
+	request->send(request->beginResponse(200, "text/event-stream"));
+}
+
+/*
+ * Server
+ */
+
+AsyncWebServer::AsyncWebServer(uint16_t port) : _port(port) {
+}
+
+AsyncWebServer::~AsyncWebServer() {
+	reset();
+}
+
+void AsyncWebServer::begin() {
+	_begun = true;
+}
+
+void AsyncWebServer::end() {
+	_begun = false;
+}
+
+AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler *handler) {
+	_handlers.push_back(handler);
+	return *handler;
+}
+
+bool AsyncWebServer::removeHandler(AsyncWebHandler *handler) {
+	for (size_t i = 0; i < _handlers.size(); i++) {
+		if (_handlers[i] == handler) {
+			_handlers.erase(_handlers.begin() + i);
+			delete handler;
+			return true;
+		}
+	}
+	return false;
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char *uri, ArRequestHandlerFunction onRequest) {
+	return on(uri, HTTP_ANY, onRequest);
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest) {
+	AsyncCallbackWebHandler *handler = new AsyncCallbackWebHandler(uri, method, onRequest);
+	addHandler(handler);
+	return *handler;
+}
+
+void AsyncWebServer::onNotFound(ArRequestHandlerFunction fn) {
+	_notFound = fn;
+}
+
+void AsyncWebServer::reset() {
+	for (AsyncWebHandler *handler : _handlers) {
+		delete handler;
+	}
+	_handlers.clear();
+	_notFound = NULL;
+}
+
+void AsyncWebServer::_handle(AsyncWebServerRequest *request) {
+	for (AsyncWebHandler *handler : _handlers) {
+		if (handler->filter(request) && handler->canHandle(request)) {
+			request->_handler = handler;
+			handler->handleRequest(request);
+			return;
+		}
+	}
+	if (_notFound) {
+		_notFound(request);
+	} else {
+		request->send(404);
+	}
+}
+
+/*
+ * Host side
+ */
+
+namespace host {
+
+size_t sendWindow = 5744;
+
+std::string urlDecode(const std::string &text) {
+	std::string decoded;
+	for (size_t i = 0; i < text.length(); i++) {
+		char c = text[i];
+		if (c == '+') {
+			c = ' ';
+		} else if (c == '%' && i + 2 < text.length()) {
+			c = (char)strtol(text.substr(i + 1, 2).c_str(), NULL, 16);
+			i += 2;
+		}
+		decoded += c;
+	}
+	return decoded;
+}
+
+static void addParams(AsyncWebServerRequest *request, const std::string &encoded, bool form) {
+	size_t start = 0;
+	while (start < encoded.length()) {
+		size_t end = encoded.find('&', start);
+		if (end == std::string::npos) {
+			end = encoded.length();
+		}
+		std::string pair = encoded.substr(start, end - start);
+		size_t equals = pair.find('=');
+		std::string name = urlDecode(pair.substr(0, equals));
+		std::string value = equals == std::string::npos ? "" : urlDecode(pair.substr(equals + 1));
+		if (name.length() > 0) {
+			request->_params.push_back(new AsyncWebParameter(String(name.c_str()), String(value.c_str()), form));
+		}
+		start = end + 1;
+	}
+}
+
+static WebRequestMethodComposite parseMethod(const std::string &method) {
+	if (method == "POST") {
+		return HTTP_POST;
+	} else if (method == "HEAD") {
+		return HTTP_HEAD;
+	} else if (method == "PUT") {
+		return HTTP_PUT;
+	} else if (method == "DELETE") {
+		return HTTP_DELETE;
+	} else if (method == "OPTIONS") {
+		return HTTP_OPTIONS;
+	}
+	return HTTP_GET;
+}
+
+bool serve(AsyncWebServer &server, const Request &request, ResponseSink &sink, std::shared_ptr<EventClient> *events) {
+	if (!server.begun()) {
+		return false;
+	}
+
+	// What the server allocates while parsing
+	AsyncWebServerRequest *parsed = new AsyncWebServerRequest(&server);
+	parsed->_method = parseMethod(request.method);
+	size_t query = request.url.find('?');
+	parsed->_url = request.url.substr(0, query).c_str();
+	parsed->_host = request.host.c_str();
+	parsed->_client._localIP = request.ap ? WiFi.softAPIP() : WiFi.localIP();
+	parsed->_client._remoteIP = request.ap ? IPAddress(192, 168, 4, 2) : IPAddress(WiFi.gatewayIP());
+	parsed->_headers.push_back(new AsyncWebHeader("Host", request.host.c_str()));
+	for (const std::pair<std::string, std::string> &header : request.headers) {
+		parsed->_headers.push_back(new AsyncWebHeader(header.first.c_str(), header.second.c_str()));
+	}
+	if (query != std::string::npos) {
+		addParams(parsed, request.url.substr(query + 1), false);
+	}
+	if (request.form.length() > 0) {
+		parsed->_contentType = "application/x-www-form-urlencoded";
+		addParams(parsed, request.form, true);
+	}
+
+	server._handle(parsed);
+
+	AsyncWebServerResponse *response = parsed->_response;
+	if (response != NULL) {
+		// _assembleHead()
+		String head = String("HTTP/1.1 ") + response->_code + " " + statusText(response->_code) + "\r\n";
+		if (response->_sendContentLength) {
+			head += String("Content-Length: ") + (unsigned)response->_contentLength + "\r\n";
+		}
+		if (response->_contentType.length() > 0) {
+			head += String("Content-Type: ") + response->_contentType + "\r\n";
+		}
+		for (AsyncWebHeader *header : response->_headers) {
+			head += header->name() + ": " + header->value() + "\r\n";
+		}
+		if (response->_chunked) {
+			head += "Transfer-Encoding: chunked\r\n";
+		}
+		head += "\r\n";
+
+		sink.status(response->_code, response->_contentType.c_str(), response->_chunked, response->_contentLength);
+		for (AsyncWebHeader *header : response->_headers) {
+			sink.header(header->name().c_str(), header->value().c_str());
+		}
+
+		if (response->_direct()) {
+			// AsyncBasicResponse hands headers and body to the connection straight from its own copy
+			if (response->_contentLength > 0) {
+				sink.body((const uint8_t *)response->_content(), response->_contentLength);
+			}
+		} else {
+			size_t headLength = head.length();
+			size_t sent = 0;
+			for (;;) {
+				// AsyncAbstractResponse::_ack()
+				size_t space = sendWindow - headLength - (response->_chunked ? 8 : 0);
+				headLength = 0;
+				uint8_t *buffer = new uint8_t[sendWindow];
+				size_t length = response->_fill(buffer, space);
+				if (length > 0) {
+					sink.body(buffer, length);
+				}
+				delete[] buffer;
+				sent += length;
+				if (length == 0 || (!response->_chunked && sent >= response->_contentLength)) {
+					break;
+				}
+			}
+		}
+
+		AsyncEventSource *source = dynamic_cast<AsyncEventSource *>(parsed->_handler);
+		if (source != NULL && events != NULL) {
+			Untracked untracked;
+			*events = source->_lastConnected;
+		}
+	}
+
+	if (parsed->_onDisconnect) {
+		parsed->_onDisconnect();
+	}
+	bool answered = response != NULL;
+	delete parsed;
+	return answered;
+}
+
+class CollectingSink : public ResponseSink {
+public:
+	Response &response;
+
+	CollectingSink(Response &response) : response(response) {
+	}
+	void status(int code, const char *contentType, bool chunked, size_t contentLength) override {
+		Untracked untracked;
+		response.answered = true;
+		response.code = code;
+		response.contentType = contentType;
+		response.chunked = chunked;
+	}
+	void header(const char *name, const char *value) override {
+		Untracked untracked;
+		response.headers.push_back(std::make_pair(std::string(name), std::string(value)));
+	}
+	void body(const uint8_t *data, size_t length) override {
+		Untracked untracked;
+		response.body.append((const char *)data, length);
+		response.fills++;
+	}
+};
+
+Response fetch(AsyncWebServer &server, const Request &request) {
+	Response response;
+	CollectingSink sink(response);
+	response.started = serve(server, request, sink, &response.events) || server.begun();
+	return response;
+}
+
+Response fetch(AsyncWebServer &server, const char *url) {
+	std::unique_ptr<Request> request;
+	{
+		Untracked untracked;
+		request.reset(new Request());
+		request->url = url;
+	}
+	return fetch(server, *request);
+}
+
+Response post(AsyncWebServer &server, const char *url, const char *form) {
+	std::unique_ptr<Request> request;
+	{
+		Untracked untracked;
+		request.reset(new Request());
+		request->method = "POST";
+		request->url = url;
+		request->form = form;
+	}
+	return fetch(server, *request);
+}
+
+const char* Response::header(const char *name) const {
+	for (const std::pair<std::string, std::string> &header : headers) {
+		if (strcasecmp(header.first.c_str(), name) == 0) {
+			return header.second.c_str();
+		}
+	}
+	return NULL;
+}
+
+}
@@ -0,0 +1,430 @@
+// Host stand-in for ESPAsyncWebServer, with the semantics of the me-no-dev version the library is
+// written against: handlers are tried in the order they were added, removeHandler() deletes, and a
+// response is sent after the handler returns. Responses other than AsyncBasicResponse are pulled
+// through a buffer allocated per fill, sized to what the connection takes, as AsyncAbstractResponse
+// does on a device.
+//
+// host::serve() runs one request through a server and hands the response to a sink; host::fetch()
+// collects it, for benches calling the portal in-process.
+#ifndef HOST_ESPASYNCWEBSERVER_H
+#define HOST_ESPASYNCWEBSERVER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "StreamString.h"
+#include "WiFi.h"
+
+class AsyncWebServer;
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+class AsyncWebHandler;
+
+typedef enum {
+	HTTP_GET = 0b00000001,
+	HTTP_POST = 0b00000010,
+	HTTP_DELETE = 0b00000100,
+	HTTP_PUT = 0b00001000,
+	HTTP_PATCH = 0b00010000,
+	HTTP_HEAD = 0b00100000,
+	HTTP_OPTIONS = 0b01000000,
+	HTTP_ANY = 0b01111111
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<bool(AsyncWebServerRequest *request)> ArRequestFilterFunction;
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+typedef std::function<void()> ArDisconnectHandler;
+
+bool ON_STA_FILTER(AsyncWebServerRequest *request);
+bool ON_AP_FILTER(AsyncWebServerRequest *request);
+
+class AsyncClient {
+public:
+	IPAddress localIP() const {
+		return _localIP;
+	}
+	IPAddress remoteIP() const {
+		return _remoteIP;
+	}
+
+	IPAddress _localIP;		// Address of the interface the request came in on
+	IPAddress _remoteIP;
+};
+
+class AsyncWebHeader {
+public:
+	AsyncWebHeader(const String &name, const String &value) : _name(name), _value(value) {
+	}
+	const String& name() const {
+		return _name;
+	}
+	const String& value() const {
+		return _value;
+	}
+
+private:
+	String _name;
+	String _value;
+};
+
+class AsyncWebParameter {
+public:
+	AsyncWebParameter(const String &name, const String &value, bool form = false, bool file = false)
+			: _name(name), _value(value), _isForm(form), _isFile(file) {
+	}
+	const String& name() const {
+		return _name;
+	}
+	const String& value() const {
+		return _value;
+	}
+	bool isPost() const {
+		return _isForm;
+	}
+	bool isFile() const {
+		return _isFile;
+	}
+
+private:
+	String _name;
+	String _value;
+	bool _isForm;
+	bool _isFile;
+};
+
+/*
+ * Responses
+ */
+
+class AsyncWebServerResponse {
+public:
+	AsyncWebServerResponse();
+	virtual ~AsyncWebServerResponse();
+
+	void setCode(int code) {
+		_code = code;
+	}
+	void setContentLength(size_t len) {
+		_contentLength = len;
+	}
+	void setContentType(const String &type) {
+		_contentType = type;
+	}
+	void addHeader(const String &name, const String &value);
+
+	int _code = 200;
+	String _contentType;
+	size_t _contentLength = 0;
+	bool _chunked = false;
+	bool _sendContentLength = true;
+	std::vector<AsyncWebHeader *> _headers;
+
+	// Next part of the body into buffer, 0 when there is no more
+	virtual size_t _fill(uint8_t *buffer, size_t maxLen) = 0;
+	// Whether the body is copied out of the response itself, without a fill buffer (AsyncBasicResponse)
+	virtual bool _direct() const {
+		return false;
+	}
+	virtual const char* _content() const {
+		return NULL;
+	}
+};
+
+class AsyncBasicResponse : public AsyncWebServerResponse {
+public:
+	AsyncBasicResponse(int code, const String &contentType = String(), const String &content = String());
+	size_t _fill(uint8_t *buffer, size_t maxLen) override;
+	bool _direct() const override {
+		return true;
+	}
+	const char* _content() const override {
+		return _body.c_str();
+	}
+
+private:
+	String _body;
+	size_t _sent = 0;
+};
+
+class AsyncProgmemResponse : public AsyncWebServerResponse {
+public:
+	AsyncProgmemResponse(int code, const String &contentType, const uint8_t *content, size_t len);
+	size_t _fill(uint8_t *buffer, size_t maxLen) override;
+
+private:
+	const uint8_t *_data;
+	size_t _sent = 0;
+};
+
+class AsyncCallbackResponse : public AsyncWebServerResponse {
+public:
+	AsyncCallbackResponse(const String &contentType, size_t len, AwsResponseFiller callback);
+	size_t _fill(uint8_t *buffer, size_t maxLen) override;
+
+protected:
+	AwsResponseFiller _callback;
+	size_t _index = 0;
+};
+
+class AsyncChunkedResponse : public AsyncCallbackResponse {
+public:
+	AsyncChunkedResponse(const String &contentType, AwsResponseFiller callback);
+};
+
+/** Body collected in a growing buffer: starts at bufferSize, grows by what a write needs, as cbuf does */
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+public:
+	AsyncResponseStream(const String &contentType, size_t bufferSize);
+	~AsyncResponseStream();
+	size_t _fill(uint8_t *buffer, size_t maxLen) override;
+	size_t write(const uint8_t *data, size_t len) override;
+	size_t write(uint8_t data) override;
+	using Print::write;
+	size_t available() const {
+		return _length - _read;
+	}
+
+private:
+	uint8_t *_buffer;
+	size_t _size;
+	size_t _length = 0;
+	size_t _read = 0;
+};
+
+/*
+ * Requests
+ */
+
+class AsyncWebServerRequest {
+public:
+	AsyncWebServerRequest(AsyncWebServer *server);
+	~AsyncWebServerRequest();
+
+	AsyncClient* client() {
+		return &_client;
+	}
+	WebRequestMethodComposite method() const {
+		return _method;
+	}
+	const String& url() const {
+		return _url;
+	}
+	const String& host() const {
+		return _host;
+	}
+	const String& contentType() const {
+		return _contentType;
+	}
+
+	size_t headers() const {
+		return _headers.size();
+	}
+	bool hasHeader(const String &name) const;
+	AsyncWebHeader* getHeader(const String &name) const;
+	AsyncWebHeader* getHeader(size_t num) const;
+
+	size_t params() const {
+		return _params.size();
+	}
+	bool hasParam(const String &name, bool post = false, bool file = false) const;
+	AsyncWebParameter* getParam(const String &name, bool post = false, bool file = false) const;
+	AsyncWebParameter* getParam(size_t num) const;
+
+	size_t args() const {
+		return params();
+	}
+	const String& arg(const String &name) const;
+	const String& arg(size_t i) const;
+	const String& argName(size_t i) const;
+	bool hasArg(const char *name) const;
+
+	void send(AsyncWebServerResponse *response);
+	void send(int code, const String &contentType = String(), const String &content = String());
+	void redirect(const String &url);
+	void onDisconnect(ArDisconnectHandler fn);
+
+	AsyncWebServerResponse* beginResponse(int code, const String &contentType = String(), const String &content = String());
+	AsyncWebServerResponse* beginResponse(const String &contentType, size_t len, AwsResponseFiller callback);
+	AsyncWebServerResponse* beginChunkedResponse(const String &contentType, AwsResponseFiller callback);
+	AsyncResponseStream* beginResponseStream(const String &contentType, size_t bufferSize = 1460);
+	AsyncWebServerResponse* beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len);
+	AsyncWebServerResponse* beginResponse_P(int code, const String &contentType, PGM_P content);
+
+	// Set up by whatever received the request, see host::serve()
+	AsyncWebServer *_server;
+	AsyncClient _client;
+	WebRequestMethodComposite _method = HTTP_GET;
+	String _url;
+	String _host;
+	String _contentType;
+	std::vector<AsyncWebHeader *> _headers;
+	std::vector<AsyncWebParameter *> _params;
+	AsyncWebServerResponse *_response = NULL;
+	ArDisconnectHandler _onDisconnect;
+	AsyncWebHandler *_handler = NULL;
+};
+
+/*
+ * Handlers
+ */
+
+class AsyncWebHandler {
+public:
+	virtual ~AsyncWebHandler() {
+	}
+	AsyncWebHandler& setFilter(ArRequestFilterFunction fn) {
+		_filter = fn;
+		return *this;
+	}
+	bool filter(AsyncWebServerRequest *request) {
+		return _filter == NULL || _filter(request);
+	}
+	virtual bool canHandle(AsyncWebServerRequest *request) {
+		return false;
+	}
+	virtual void handleRequest(AsyncWebServerRequest *request) {
+	}
+
+protected:
+	ArRequestFilterFunction _filter;
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+	AsyncCallbackWebHandler(const String &uri, WebRequestMethodComposite method, ArRequestHandlerFunction fn)
+			: _uri(uri), _method(method), _onRequest(fn) {
+	}
+	bool canHandle(AsyncWebServerRequest *request) override;
+	void handleRequest(AsyncWebServerRequest *request) override;
+
+private:
+	String _uri;
+	WebRequestMethodComposite _method;
+	ArRequestHandlerFunction _onRequest;
+};
+
+namespace host {
+
+// One browser tab listening on an AsyncEventSource, with everything it received
+class EventClient {
+public:
+	class Message {
+	public:
+		std::string event;
+		std::string data;
+	};
+	std::vector<Message> messages;
+	bool open = true;
+};
+
+}
+
+/** Server-sent events. Clients connect with a GET of its URL and stay until closed. */
+class AsyncEventSource : public AsyncWebHandler {
+public:
+	AsyncEventSource(const String &url);
+	~AsyncEventSource();
+
+	void close();
+	void send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0);
+	size_t count() const;
+
+	bool canHandle(AsyncWebServerRequest *request) override;
+	void handleRequest(AsyncWebServerRequest *request) override;
+
+	std::shared_ptr<host::EventClient> _lastConnected;	// For host::serve()
+
+private:
+	String _url;
+	std::vector<std::shared_ptr<host::EventClient> > _clients;
+};
+
+/*
+ * Server
+ */
+
+class AsyncWebServer {
+public:
+	AsyncWebServer(uint16_t port);
+	~AsyncWebServer();
+
+	void begin();
+	void end();
+	bool begun() const {
+		return _begun;
+	}
+
+	AsyncWebHandler& addHandler(AsyncWebHandler *handler);
+	bool removeHandler(AsyncWebHandler *handler);
+	AsyncCallbackWebHandler& on(const char *uri, ArRequestHandlerFunction onRequest);
+	AsyncCallbackWebHandler& on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+	void onNotFound(ArRequestHandlerFunction fn);
+	void reset();
+
+	// Picks the handler and runs it, as the server does once a request has been parsed
+	void _handle(AsyncWebServerRequest *request);
+
+private:
+	uint16_t _port;
+	bool _begun = false;
+	std::vector<AsyncWebHandler *> _handlers;
+	ArRequestHandlerFunction _notFound;
+};
+
+namespace host {
+
+// A request as a client sends it. url may carry a query, form is an urlencoded POST body.
+class Request {
+public:
+	std::string method = "GET";
+	std::string url = "/";
+	std::string host = "192.168.4.1";
+	std::vector<std::pair<std::string, std::string> > headers;
+	std::string form;
+	bool ap = true;		// Came in on the soft AP rather than the station interface
+};
+
+// Receives a response as the connection would send it
+class ResponseSink {
+public:
+	virtual ~ResponseSink() {
+	}
+	virtual void status(int code, const char *contentType, bool chunked, size_t contentLength) = 0;
+	virtual void header(const char *name, const char *value) = 0;
+	virtual void body(const uint8_t *data, size_t length) = 0;		// Unchunked, in the pieces it was filled in
+};
+
+class Response {
+public:
+	bool answered = false;		// False if the handler never sent a response
+	bool started = true;		// False if the server wasn't begun
+	int code = 0;
+	std::string contentType;
+	bool chunked = false;
+	std::vector<std::pair<std::string, std::string> > headers;
+	std::string body;
+	size_t fills = 0;			// Pieces the body was sent in
+	std::shared_ptr<EventClient> events;	// When the request opened an event stream
+
+	const char* header(const char *name) const;
+};
+
+// Free space of the connection's send buffer per fill, the TCP_SND_BUF of the ESP32 core
+extern size_t sendWindow;
+
+// Runs the request through the server; false if the server isn't begun
+bool serve(AsyncWebServer &server, const Request &request, ResponseSink &sink, std::shared_ptr<EventClient> *events = NULL);
+Response fetch(AsyncWebServer &server, const Request &request);
+Response fetch(AsyncWebServer &server, const char *url);
+Response post(AsyncWebServer &server, const char *url, const char *form);
+
+std::string urlDecode(const std::string &text);
+
+}
+
+#endif
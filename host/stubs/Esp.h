@@ -0,0 +1,18 @@
+#ifndef HOST_ESP_H
+#define HOST_ESP_H
+
+#include <stdint.h>
+
+class EspClass {
+public:
+	uint64_t getEfuseMac();
+	uint32_t getFlashChipSize();
+	uint32_t getFreeHeap();
+	void restart();
+
+	uint32_t restarts = 0;		// Calls to restart(), which does nothing else on the host
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef HOST_HARDWARESERIAL_H
+#define HOST_HARDWARESERIAL_H
+
+#include "Stream.h"
+
+// Writes to stdout, unless the benchmark turns it off to keep its report readable
+class HardwareSerial : public Stream {
+public:
+	void begin(unsigned long baud) {
+	}
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	using Print::write;
+
+	bool enabled = true;
+};
+
+extern HardwareSerial Serial;
+
+#endif
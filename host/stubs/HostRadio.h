@@ -0,0 +1,134 @@
+// The scripted fake radio behind the WiFi stand-in. A bench puts access points into host::air(),
+// and each simulated device has a host::Radio; WiFi forwards to the selected one. Connecting,
+// scanning and WPS take the times configured here and report through the WiFi event callbacks,
+// run by host::advance() as the WiFi task would run them on a device.
+#ifndef HOST_RADIO_H
+#define HOST_RADIO_H
+
+#include <list>
+#include <mutex>
+#include <vector>
+#include "WiFi.h"
+#include "HostSupport.h"
+
+namespace host {
+
+class Radio;
+
+class AccessPoint {
+public:
+	String ssid;
+	String pass;					// Empty for an open network
+	uint8_t bssid[6];
+	int8_t rssi = -60;
+	uint8_t channel = 6;
+	bool hidden = false;
+	bool up = true;
+	unsigned long associateMs = 200;	// Probe, authentication and association
+	unsigned long dhcpMs = 400;
+	unsigned capacity = 0;			// Attempts it can serve per second, the rest time out. 0 is unlimited.
+
+	unsigned long attempts = 0;		// Stations that began connecting to it
+	unsigned long failures = 0;		// Of those, turned away because it was down or over capacity
+	std::function<void(unsigned long ms)> onAttempt;	// Called with millis() for every attempt
+
+	uint32_t subnet = 0;			// First three octets of the addresses it leases, set by air()
+	unsigned long wpsPressedMs = 0;	// See pressWPS()
+	bool wpsPressed = false;
+
+	std::vector<unsigned long> recent;	// Attempt times within the last second, for the capacity
+};
+
+class Air {
+public:
+	std::list<AccessPoint> accessPoints;	// A list, so that references stay valid
+	std::vector<Radio *> radios;
+
+	AccessPoint& add(const char *ssid, const char *pass, int8_t rssi = -60, uint8_t channel = 6);
+	void addNeighbours(int count, int distinctSSIDs);	// Filler for the scan lists, none of which connect
+	void clear();
+	void setUp(AccessPoint &ap, bool up);	// Stations on an AP that goes down lose it after a beacon timeout
+	void pressWPS(AccessPoint &ap);			// Push the button for the 120 s walk time
+};
+
+Air& air();
+
+class Radio {
+public:
+	Radio();
+	~Radio();
+
+	// Make this the radio the WiFi calls go to, e.g. before calling loop() of its device
+	static void select(Radio *radio);
+	static Radio& current();
+
+	unsigned long scanMs = 2200;			// All channels, as the ESP32 default active scan
+	unsigned long notFoundMs = 3000;		// Until an attempt on an SSID that isn't there fails
+	unsigned long beaconTimeoutMs = 6000;
+	unsigned long wpsMs = 2000;				// Button pressed to credentials received
+	int rssiJitter = 3;						// Each scan reports RSSI up to this far off
+
+	uint32_t begins = 0;
+	uint32_t scans = 0;
+
+	int id;
+	std::recursive_mutex *mutex;
+
+	// Station
+	wifi_mode_t mode = WIFI_MODE_NULL;
+	wl_status_t status = WL_IDLE_STATUS;
+	String configSSID;			// What begin() stored, returned by esp_wifi_get_config()
+	String configPass;
+	AccessPoint *ap = NULL;		// Associated with, or being associated with
+	bool associated = false;
+	uint32_t ip = 0;
+	uint32_t gateway = 0;
+	uint32_t netmask = 0;
+	uint32_t dns = 0;
+	uint32_t staticIP = 0;		// From config(), 0 for DHCP
+	uint32_t staticGateway = 0;
+	uint32_t staticNetmask = 0;
+	uint32_t staticDNS = 0;
+	bool autoReconnect = true;
+	unsigned generation = 0;	// Bumped by every begin() and disconnect(), so stale steps are dropped
+
+	// Soft AP
+	bool apUp = false;
+	String apSSID;
+	String apPass;
+	uint32_t apIP = 0;
+
+	// Scan
+	bool scanning = false;
+	bool scanDone = false;
+	std::vector<AccessPoint> results;
+	unsigned scanGeneration = 0;
+	uint32_t jitterState;
+
+	// WPS
+	bool wpsEnabled = false;
+	bool wpsRunning = false;
+	uint64_t wpsTimeoutTask = 0;
+
+	class Handler {
+	public:
+		wifi_event_id_t id;
+		arduino_event_id_t event;
+		WiFiEventFuncCb callback;
+	};
+	std::vector<Handler> handlers;
+	wifi_event_id_t nextHandlerId = 1;
+
+	void fire(arduino_event_id_t event, arduino_event_info_t info);
+	void fireDisconnected(uint8_t reason);
+	void after(unsigned long ms, std::function<void()> step);	// Runs step unless the station was reset meanwhile
+	void connect(AccessPoint *ap, const char *pass, bool fast);
+	void gotIP();
+	void lose(uint8_t reason);
+	void finishScan();
+	void wpsSuccess(AccessPoint &ap);
+};
+
+}
+
+#endif
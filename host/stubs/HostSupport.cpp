@@ -0,0 +1,295 @@
+#include "HostSupport.h"
+#include "Arduino.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace host {
+
+static std::atomic<uint64_t> virtualMicros{0};
+static std::atomic<bool> realTime{false};
+static std::chrono::steady_clock::time_point realStart = std::chrono::steady_clock::now();
+
+// Due time and sequence, so tasks due at the same time run in the order they were scheduled
+typedef std::pair<uint64_t, uint64_t> TaskKey;
+
+static std::recursive_mutex &taskMutex() {
+	static std::recursive_mutex mutex;
+	return mutex;
+}
+
+static std::map<TaskKey, Task> &tasks() {
+	static std::map<TaskKey, Task> *queue = NULL;
+	if (queue == NULL) {
+		Untracked untracked;
+		queue = new std::map<TaskKey, Task>();
+	}
+	return *queue;
+}
+
+static uint64_t taskSequence = 0;
+
+uint64_t now() {
+	if (realTime) {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - realStart).count();
+	}
+	return virtualMicros.load();
+}
+
+void setRealTime(bool real) {
+	if (real && !realTime) {
+		realStart = std::chrono::steady_clock::now() - std::chrono::microseconds(virtualMicros.load());
+	} else if (!real && realTime) {
+		virtualMicros = now();
+	}
+	realTime = real;
+}
+
+uint64_t schedule(unsigned long delayMs, Task task) {
+	Untracked untracked;
+	std::lock_guard<std::recursive_mutex> lock(taskMutex());
+	uint64_t id = ++taskSequence;
+	tasks()[TaskKey(now() + delayMs * 1000ULL, id)] = task;
+	return id;
+}
+
+void cancel(uint64_t id) {
+	Untracked untracked;
+	std::lock_guard<std::recursive_mutex> lock(taskMutex());
+	for (std::map<TaskKey, Task>::iterator it = tasks().begin(); it != tasks().end(); ++it) {
+		if (it->first.second == id) {
+			tasks().erase(it);
+			return;
+		}
+	}
+}
+
+/** Take the first task due by the given time off the queue, false if there is none */
+static bool nextDue(uint64_t until, uint64_t &due, Task &task) {
+	Untracked untracked;
+	std::lock_guard<std::recursive_mutex> lock(taskMutex());
+	if (tasks().empty() || tasks().begin()->first.first > until) {
+		return false;
+	}
+	due = tasks().begin()->first.first;
+	task = tasks().begin()->second;
+	tasks().erase(tasks().begin());
+	return true;
+}
+
+void advance(unsigned long ms) {
+	uint64_t due;
+	Task task;
+	if (realTime) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+		while (nextDue(now(), due, task)) {
+			task();
+		}
+		return;
+	}
+
+	uint64_t until = virtualMicros.load() + ms * 1000ULL;
+	while (nextDue(until, due, task)) {
+		if (due > virtualMicros.load()) {
+			virtualMicros = due;
+		}
+		task();
+	}
+	virtualMicros = until;
+}
+
+static std::atomic<uint64_t> allocations{0};
+static std::atomic<uint64_t> frees{0};
+static std::atomic<size_t> currentBytes{0};
+static std::atomic<size_t> peakBytes{0};
+static thread_local bool tracking = true;
+
+HeapStats heap() {
+	HeapStats stats;
+	stats.allocations = allocations.load();
+	stats.frees = frees.load();
+	stats.current = currentBytes.load();
+	stats.peak = peakBytes.load();
+	return stats;
+}
+
+void resetPeak() {
+	peakBytes = currentBytes.load();
+}
+
+Untracked::Untracked() : _previous(tracking) {
+	tracking = false;
+}
+
+Untracked::~Untracked() {
+	tracking = _previous;
+}
+
+// Each block starts with its size and whether it was counted, so delete undoes exactly what new did
+struct BlockHeader {
+	size_t size;
+	bool counted;
+	alignas(std::max_align_t) unsigned char data[1];
+};
+
+static const size_t headerSize = offsetof(BlockHeader, data);
+
+static void *allocate(size_t size) {
+	BlockHeader *block = static_cast<BlockHeader *>(malloc(headerSize + size));
+	if (block == NULL) {
+		throw std::bad_alloc();
+	}
+	block->size = size;
+	block->counted = tracking;
+	if (block->counted) {
+		allocations++;
+		size_t current = currentBytes += size;
+		size_t peak = peakBytes.load();
+		while (current > peak && !peakBytes.compare_exchange_weak(peak, current)) {
+		}
+	}
+	return block->data;
+}
+
+static void release(void *ptr) {
+	if (ptr == NULL) {
+		return;
+	}
+	BlockHeader *block = reinterpret_cast<BlockHeader *>(static_cast<unsigned char *>(ptr) - headerSize);
+	if (block->counted) {
+		frees++;
+		currentBytes -= block->size;
+	}
+	free(block);
+}
+
+}
+
+void *operator new(size_t size) {
+	return host::allocate(size);
+}
+
+void *operator new[](size_t size) {
+	return host::allocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	try {
+		return host::allocate(size);
+	} catch (...) {
+		return NULL;
+	}
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+	try {
+		return host::allocate(size);
+	} catch (...) {
+		return NULL;
+	}
+}
+
+void operator delete(void *ptr) noexcept {
+	host::release(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	host::release(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	host::release(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+	host::release(ptr);
+}
+
+unsigned long millis() {
+	return host::now() / 1000;
+}
+
+unsigned long micros() {
+	return host::now();
+}
+
+void delay(unsigned long ms) {
+	host::advance(ms);
+}
+
+void yield() {
+}
+
+static uint64_t randomState = 0x853c49e6748fea9bULL;
+
+static uint32_t nextRandom() {
+	// xorshift64*, deterministic so that runs can be compared
+	randomState ^= randomState >> 12;
+	randomState ^= randomState << 25;
+	randomState ^= randomState >> 27;
+	return (randomState * 2685821657736338717ULL) >> 32;
+}
+
+long random(long howbig) {
+	if (howbig <= 0) {
+		return 0;
+	}
+	return nextRandom() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+	if (howsmall >= howbig) {
+		return howsmall;
+	}
+	return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+	if (seed != 0) {
+		randomState = seed;
+	}
+}
+
+char* dtostrf(double number, signed char width, unsigned char prec, char *s) {
+	sprintf(s, "%*.*f", width, prec, number);
+	return s;
+}
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+	if (enabled) {
+		fwrite(buffer, 1, size, stdout);
+	}
+	return size;
+}
+
+EspClass ESP;
+
+uint64_t EspClass::getEfuseMac() {
+	return 0x0000A1B2C3D4E5F6ULL;
+}
+
+uint32_t EspClass::getFlashChipSize() {
+	return 4 * 1024 * 1024;
+}
+
+/** What a device with 300 KB of heap would have left with the allocations counted so far */
+uint32_t EspClass::getFreeHeap() {
+	size_t used = host::heap().current;
+	return used < 300 * 1024 ? 300 * 1024 - used : 0;
+}
+
+void EspClass::restart() {
+	restarts++;
+}
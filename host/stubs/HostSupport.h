@@ -0,0 +1,47 @@
+// What the host build adds to the stand-ins: the virtual clock the radio runs on and the heap counters
+#ifndef HOST_SUPPORT_H
+#define HOST_SUPPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+namespace host {
+
+// Virtual time, from 0 at startup. Only advance() and delay() move it, so a run is reproducible
+// and a simulated minute takes no wall time. setRealTime(true) ties it to the wall clock instead,
+// for the socket-backed load test where clients run in real time.
+uint64_t now();				// Microseconds
+void advance(unsigned long ms);		// Moves the clock, running the tasks that fall due on the way
+void setRealTime(bool real);
+
+// Tasks run by advance() in the thread calling it, as the WiFi task runs event callbacks on a device
+typedef std::function<void()> Task;
+uint64_t schedule(unsigned long delayMs, Task task);
+void cancel(uint64_t id);
+
+// Counts of the global operator new and delete, all threads together
+class HeapStats {
+public:
+	uint64_t allocations;
+	uint64_t frees;
+	size_t current;		// Bytes allocated and not freed
+	size_t peak;		// Highest current since the last resetPeak()
+};
+
+HeapStats heap();
+void resetPeak();
+
+// Allocations made by this thread while one of these exists are not counted: the harness
+// keeps its own bookkeeping out of the figures it reports for the library
+class Untracked {
+public:
+	Untracked();
+	~Untracked();
+private:
+	bool _previous;
+};
+
+}
+
+#endif
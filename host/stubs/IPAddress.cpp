@@ -0,0 +1,40 @@
+#include "IPAddress.h"
+#include "Print.h"
+#include <stdio.h>
+
+size_t IPAddress::printTo(Print &p) const {
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _address.bytes[0], _address.bytes[1], _address.bytes[2], _address.bytes[3]);
+	return p.print(buf);
+}
+
+String IPAddress::toString() const {
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _address.bytes[0], _address.bytes[1], _address.bytes[2], _address.bytes[3]);
+	return String(buf);
+}
+
+bool IPAddress::fromString(const char *address) {
+	uint8_t octets[4];
+	for (int i = 0; i < 4; i++) {
+		if (i > 0 && *address++ != '.') {
+			return false;
+		}
+		if (*address < '0' || *address > '9') {
+			return false;
+		}
+		unsigned int octet = 0;
+		while (*address >= '0' && *address <= '9') {
+			octet = octet * 10 + (*address++ - '0');
+			if (octet > 255) {
+				return false;
+			}
+		}
+		octets[i] = octet;
+	}
+	if (*address != 0) {
+		return false;
+	}
+	memcpy(_address.bytes, octets, sizeof(octets));
+	return true;
+}
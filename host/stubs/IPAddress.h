@@ -0,0 +1,57 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <stdint.h>
+#include "Printable.h"
+#include "WString.h"
+
+// Same layout as the ESP32 core: the octets in network order, read as a uint32_t in host order
+class IPAddress : public Printable {
+public:
+	IPAddress() {
+		_address.dword = 0;
+	}
+	IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth) {
+		_address.bytes[0] = first;
+		_address.bytes[1] = second;
+		_address.bytes[2] = third;
+		_address.bytes[3] = fourth;
+	}
+	IPAddress(uint32_t address) {
+		_address.dword = address;
+	}
+	IPAddress(const uint8_t *address) {
+		memcpy(_address.bytes, address, sizeof(_address.bytes));
+	}
+
+	operator uint32_t() const {
+		return _address.dword;
+	}
+	bool operator==(const IPAddress &addr) const {
+		return _address.dword == addr._address.dword;
+	}
+	bool operator!=(const IPAddress &addr) const {
+		return _address.dword != addr._address.dword;
+	}
+	uint8_t operator[](int index) const {
+		return _address.bytes[index];
+	}
+	uint8_t& operator[](int index) {
+		return _address.bytes[index];
+	}
+
+	size_t printTo(Print &p) const override;
+	String toString() const;
+	bool fromString(const char *address);
+	bool fromString(const String &address) {
+		return fromString(address.c_str());
+	}
+
+private:
+	union {
+		uint8_t bytes[4];
+		uint32_t dword;
+	} _address;
+};
+
+#endif
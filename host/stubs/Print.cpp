@@ -0,0 +1,168 @@
+#include "Print.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while (size-- > 0) {
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+/** As in the core: a 64 byte stack buffer, and a heap buffer for anything longer */
+size_t Print::printf(const char *format, ...) {
+	char loc_buf[64];
+	char *temp = loc_buf;
+	va_list arg;
+	va_list copy;
+	va_start(arg, format);
+	va_copy(copy, arg);
+	int len = vsnprintf(temp, sizeof(loc_buf), format, copy);
+	va_end(copy);
+	if (len < 0) {
+		va_end(arg);
+		return 0;
+	}
+	if (len >= (int)sizeof(loc_buf)) {
+		temp = new char[len + 1];
+		vsnprintf(temp, len + 1, format, arg);
+	}
+	va_end(arg);
+	len = write((const uint8_t *)temp, len);
+	if (temp != loc_buf) {
+		delete[] temp;
+	}
+	return len;
+}
+
+size_t Print::printNumber(unsigned long long n, bool negative, int base) {
+	char buf[8 * sizeof(n) + 2];
+	char *str = &buf[sizeof(buf) - 1];
+	*str = 0;
+	if (base < 2) {
+		base = 10;
+	}
+	do {
+		int digit = n % base;
+		*--str = digit < 10 ? '0' + digit : 'A' + digit - 10;
+		n /= base;
+	} while (n != 0);
+	if (negative) {
+		*--str = '-';
+	}
+	return write(str);
+}
+
+size_t Print::print(const __FlashStringHelper *ifsh) {
+	return write(reinterpret_cast<const char *>(ifsh));
+}
+
+size_t Print::print(const String &s) {
+	return write(s.c_str(), s.length());
+}
+
+size_t Print::print(const char str[]) {
+	return write(str);
+}
+
+size_t Print::print(char c) {
+	return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base) {
+	return printNumber(n, false, base);
+}
+
+size_t Print::print(int n, int base) {
+	return print((long long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+	return printNumber(n, false, base);
+}
+
+size_t Print::print(long n, int base) {
+	return print((long long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+	return printNumber(n, false, base);
+}
+
+size_t Print::print(long long n, int base) {
+	if (base == 10 && n < 0) {
+		return printNumber(-(unsigned long long)n, true, base);
+	}
+	return printNumber((unsigned long long)n, false, base);
+}
+
+size_t Print::print(unsigned long long n, int base) {
+	return printNumber(n, false, base);
+}
+
+size_t Print::print(double n, int digits) {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return write(buf);
+}
+
+size_t Print::print(const Printable &x) {
+	return x.printTo(*this);
+}
+
+size_t Print::println(void) {
+	return write("\r\n");
+}
+
+size_t Print::println(const __FlashStringHelper *ifsh) {
+	return print(ifsh) + println();
+}
+
+size_t Print::println(const String &s) {
+	return print(s) + println();
+}
+
+size_t Print::println(const char str[]) {
+	return print(str) + println();
+}
+
+size_t Print::println(char c) {
+	return print(c) + println();
+}
+
+size_t Print::println(unsigned char n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(int n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned int n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(long n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned long n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(long long n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned long long n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(double n, int digits) {
+	return print(n, digits) + println();
+}
+
+size_t Print::println(const Printable &x) {
+	return print(x) + println();
+}
@@ -0,0 +1,22 @@
+#ifndef HOST_STREAMSTRING_H
+#define HOST_STREAMSTRING_H
+
+#include "Stream.h"
+
+// Appends everything written to the String, growing it as the core does
+class StreamString : public Stream, public String {
+public:
+	size_t write(const uint8_t *data, size_t size) override {
+		return concat((const char *)data, size) ? size : 0;
+	}
+	size_t write(uint8_t data) override {
+		return concat((char)data) ? 1 : 0;
+	}
+	using Print::write;
+
+	int available() override {
+		return length();
+	}
+};
+
+#endif
@@ -0,0 +1,606 @@
+#include "WString.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void formatNumber(char *buf, size_t size, unsigned long value, bool negative, unsigned char base) {
+	char digits[sizeof(unsigned long) * 8 + 2];
+	size_t n = 0;
+	do {
+		unsigned d = value % base;
+		digits[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+		value /= base;
+	} while (value != 0);
+
+	size_t pos = 0;
+	if (negative && pos + 1 < size) {
+		buf[pos++] = '-';
+	}
+	while (n > 0 && pos + 1 < size) {
+		buf[pos++] = digits[--n];
+	}
+	buf[pos] = 0;
+}
+
+String::String(const char *cstr) {
+	init();
+	if (cstr != NULL) {
+		copy(cstr, strlen(cstr));
+	}
+}
+
+String::String(const char *cstr, unsigned int length) {
+	init();
+	if (cstr != NULL) {
+		copy(cstr, length);
+	}
+}
+
+String::String(const String &value) {
+	init();
+	*this = value;
+}
+
+String::String(String &&rval) {
+	init();
+	move(rval);
+}
+
+String::String(const __FlashStringHelper *pstr) {
+	init();
+	*this = pstr;
+}
+
+String::String(char c) {
+	init();
+	char buf[2] = { c, 0 };
+	*this = buf;
+}
+
+String::String(unsigned char value, unsigned char base) {
+	init();
+	char buf[1 + 8 * sizeof(unsigned char)];
+	formatNumber(buf, sizeof(buf), value, false, base);
+	*this = buf;
+}
+
+String::String(int value, unsigned char base) {
+	init();
+	char buf[2 + 8 * sizeof(int)];
+	if (base == 10 && value < 0) {
+		formatNumber(buf, sizeof(buf), -(unsigned long)(long)value, true, base);
+	} else {
+		formatNumber(buf, sizeof(buf), (unsigned int)value, false, base);
+	}
+	*this = buf;
+}
+
+String::String(unsigned int value, unsigned char base) {
+	init();
+	char buf[1 + 8 * sizeof(unsigned int)];
+	formatNumber(buf, sizeof(buf), value, false, base);
+	*this = buf;
+}
+
+String::String(long value, unsigned char base) {
+	init();
+	char buf[2 + 8 * sizeof(long)];
+	if (base == 10 && value < 0) {
+		formatNumber(buf, sizeof(buf), -(unsigned long)value, true, base);
+	} else {
+		formatNumber(buf, sizeof(buf), (unsigned long)value, false, base);
+	}
+	*this = buf;
+}
+
+String::String(unsigned long value, unsigned char base) {
+	init();
+	char buf[1 + 8 * sizeof(unsigned long)];
+	formatNumber(buf, sizeof(buf), value, false, base);
+	*this = buf;
+}
+
+String::String(float value, unsigned int decimalPlaces) {
+	init();
+	char buf[48];
+	snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, (double)value);
+	*this = buf;
+}
+
+String::String(double value, unsigned int decimalPlaces) {
+	init();
+	char buf[48];
+	snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+	*this = buf;
+}
+
+String::~String() {
+	invalidate();
+}
+
+void String::init() {
+	_sso[0] = 0;
+	_heap = NULL;
+	_capacity = SSOSIZE;
+	_len = 0;
+}
+
+void String::invalidate() {
+	delete[] _heap;
+	init();
+}
+
+void String::setLen(unsigned int len) {
+	_len = len;
+	wbuffer()[len] = 0;
+}
+
+bool String::reserve(unsigned int size) {
+	if (size <= _capacity) {
+		return true;
+	}
+	return changeBuffer(size);
+}
+
+/** Same rounding as the core. Counted as one allocation and one free, as realloc() may move the block. */
+bool String::changeBuffer(unsigned int maxStrLen) {
+	unsigned int size = (maxStrLen + 16) & ~15U;
+	char *grown = new char[size];
+	memcpy(grown, buffer(), _len + 1);
+	delete[] _heap;
+	_heap = grown;
+	_capacity = size - 1;
+	return true;
+}
+
+String& String::copy(const char *cstr, unsigned int length) {
+	if (!reserve(length)) {
+		invalidate();
+		return *this;
+	}
+	memmove(wbuffer(), cstr, length);
+	setLen(length);
+	return *this;
+}
+
+void String::move(String &rhs) {
+	if (this == &rhs) {
+		return;
+	}
+	delete[] _heap;
+	if (rhs._heap != NULL) {
+		_heap = rhs._heap;
+		_capacity = rhs._capacity;
+		_len = rhs._len;
+	} else {
+		_heap = NULL;
+		_capacity = SSOSIZE;
+		memcpy(_sso, rhs._sso, rhs._len + 1);
+		_len = rhs._len;
+	}
+	rhs.init();
+}
+
+String& String::operator=(const String &rhs) {
+	if (this == &rhs) {
+		return *this;
+	}
+	return copy(rhs.buffer(), rhs._len);
+}
+
+String& String::operator=(String &&rval) {
+	move(rval);
+	return *this;
+}
+
+String& String::operator=(const char *cstr) {
+	if (cstr == NULL) {
+		invalidate();
+		return *this;
+	}
+	return copy(cstr, strlen(cstr));
+}
+
+String& String::operator=(const __FlashStringHelper *pstr) {
+	if (pstr == NULL) {
+		invalidate();
+		return *this;
+	}
+	const char *cstr = reinterpret_cast<const char *>(pstr);
+	return copy(cstr, strlen(cstr));
+}
+
+bool String::concat(const char *cstr, unsigned int length) {
+	if (cstr == NULL) {
+		return false;
+	}
+	if (length == 0) {
+		return true;
+	}
+	unsigned int newlen = _len + length;
+	// cstr may point into this string, so copy it before growing
+	if (cstr >= buffer() && cstr < buffer() + _len) {
+		String temp(cstr, length);
+		if (!reserve(newlen)) {
+			return false;
+		}
+		memcpy(wbuffer() + _len, temp.buffer(), length);
+	} else {
+		if (!reserve(newlen)) {
+			return false;
+		}
+		memcpy(wbuffer() + _len, cstr, length);
+	}
+	setLen(newlen);
+	return true;
+}
+
+bool String::concat(const String &s) {
+	return concat(s.buffer(), s._len);
+}
+
+bool String::concat(const char *cstr) {
+	return cstr != NULL && concat(cstr, strlen(cstr));
+}
+
+bool String::concat(char c) {
+	return concat(&c, 1);
+}
+
+bool String::concat(unsigned char num) {
+	return concat(String(num));
+}
+
+bool String::concat(int num) {
+	return concat(String(num));
+}
+
+bool String::concat(unsigned int num) {
+	return concat(String(num));
+}
+
+bool String::concat(long num) {
+	return concat(String(num));
+}
+
+bool String::concat(unsigned long num) {
+	return concat(String(num));
+}
+
+bool String::concat(float num) {
+	return concat(String(num));
+}
+
+bool String::concat(double num) {
+	return concat(String(num));
+}
+
+bool String::concat(const __FlashStringHelper *str) {
+	return concat(reinterpret_cast<const char *>(str));
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, const String &rhs) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(rhs);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, const char *cstr) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(cstr);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, char c) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(c);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, unsigned char num) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(num);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, int num) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(num);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, unsigned int num) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(num);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, long num) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(num);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, unsigned long num) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(num);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, float num) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(num);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, double num) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(num);
+	return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper &lhs, const __FlashStringHelper *rhs) {
+	StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+	a.concat(rhs);
+	return a;
+}
+
+int String::compareTo(const String &s) const {
+	return strcmp(buffer(), s.buffer());
+}
+
+bool String::equals(const String &s) const {
+	return _len == s._len && compareTo(s) == 0;
+}
+
+bool String::equals(const char *cstr) const {
+	if (cstr == NULL) {
+		return _len == 0;
+	}
+	return strcmp(buffer(), cstr) == 0;
+}
+
+bool String::equalsIgnoreCase(const String &s) const {
+	if (_len != s._len) {
+		return false;
+	}
+	for (unsigned int i = 0; i < _len; i++) {
+		if (tolower((unsigned char)buffer()[i]) != tolower((unsigned char)s.buffer()[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool String::startsWith(const String &prefix) const {
+	return _len >= prefix._len && startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+	if (offset > _len || _len - offset < prefix._len) {
+		return false;
+	}
+	return strncmp(buffer() + offset, prefix.buffer(), prefix._len) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+	if (_len < suffix._len) {
+		return false;
+	}
+	return strcmp(buffer() + _len - suffix._len, suffix.buffer()) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+	return operator[](index);
+}
+
+void String::setCharAt(unsigned int index, char c) {
+	if (index < _len) {
+		wbuffer()[index] = c;
+	}
+}
+
+char String::operator[](unsigned int index) const {
+	return index < _len ? buffer()[index] : 0;
+}
+
+char& String::operator[](unsigned int index) {
+	static char dummy;
+	if (index >= _len) {
+		dummy = 0;
+		return dummy;
+	}
+	return wbuffer()[index];
+}
+
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
+	if (bufsize == 0 || buf == NULL) {
+		return;
+	}
+	if (index >= _len) {
+		buf[0] = 0;
+		return;
+	}
+	unsigned int n = bufsize - 1;
+	if (n > _len - index) {
+		n = _len - index;
+	}
+	memcpy(buf, buffer() + index, n);
+	buf[n] = 0;
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const {
+	if (fromIndex >= _len) {
+		return -1;
+	}
+	const char *found = strchr(buffer() + fromIndex, c);
+	return found == NULL ? -1 : found - buffer();
+}
+
+int String::indexOf(const String &s, unsigned int fromIndex) const {
+	return indexOf(s.buffer(), fromIndex);
+}
+
+int String::indexOf(const char *s, unsigned int fromIndex) const {
+	if (fromIndex >= _len) {
+		return -1;
+	}
+	const char *found = strstr(buffer() + fromIndex, s);
+	return found == NULL ? -1 : found - buffer();
+}
+
+int String::lastIndexOf(char c) const {
+	const char *found = strrchr(buffer(), c);
+	return found == NULL ? -1 : found - buffer();
+}
+
+int String::lastIndexOf(const String &s) const {
+	if (s._len == 0 || s._len > _len) {
+		return -1;
+	}
+	for (int i = _len - s._len; i >= 0; i--) {
+		if (strncmp(buffer() + i, s.buffer(), s._len) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+	if (left > right) {
+		unsigned int temp = right;
+		right = left;
+		left = temp;
+	}
+	if (left >= _len) {
+		return String();
+	}
+	if (right > _len) {
+		right = _len;
+	}
+	return String(buffer() + left, right - left);
+}
+
+void String::replace(char find, char replace) {
+	for (char *p = wbuffer(); *p != 0; p++) {
+		if (*p == find) {
+			*p = replace;
+		}
+	}
+}
+
+static int lastIndexAtOrBefore(const char *s, const char *find, unsigned int findLen, int fromIndex) {
+	for (int i = fromIndex; i >= 0; i--) {
+		if (strncmp(s + i, find, findLen) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/** Same algorithm as the core: in place when the replacement isn't longer, else one exact resize */
+void String::replace(const String &find, const String &replace) {
+	if (_len == 0 || find._len == 0) {
+		return;
+	}
+	int diff = replace._len - find._len;
+	char *readFrom = wbuffer();
+	char *foundAt;
+	if (diff == 0) {
+		while ((foundAt = strstr(readFrom, find.buffer())) != NULL) {
+			memmove(foundAt, replace.buffer(), replace._len);
+			readFrom = foundAt + replace._len;
+		}
+	} else if (diff < 0) {
+		char *writeTo = wbuffer();
+		while ((foundAt = strstr(readFrom, find.buffer())) != NULL) {
+			unsigned int n = foundAt - readFrom;
+			memmove(writeTo, readFrom, n);
+			writeTo += n;
+			memmove(writeTo, replace.buffer(), replace._len);
+			writeTo += replace._len;
+			readFrom = foundAt + find._len;
+		}
+		unsigned int rest = strlen(readFrom);
+		memmove(writeTo, readFrom, rest + 1);
+		_len = writeTo - wbuffer() + rest;
+	} else {
+		unsigned int size = _len;
+		while ((foundAt = strstr(readFrom, find.buffer())) != NULL) {
+			readFrom = foundAt + find._len;
+			size += diff;
+		}
+		if (size == _len) {
+			return;
+		}
+		if (size > _capacity && !changeBuffer(size)) {
+			return;
+		}
+		int index = _len - 1;
+		while (index >= 0 && (index = lastIndexAtOrBefore(buffer(), find.buffer(), find._len, index)) >= 0) {
+			readFrom = wbuffer() + index + find._len;
+			memmove(readFrom + diff, readFrom, _len - (readFrom - wbuffer()));
+			_len += diff;
+			wbuffer()[_len] = 0;
+			memmove(wbuffer() + index, replace.buffer(), replace._len);
+			index--;
+		}
+	}
+}
+
+void String::remove(unsigned int index) {
+	remove(index, (unsigned int)-1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+	if (index >= _len || count == 0) {
+		return;
+	}
+	if (count > _len - index) {
+		count = _len - index;
+	}
+	char *writeTo = wbuffer() + index;
+	memmove(writeTo, writeTo + count, _len - index - count);
+	setLen(_len - count);
+}
+
+void String::toLowerCase() {
+	for (char *p = wbuffer(); *p != 0; p++) {
+		*p = tolower((unsigned char)*p);
+	}
+}
+
+void String::toUpperCase() {
+	for (char *p = wbuffer(); *p != 0; p++) {
+		*p = toupper((unsigned char)*p);
+	}
+}
+
+void String::trim() {
+	if (_len == 0) {
+		return;
+	}
+	char *begin = wbuffer();
+	while (isspace((unsigned char)*begin)) {
+		begin++;
+	}
+	char *end = wbuffer() + _len - 1;
+	while (end >= begin && isspace((unsigned char)*end)) {
+		end--;
+	}
+	unsigned int len = end + 1 - begin;
+	memmove(wbuffer(), begin, len);
+	setLen(len);
+}
+
+long String::toInt() const {
+	return atol(buffer());
+}
+
+float String::toFloat() const {
+	return atof(buffer());
+}
+
+double String::toDouble() const {
+	return atof(buffer());
+}
@@ -0,0 +1,204 @@
+// Host stand-in for the Arduino String. Same API subset as the ESP32 core and the same buffer
+// policy: short strings live inline, longer ones in a heap buffer reallocated to the length needed
+// rounded up to 16 bytes, so allocation counts on the host match what the code does on a device.
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "pgmspace.h"
+
+class __FlashStringHelper;
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper *>(pstr_pointer))
+#define F(string_literal) (FPSTR(PSTR(string_literal)))
+
+class StringSumHelper;
+
+class String {
+public:
+	String(const char *cstr = "");
+	String(const char *cstr, unsigned int length);
+	String(const String &str);
+	String(String &&rval);
+	String(const __FlashStringHelper *str);
+	explicit String(char c);
+	explicit String(unsigned char value, unsigned char base = 10);
+	explicit String(int value, unsigned char base = 10);
+	explicit String(unsigned int value, unsigned char base = 10);
+	explicit String(long value, unsigned char base = 10);
+	explicit String(unsigned long value, unsigned char base = 10);
+	explicit String(float value, unsigned int decimalPlaces = 2);
+	explicit String(double value, unsigned int decimalPlaces = 2);
+	~String();
+
+	bool reserve(unsigned int size);
+	unsigned int length() const {
+		return _len;
+	}
+	bool isEmpty() const {
+		return _len == 0;
+	}
+
+	String& operator=(const String &rhs);
+	String& operator=(String &&rval);
+	String& operator=(const char *cstr);
+	String& operator=(const __FlashStringHelper *str);
+
+	bool concat(const String &str);
+	bool concat(const char *cstr);
+	bool concat(const char *cstr, unsigned int length);
+	bool concat(const uint8_t *cstr, unsigned int length) {
+		return concat(reinterpret_cast<const char *>(cstr), length);
+	}
+	bool concat(char c);
+	bool concat(unsigned char num);
+	bool concat(int num);
+	bool concat(unsigned int num);
+	bool concat(long num);
+	bool concat(unsigned long num);
+	bool concat(float num);
+	bool concat(double num);
+	bool concat(const __FlashStringHelper *str);
+
+	template<typename T> String& operator+=(const T &rhs) {
+		concat(rhs);
+		return *this;
+	}
+	String& operator+=(const char *cstr) {
+		concat(cstr);
+		return *this;
+	}
+
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, const String &rhs);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, const char *cstr);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, char c);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, unsigned char num);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, int num);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, unsigned int num);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, long num);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, unsigned long num);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, float num);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, double num);
+	friend StringSumHelper& operator+(const StringSumHelper &lhs, const __FlashStringHelper *rhs);
+
+	int compareTo(const String &s) const;
+	bool equals(const String &s) const;
+	bool equals(const char *cstr) const;
+	bool equalsIgnoreCase(const String &s) const;
+	bool operator==(const String &rhs) const {
+		return equals(rhs);
+	}
+	bool operator==(const char *cstr) const {
+		return equals(cstr);
+	}
+	bool operator!=(const String &rhs) const {
+		return !equals(rhs);
+	}
+	bool operator!=(const char *cstr) const {
+		return !equals(cstr);
+	}
+	bool operator<(const String &rhs) const {
+		return compareTo(rhs) < 0;
+	}
+	bool operator>(const String &rhs) const {
+		return compareTo(rhs) > 0;
+	}
+	bool startsWith(const String &prefix) const;
+	bool startsWith(const String &prefix, unsigned int offset) const;
+	bool endsWith(const String &suffix) const;
+
+	char charAt(unsigned int index) const;
+	void setCharAt(unsigned int index, char c);
+	char operator[](unsigned int index) const;
+	char& operator[](unsigned int index);
+	void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+	void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const {
+		getBytes(reinterpret_cast<unsigned char *>(buf), bufsize, index);
+	}
+	const char* c_str() const {
+		return buffer();
+	}
+	char* begin() {
+		return wbuffer();
+	}
+	char* end() {
+		return wbuffer() + _len;
+	}
+	const char* begin() const {
+		return buffer();
+	}
+	const char* end() const {
+		return buffer() + _len;
+	}
+
+	int indexOf(char ch, unsigned int fromIndex = 0) const;
+	int indexOf(const String &str, unsigned int fromIndex = 0) const;
+	int indexOf(const char *str, unsigned int fromIndex = 0) const;
+	int lastIndexOf(char ch) const;
+	int lastIndexOf(const String &str) const;
+	String substring(unsigned int beginIndex) const {
+		return substring(beginIndex, _len);
+	}
+	String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+	void replace(char find, char replace);
+	void replace(const String &find, const String &replace);
+	void replace(const char *find, const String &replace) {
+		this->replace(String(find), replace);
+	}
+	void replace(const char *find, const char *replace) {
+		this->replace(String(find), String(replace));
+	}
+	void remove(unsigned int index);
+	void remove(unsigned int index, unsigned int count);
+	void toLowerCase();
+	void toUpperCase();
+	void trim();
+
+	long toInt() const;
+	float toFloat() const;
+	double toDouble() const;
+
+protected:
+	// Longest string kept inline, as on the 32-bit cores
+	enum { SSOSIZE = 11 };
+
+	char _sso[SSOSIZE + 1];
+	char *_heap = NULL;			// NULL while the string is inline
+	unsigned int _capacity = SSOSIZE;
+	unsigned int _len = 0;
+
+	const char* buffer() const {
+		return _heap != NULL ? _heap : _sso;
+	}
+	char* wbuffer() {
+		return _heap != NULL ? _heap : _sso;
+	}
+	void init();
+	void invalidate();
+	bool changeBuffer(unsigned int maxStrLen);
+	String& copy(const char *cstr, unsigned int length);
+	void move(String &rhs);
+	void setLen(unsigned int len);
+};
+
+class StringSumHelper : public String {
+public:
+	StringSumHelper(const String &s) : String(s) {
+	}
+	StringSumHelper(const char *p) : String(p) {
+	}
+	StringSumHelper(char c) : String(c) {
+	}
+	StringSumHelper(int num) : String(num) {
+	}
+	StringSumHelper(unsigned int num) : String(num) {
+	}
+	StringSumHelper(long num) : String(num) {
+	}
+	StringSumHelper(unsigned long num) : String(num) {
+	}
+};
+
+#endif
@@ -0,0 +1,768 @@
+#include "WiFi.h"
+#include "esp_wps.h"
+#include "HostRadio.h"
+#include <algorithm>
+
+WiFiClass WiFi;
+
+namespace host {
+
+static const uint32_t AP_IP = 0x0104A8C0;	// 192.168.4.1, the soft AP default
+
+Air& air() {
+	static Air *instance = NULL;
+	if (instance == NULL) {
+		Untracked untracked;
+		instance = new Air();
+	}
+	return *instance;
+}
+
+AccessPoint& Air::add(const char *ssid, const char *pass, int8_t rssi, uint8_t channel) {
+	Untracked untracked;
+	accessPoints.push_back(AccessPoint());
+	AccessPoint &ap = accessPoints.back();
+	uint32_t n = accessPoints.size();
+	ap.ssid = ssid;
+	ap.pass = pass != NULL ? pass : "";
+	uint8_t bssid[6] = { 0x02, 0xAB, 0xCD, (uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n };
+	memcpy(ap.bssid, bssid, sizeof(bssid));
+	ap.rssi = rssi;
+	ap.channel = channel;
+	ap.subnet = 192 | (168 << 8) | ((n & 0xFF) << 16);
+	return ap;
+}
+
+/** Unnamed neighbours: count BSSIDs over distinctSSIDs names, as in a block of flats */
+void Air::addNeighbours(int count, int distinctSSIDs) {
+	uint32_t state = 12345;
+	for (int i = 0; i < count; i++) {
+		state = state * 1103515245 + 12345;
+		char ssid[33];
+		snprintf(ssid, sizeof(ssid), "Neighbour-%03d", distinctSSIDs > 0 ? i % distinctSSIDs : i);
+		AccessPoint &ap = add(ssid, "unknown-password", -40 - (int)((state >> 16) % 55), 1 + (state >> 8) % 13);
+		ap.capacity = 0;
+	}
+}
+
+void Air::clear() {
+	Untracked untracked;
+	for (Radio *radio : radios) {
+		std::lock_guard<std::recursive_mutex> lock(*radio->mutex);
+		radio->ap = NULL;
+		radio->associated = false;
+		radio->generation++;
+		radio->results.clear();
+	}
+	accessPoints.clear();
+}
+
+void Air::setUp(AccessPoint &ap, bool up) {
+	ap.up = up;
+	if (up) {
+		return;
+	}
+	for (Radio *radio : radios) {
+		std::lock_guard<std::recursive_mutex> lock(*radio->mutex);
+		if (radio->ap == &ap) {
+			unsigned generation = radio->generation;
+			radio->after(radio->beaconTimeoutMs, [radio, generation]() {
+				if (radio->generation == generation) {
+					radio->lose(WIFI_REASON_BEACON_TIMEOUT);
+				}
+			});
+		}
+	}
+}
+
+void Air::pressWPS(AccessPoint &ap) {
+	ap.wpsPressed = true;
+	ap.wpsPressedMs = millis();
+	for (Radio *radio : radios) {
+		std::lock_guard<std::recursive_mutex> lock(*radio->mutex);
+		if (radio->wpsRunning) {
+			radio->wpsSuccess(ap);
+		}
+	}
+}
+
+static Radio *selected = NULL;
+static int radioCount = 0;
+
+Radio::Radio() {
+	Untracked untracked;
+	mutex = new std::recursive_mutex();
+	id = ++radioCount;
+	jitterState = 0x9E3779B9u * id;
+	air().radios.push_back(this);
+}
+
+Radio::~Radio() {
+	Untracked untracked;
+	std::vector<Radio *> &radios = air().radios;
+	radios.erase(std::remove(radios.begin(), radios.end(), this), radios.end());
+	if (selected == this) {
+		selected = NULL;
+	}
+	delete mutex;
+}
+
+void Radio::select(Radio *radio) {
+	selected = radio;
+}
+
+Radio& Radio::current() {
+	if (selected == NULL) {
+		static Radio *defaultRadio = NULL;
+		if (defaultRadio == NULL) {
+			Untracked untracked;
+			defaultRadio = new Radio();
+		}
+		selected = defaultRadio;
+	}
+	return *selected;
+}
+
+// Events raised while the radio is locked, delivered once it isn't
+class PendingEvent {
+public:
+	Radio *radio;
+	arduino_event_id_t event;
+	arduino_event_info_t info;
+};
+
+static std::vector<PendingEvent> &outbox() {
+	static thread_local std::vector<PendingEvent> *events = NULL;
+	if (events == NULL) {
+		Untracked untracked;
+		events = new std::vector<PendingEvent>();
+	}
+	return *events;
+}
+
+void Radio::fire(arduino_event_id_t event, arduino_event_info_t info) {
+	Untracked untracked;
+	PendingEvent pending;
+	pending.radio = this;
+	pending.event = event;
+	pending.info = info;
+	outbox().push_back(pending);
+}
+
+/** Run the callbacks of the events raised so far, with the radio they came from selected */
+static void dispatch() {
+	while (!outbox().empty()) {
+		PendingEvent pending = outbox().front();
+		std::vector<Radio::Handler> handlers;
+		{
+			Untracked untracked;
+			outbox().erase(outbox().begin());
+			if (std::find(air().radios.begin(), air().radios.end(), pending.radio) == air().radios.end()) {
+				continue;
+			}
+			std::lock_guard<std::recursive_mutex> lock(*pending.radio->mutex);
+			handlers = pending.radio->handlers;
+		}
+
+		Radio *previous = selected;
+		selected = pending.radio;
+		for (const Radio::Handler &handler : handlers) {
+			if (handler.event == pending.event || handler.event == ARDUINO_EVENT_MAX) {
+				handler.callback(pending.event, pending.info);
+			}
+		}
+		selected = previous;
+	}
+}
+
+void Radio::after(unsigned long ms, std::function<void()> step) {
+	Radio *radio = this;
+	schedule(ms, [radio, step]() {
+		{
+			Untracked untracked;
+			if (std::find(air().radios.begin(), air().radios.end(), radio) == air().radios.end()) {
+				return;
+			}
+		}
+		{
+			std::lock_guard<std::recursive_mutex> lock(*radio->mutex);
+			step();
+		}
+		dispatch();
+	});
+}
+
+void Radio::fireDisconnected(uint8_t reason) {
+	arduino_event_info_t info;
+	memset(&info, 0, sizeof(info));
+	info.wifi_sta_disconnected.reason = reason;
+	if (ap != NULL) {
+		size_t length = std::min((size_t)ap->ssid.length(), sizeof(info.wifi_sta_disconnected.ssid));
+		memcpy(info.wifi_sta_disconnected.ssid, ap->ssid.c_str(), length);
+		info.wifi_sta_disconnected.ssid_len = length;
+		memcpy(info.wifi_sta_disconnected.bssid, ap->bssid, sizeof(ap->bssid));
+	}
+	fire(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, info);
+}
+
+/** Station lost its AP or gave up on it */
+void Radio::lose(uint8_t reason) {
+	fireDisconnected(reason);
+	ap = NULL;
+	associated = false;
+	ip = 0;
+	status = reason == WIFI_REASON_NO_AP_FOUND ? WL_NO_SSID_AVAIL
+			: (reason == WIFI_REASON_AUTH_FAIL || reason == WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT) ? WL_CONNECT_FAILED
+			: reason == WIFI_REASON_BEACON_TIMEOUT ? WL_CONNECTION_LOST : WL_DISCONNECTED;
+	generation++;
+}
+
+/** Start associating: fails after a while unless the AP is up, has room and the password matches */
+void Radio::connect(AccessPoint *target, const char *pass, bool fast) {
+	unsigned generation = this->generation;
+	Radio *radio = this;
+	unsigned long now = millis();
+
+	if (target == NULL) {
+		after(notFoundMs, [radio, generation]() {
+			if (radio->generation == generation) {
+				radio->lose(WIFI_REASON_NO_AP_FOUND);
+			}
+		});
+		return;
+	}
+
+	ap = target;
+	target->attempts++;
+	if (target->onAttempt) {
+		target->onAttempt(now);
+	}
+
+	bool overloaded = false;
+	if (target->capacity > 0) {
+		Untracked untracked;
+		std::vector<unsigned long> &recent = target->recent;
+		recent.erase(std::remove_if(recent.begin(), recent.end(), [now](unsigned long ms) { return now - ms >= 1000; }), recent.end());
+		overloaded = recent.size() >= target->capacity;
+		recent.push_back(now);
+	}
+
+	unsigned long associateMs = fast ? target->associateMs / 4 : target->associateMs;
+	if (!target->up || overloaded) {
+		target->failures++;
+		after(associateMs * 5, [radio, generation]() {
+			if (radio->generation == generation) {
+				radio->lose(WIFI_REASON_HANDSHAKE_TIMEOUT);
+			}
+		});
+		return;
+	}
+	if (target->pass != pass) {
+		after(associateMs, [radio, generation]() {
+			if (radio->generation == generation) {
+				radio->lose(WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT);
+			}
+		});
+		return;
+	}
+
+	after(associateMs, [radio, generation]() {
+		if (radio->generation != generation) {
+			return;
+		}
+		radio->associated = true;
+		arduino_event_info_t info;
+		memset(&info, 0, sizeof(info));
+		radio->fire(ARDUINO_EVENT_WIFI_STA_CONNECTED, info);
+
+		unsigned long dhcpMs = radio->staticIP != 0 ? 10 : radio->ap->dhcpMs;
+		radio->after(dhcpMs, [radio, generation]() {
+			if (radio->generation == generation) {
+				radio->gotIP();
+			}
+		});
+	});
+}
+
+void Radio::gotIP() {
+	if (staticIP != 0) {
+		ip = staticIP;
+		gateway = staticGateway;
+		netmask = staticNetmask;
+		dns = staticDNS;
+	} else {
+		ip = ap->subnet | ((uint32_t)(100 + id % 150) << 24);
+		gateway = ap->subnet | (1UL << 24);
+		netmask = 0x00FFFFFF;
+		dns = gateway;
+	}
+	status = WL_CONNECTED;
+
+	arduino_event_info_t info;
+	memset(&info, 0, sizeof(info));
+	info.got_ip.ip = ip;
+	info.got_ip.netmask = netmask;
+	info.got_ip.gw = gateway;
+	fire(ARDUINO_EVENT_WIFI_STA_GOT_IP, info);
+}
+
+void Radio::finishScan() {
+	Untracked untracked;
+	results.clear();
+	for (const AccessPoint &ap : air().accessPoints) {
+		if (!ap.up) {
+			continue;
+		}
+		results.push_back(ap);
+		AccessPoint &result = results.back();
+		if (rssiJitter > 0) {
+			jitterState = jitterState * 1664525 + 1013904223;
+			result.rssi += (int)((jitterState >> 16) % (2 * rssiJitter + 1)) - rssiJitter;
+		}
+		if (result.hidden) {
+			result.ssid = "";
+		}
+	}
+	scanning = false;
+	scanDone = true;
+	scans++;
+
+	arduino_event_info_t info;
+	memset(&info, 0, sizeof(info));
+	fire(ARDUINO_EVENT_WIFI_SCAN_DONE, info);
+}
+
+void Radio::wpsSuccess(AccessPoint &target) {
+	AccessPoint *ap = &target;
+	Radio *radio = this;
+	after(wpsMs, [radio, ap]() {
+		if (!radio->wpsRunning) {
+			return;
+		}
+		radio->wpsRunning = false;
+		cancel(radio->wpsTimeoutTask);
+		{
+			Untracked untracked;
+			radio->configSSID = ap->ssid;
+			radio->configPass = ap->pass;
+		}
+		arduino_event_info_t info;
+		memset(&info, 0, sizeof(info));
+		radio->fire(ARDUINO_EVENT_WPS_ER_SUCCESS, info);
+	});
+}
+
+}
+
+using host::Radio;
+using host::AccessPoint;
+
+#define RADIO Radio &radio = Radio::current(); std::lock_guard<std::recursive_mutex> lock(*radio.mutex)
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb callback, arduino_event_id_t event) {
+	RADIO;
+	host::Untracked untracked;
+	Radio::Handler handler;
+	handler.id = radio.nextHandlerId++;
+	handler.event = event;
+	handler.callback = callback;
+	radio.handlers.push_back(handler);
+	return handler.id;
+}
+
+void WiFiClass::removeEvent(wifi_event_id_t id) {
+	RADIO;
+	host::Untracked untracked;
+	for (size_t i = 0; i < radio.handlers.size(); i++) {
+		if (radio.handlers[i].id == id) {
+			radio.handlers.erase(radio.handlers.begin() + i);
+			return;
+		}
+	}
+}
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+	RADIO;
+	if (!(mode & WIFI_MODE_STA) && (radio.mode & WIFI_MODE_STA)) {
+		radio.generation++;
+		radio.ap = NULL;
+		radio.associated = false;
+		radio.ip = 0;
+		radio.status = WL_DISCONNECTED;
+	}
+	if (!(mode & WIFI_MODE_AP)) {
+		radio.apUp = false;
+	}
+	radio.mode = mode;
+	return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+	RADIO;
+	return radio.mode;
+}
+
+bool WiFiClass::enableSTA(bool enable) {
+	wifi_mode_t current = getMode();
+	return mode((wifi_mode_t)(enable ? (current | WIFI_MODE_STA) : (current & ~WIFI_MODE_STA)));
+}
+
+bool WiFiClass::enableAP(bool enable) {
+	wifi_mode_t current = getMode();
+	return mode((wifi_mode_t)(enable ? (current | WIFI_MODE_AP) : (current & ~WIFI_MODE_AP)));
+}
+
+void WiFiClass::persistent(bool persistent) {
+}
+
+bool WiFiClass::setHostname(const char *hostname) {
+	return true;
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase, int32_t channel, const uint8_t *bssid, bool connect) {
+	RADIO;
+	if (ssid == NULL || *ssid == 0 || strlen(ssid) > 32) {
+		return WL_CONNECT_FAILED;
+	}
+	radio.mode = (wifi_mode_t)(radio.mode | WIFI_MODE_STA);
+	radio.generation++;
+	if (radio.associated) {
+		radio.fireDisconnected(WIFI_REASON_ASSOC_LEAVE);
+	}
+	radio.ap = NULL;
+	radio.associated = false;
+	radio.ip = 0;
+	radio.status = WL_DISCONNECTED;
+	{
+		host::Untracked untracked;
+		radio.configSSID = ssid;
+		radio.configPass = passphrase != NULL ? passphrase : "";
+	}
+	radio.begins++;
+
+	// The strongest AP with that name, or the given one
+	AccessPoint *target = NULL;
+	for (AccessPoint &ap : host::air().accessPoints) {
+		if (ap.ssid != ssid || (bssid != NULL && memcmp(ap.bssid, bssid, sizeof(ap.bssid)) != 0)
+				|| (channel != 0 && ap.channel != channel)) {
+			continue;
+		}
+		if (target == NULL || ap.rssi > target->rssi) {
+			target = &ap;
+		}
+	}
+	if (connect) {
+		radio.connect(target, radio.configPass.c_str(), bssid != NULL && channel != 0);
+	}
+	radio.after(0, []() {});	// Delivers the leave event, if any
+	return radio.status;
+}
+
+wl_status_t WiFiClass::begin() {
+	String ssid;
+	String pass;
+	{
+		RADIO;
+		host::Untracked untracked;
+		ssid = radio.configSSID;
+		pass = radio.configPass;
+	}
+	if (ssid.length() == 0) {
+		return WL_CONNECT_FAILED;
+	}
+	return begin(ssid.c_str(), pass.c_str());
+}
+
+bool WiFiClass::config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+	RADIO;
+	radio.staticIP = local_ip;
+	radio.staticGateway = gateway;
+	radio.staticNetmask = subnet;
+	radio.staticDNS = dns1;
+	return true;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap) {
+	RADIO;
+	radio.generation++;
+	if (radio.associated) {
+		radio.fireDisconnected(WIFI_REASON_ASSOC_LEAVE);
+		radio.after(0, []() {});
+	}
+	radio.ap = NULL;
+	radio.associated = false;
+	radio.ip = 0;
+	radio.status = WL_DISCONNECTED;
+	if (eraseap) {
+		host::Untracked untracked;
+		radio.configSSID = "";
+		radio.configPass = "";
+	}
+	if (wifioff) {
+		radio.mode = (wifi_mode_t)(radio.mode & ~WIFI_MODE_STA);
+	}
+	return true;
+}
+
+bool WiFiClass::isConnected() {
+	return status() == WL_CONNECTED;
+}
+
+bool WiFiClass::setAutoConnect(bool autoConnect) {
+	return true;
+}
+
+/** Stored only: the fake radio never reconnects by itself, everything comes from the library */
+bool WiFiClass::setAutoReconnect(bool autoReconnect) {
+	RADIO;
+	radio.autoReconnect = autoReconnect;
+	return true;
+}
+
+bool WiFiClass::getAutoReconnect() {
+	RADIO;
+	return radio.autoReconnect;
+}
+
+wl_status_t WiFiClass::status() {
+	RADIO;
+	return radio.status;
+}
+
+IPAddress WiFiClass::localIP() {
+	RADIO;
+	return IPAddress(radio.ip);
+}
+
+IPAddress WiFiClass::gatewayIP() {
+	RADIO;
+	return IPAddress(radio.ip != 0 ? radio.gateway : 0);
+}
+
+IPAddress WiFiClass::subnetMask() {
+	RADIO;
+	return IPAddress(radio.ip != 0 ? radio.netmask : 0);
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t dns_no) {
+	RADIO;
+	return IPAddress(radio.ip != 0 && dns_no == 0 ? radio.dns : 0);
+}
+
+static String formatMac(int id, uint8_t last) {
+	char mac[18];
+	snprintf(mac, sizeof(mac), "24:0A:C4:%02X:%02X:%02X", (id >> 8) & 0xFF, id & 0xFF, last);
+	return String(mac);
+}
+
+String WiFiClass::macAddress() {
+	RADIO;
+	return formatMac(radio.id, 0x10);
+}
+
+/** As on the ESP32, the SSID of the AP the station is connected to, or empty */
+String WiFiClass::SSID() const {
+	RADIO;
+	return radio.associated ? radio.ap->ssid : String();
+}
+
+String WiFiClass::psk() const {
+	RADIO;
+	return radio.configPass;
+}
+
+uint8_t* WiFiClass::BSSID() {
+	RADIO;
+	return radio.associated ? radio.ap->bssid : NULL;
+}
+
+int8_t WiFiClass::RSSI() {
+	RADIO;
+	return radio.associated ? radio.ap->rssi : 0;
+}
+
+int32_t WiFiClass::channel() {
+	RADIO;
+	return radio.associated ? radio.ap->channel : 0;
+}
+
+bool WiFiClass::softAP(const char *ssid, const char *passphrase, int channel, int ssid_hidden, int max_connection) {
+	RADIO;
+	if (ssid == NULL || *ssid == 0) {
+		return false;
+	}
+	radio.mode = (wifi_mode_t)(radio.mode | WIFI_MODE_AP);
+	radio.apUp = true;
+	if (radio.apIP == 0) {
+		radio.apIP = host::AP_IP;
+	}
+	host::Untracked untracked;
+	radio.apSSID = ssid;
+	radio.apPass = passphrase != NULL ? passphrase : "";
+	return true;
+}
+
+bool WiFiClass::softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet) {
+	RADIO;
+	radio.apIP = local_ip;
+	return true;
+}
+
+bool WiFiClass::softAPdisconnect(bool wifioff) {
+	return enableAP(false);
+}
+
+IPAddress WiFiClass::softAPIP() {
+	RADIO;
+	return IPAddress((radio.mode & WIFI_MODE_AP) && radio.apUp ? radio.apIP : 0);
+}
+
+String WiFiClass::softAPmacAddress() {
+	RADIO;
+	return formatMac(radio.id, 0x11);
+}
+
+/** Fails while the station is associating, as the ESP32 does */
+int16_t WiFiClass::scanNetworks(bool async, bool show_hidden) {
+	Radio *scanning;
+	{
+		RADIO;
+		if (radio.scanning) {
+			return WIFI_SCAN_RUNNING;
+		}
+		if (radio.ap != NULL && !radio.associated) {
+			return WIFI_SCAN_FAILED;
+		}
+		radio.mode = (wifi_mode_t)(radio.mode | WIFI_MODE_STA);
+		radio.scanning = true;
+		radio.scanDone = false;
+		unsigned generation = ++radio.scanGeneration;
+		scanning = &radio;
+		radio.after(radio.scanMs, [scanning, generation]() {
+			if (scanning->scanGeneration == generation && scanning->scanning) {
+				scanning->finishScan();
+			}
+		});
+		if (async) {
+			return WIFI_SCAN_RUNNING;
+		}
+	}
+	host::advance(scanning->scanMs);
+	return scanComplete();
+}
+
+int16_t WiFiClass::scanComplete() {
+	RADIO;
+	if (radio.scanning) {
+		return WIFI_SCAN_RUNNING;
+	}
+	return radio.scanDone ? radio.results.size() : WIFI_SCAN_FAILED;
+}
+
+void WiFiClass::scanDelete() {
+	RADIO;
+	host::Untracked untracked;
+	radio.results.clear();
+	radio.scanDone = false;
+}
+
+bool WiFiClass::getNetworkInfo(uint8_t i, String &ssid, uint8_t &encType, int32_t &rssi, uint8_t* &bssid, int32_t &channel) {
+	RADIO;
+	if (i >= radio.results.size()) {
+		return false;
+	}
+	const AccessPoint &ap = radio.results[i];
+	ssid = ap.ssid;
+	encType = ap.pass.length() > 0 ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+	rssi = ap.rssi;
+	bssid = radio.results[i].bssid;
+	channel = ap.channel;
+	return true;
+}
+
+String WiFiClass::SSID(uint8_t i) {
+	RADIO;
+	return i < radio.results.size() ? radio.results[i].ssid : String();
+}
+
+wifi_auth_mode_t WiFiClass::encryptionType(uint8_t i) {
+	RADIO;
+	return i < radio.results.size() && radio.results[i].pass.length() > 0 ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+}
+
+int32_t WiFiClass::RSSI(uint8_t i) {
+	RADIO;
+	return i < radio.results.size() ? radio.results[i].rssi : 0;
+}
+
+uint8_t* WiFiClass::BSSID(uint8_t i) {
+	RADIO;
+	return i < radio.results.size() ? radio.results[i].bssid : NULL;
+}
+
+int32_t WiFiClass::channel(uint8_t i) {
+	RADIO;
+	return i < radio.results.size() ? radio.results[i].channel : 0;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf) {
+	RADIO;
+	memset(conf, 0, sizeof(*conf));
+	if (interface == WIFI_IF_STA) {
+		memcpy(conf->sta.ssid, radio.configSSID.c_str(), std::min((size_t)radio.configSSID.length(), sizeof(conf->sta.ssid)));
+		memcpy(conf->sta.password, radio.configPass.c_str(), std::min((size_t)radio.configPass.length(), sizeof(conf->sta.password)));
+	} else {
+		memcpy(conf->ap.ssid, radio.apSSID.c_str(), std::min((size_t)radio.apSSID.length(), sizeof(conf->ap.ssid) - 1));
+		memcpy(conf->ap.password, radio.apPass.c_str(), std::min((size_t)radio.apPass.length(), sizeof(conf->ap.password)));
+		conf->ap.ssid_len = radio.apSSID.length();
+	}
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_wps_enable(const esp_wps_config_t *config) {
+	RADIO;
+	if (!(radio.mode & WIFI_MODE_STA) || config->wps_type != WPS_TYPE_PBC) {
+		return ESP_FAIL;
+	}
+	radio.wpsEnabled = true;
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_wps_disable() {
+	RADIO;
+	radio.wpsEnabled = false;
+	radio.wpsRunning = false;
+	host::cancel(radio.wpsTimeoutTask);
+	return ESP_OK;
+}
+
+/** Finds a button pressed within the last walk time, or waits for one until the SDK's own timeout */
+esp_err_t esp_wifi_wps_start(int timeout_ms) {
+	RADIO;
+	if (!radio.wpsEnabled) {
+		return ESP_FAIL;
+	}
+	radio.wpsRunning = true;
+	Radio *wps = &radio;
+	unsigned long walkTime = 120000;
+	radio.wpsTimeoutTask = host::schedule(walkTime, [wps]() {
+		{
+			std::lock_guard<std::recursive_mutex> lock(*wps->mutex);
+			if (!wps->wpsRunning) {
+				return;
+			}
+			wps->wpsRunning = false;
+			arduino_event_info_t info;
+			memset(&info, 0, sizeof(info));
+			wps->fire(ARDUINO_EVENT_WPS_ER_TIMEOUT, info);
+		}
+		wps->after(0, []() {});
+	});
+	for (AccessPoint &ap : host::air().accessPoints) {
+		if (ap.wpsPressed && millis() - ap.wpsPressedMs < walkTime) {
+			radio.wpsSuccess(ap);
+			break;
+		}
+	}
+	return ESP_OK;
+}
@@ -0,0 +1,149 @@
+// Host stand-in for the ESP32 WiFi library. Every call goes to the selected host::Radio, a scripted
+// fake radio that connects, scans and runs WPS against the access points of host::Air, delivering
+// the events from the virtual clock (see HostRadio.h).
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <functional>
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_wifi.h"
+
+typedef enum {
+	WL_NO_SHIELD = 255,
+	WL_IDLE_STATUS = 0,
+	WL_NO_SSID_AVAIL = 1,
+	WL_SCAN_COMPLETED = 2,
+	WL_CONNECTED = 3,
+	WL_CONNECT_FAILED = 4,
+	WL_CONNECTION_LOST = 5,
+	WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+	WIFI_MODE_NULL = 0,
+	WIFI_MODE_STA,
+	WIFI_MODE_AP,
+	WIFI_MODE_APSTA,
+	WIFI_MODE_MAX
+} wifi_mode_t;
+
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+#define WIFI_AP WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+typedef enum {
+	ARDUINO_EVENT_WIFI_READY = 0,
+	ARDUINO_EVENT_WIFI_SCAN_DONE,
+	ARDUINO_EVENT_WIFI_STA_START,
+	ARDUINO_EVENT_WIFI_STA_STOP,
+	ARDUINO_EVENT_WIFI_STA_CONNECTED,
+	ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+	ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+	ARDUINO_EVENT_WIFI_STA_GOT_IP,
+	ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+	ARDUINO_EVENT_WIFI_STA_LOST_IP,
+	ARDUINO_EVENT_WIFI_AP_START,
+	ARDUINO_EVENT_WIFI_AP_STOP,
+	ARDUINO_EVENT_WIFI_AP_STACONNECTED,
+	ARDUINO_EVENT_WIFI_AP_STADISCONNECTED,
+	ARDUINO_EVENT_WIFI_AP_STAIPASSIGNED,
+	ARDUINO_EVENT_WIFI_AP_PROBEREQRECVED,
+	ARDUINO_EVENT_WIFI_AP_GOT_IP6,
+	ARDUINO_EVENT_WPS_ER_SUCCESS,
+	ARDUINO_EVENT_WPS_ER_FAILED,
+	ARDUINO_EVENT_WPS_ER_TIMEOUT,
+	ARDUINO_EVENT_WPS_ER_PIN,
+	ARDUINO_EVENT_WPS_ER_PBC_OVERLAP,
+	ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+
+typedef struct {
+	uint8_t ssid[32];
+	uint8_t ssid_len;
+	uint8_t bssid[6];
+	uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef struct {
+	uint32_t ip;
+	uint32_t netmask;
+	uint32_t gw;
+} ip_event_got_ip_t;
+
+typedef union {
+	wifi_event_sta_disconnected_t wifi_sta_disconnected;
+	ip_event_got_ip_t got_ip;
+} arduino_event_info_t;
+
+typedef arduino_event_info_t WiFiEventInfo_t;
+typedef uint16_t wifi_event_id_t;
+typedef wifi_event_id_t WiFiEventId_t;
+typedef std::function<void(arduino_event_id_t event, arduino_event_info_t info)> WiFiEventFuncCb;
+
+class WiFiClass {
+public:
+	// Generic
+	wifi_event_id_t onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+	void removeEvent(wifi_event_id_t id);
+	bool mode(wifi_mode_t mode);
+	wifi_mode_t getMode();
+	bool enableSTA(bool enable);
+	bool enableAP(bool enable);
+	void persistent(bool persistent);
+	bool setHostname(const char *hostname);
+	bool hostname(const char *hostname) {
+		return setHostname(hostname);
+	}
+
+	// Station
+	wl_status_t begin(const char *ssid, const char *passphrase = NULL, int32_t channel = 0, const uint8_t *bssid = NULL, bool connect = true);
+	wl_status_t begin();
+	bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1 = (uint32_t)0x00000000, IPAddress dns2 = (uint32_t)0x00000000);
+	bool disconnect(bool wifioff = false, bool eraseap = false);
+	bool isConnected();
+	bool setAutoConnect(bool autoConnect);
+	bool setAutoReconnect(bool autoReconnect);
+	bool getAutoReconnect();
+	wl_status_t status();
+	IPAddress localIP();
+	IPAddress gatewayIP();
+	IPAddress subnetMask();
+	IPAddress dnsIP(uint8_t dns_no = 0);
+	String macAddress();
+	String SSID() const;
+	String psk() const;
+	uint8_t* BSSID();
+	int8_t RSSI();
+	int32_t channel();
+
+	// Soft AP
+	bool softAP(const char *ssid, const char *passphrase = NULL, int channel = 1, int ssid_hidden = 0, int max_connection = 4);
+	bool softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet);
+	bool softAPdisconnect(bool wifioff = false);
+	IPAddress softAPIP();
+	String softAPmacAddress();
+
+	// Scan
+	int16_t scanNetworks(bool async = false, bool show_hidden = false);
+	int16_t scanComplete();
+	void scanDelete();
+	bool getNetworkInfo(uint8_t networkItem, String &ssid, uint8_t &encryptionType, int32_t &RSSI, uint8_t* &BSSID, int32_t &channel);
+	String SSID(uint8_t networkItem);
+	wifi_auth_mode_t encryptionType(uint8_t networkItem);
+	int32_t RSSI(uint8_t networkItem);
+	uint8_t* BSSID(uint8_t networkItem);
+	int32_t channel(uint8_t networkItem);
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+// Plain RAM on the host, so RTC memory survives a "deep sleep" only within one process
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+
+#endif
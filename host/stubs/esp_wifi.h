@@ -0,0 +1,63 @@
+// The parts of the ESP-IDF WiFi API the library calls, backed by the host radio (see HostRadio.h)
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum {
+	WIFI_IF_STA = 0,
+	WIFI_IF_AP
+} wifi_interface_t;
+
+#define ESP_IF_WIFI_STA WIFI_IF_STA
+#define ESP_IF_WIFI_AP WIFI_IF_AP
+
+typedef enum {
+	WIFI_AUTH_OPEN = 0,
+	WIFI_AUTH_WEP,
+	WIFI_AUTH_WPA_PSK,
+	WIFI_AUTH_WPA2_PSK,
+	WIFI_AUTH_WPA_WPA2_PSK,
+	WIFI_AUTH_WPA2_ENTERPRISE,
+	WIFI_AUTH_WPA3_PSK,
+	WIFI_AUTH_WPA2_WPA3_PSK,
+	WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+
+typedef enum {
+	WIFI_REASON_ASSOC_LEAVE = 8,
+	WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT = 15,
+	WIFI_REASON_BEACON_TIMEOUT = 200,
+	WIFI_REASON_NO_AP_FOUND = 201,
+	WIFI_REASON_AUTH_FAIL = 202,
+	WIFI_REASON_ASSOC_FAIL = 203,
+	WIFI_REASON_HANDSHAKE_TIMEOUT = 204
+} wifi_err_reason_t;
+
+typedef struct {
+	uint8_t ssid[32];
+	uint8_t password[64];
+	uint8_t bssid_set;
+	uint8_t bssid[6];
+	uint8_t channel;
+} wifi_sta_config_t;
+
+typedef struct {
+	uint8_t ssid[32];
+	uint8_t password[64];
+	uint8_t ssid_len;
+	uint8_t channel;
+} wifi_ap_config_t;
+
+typedef union {
+	wifi_ap_config_t ap;
+	wifi_sta_config_t sta;
+} wifi_config_t;
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf);
+
+#endif
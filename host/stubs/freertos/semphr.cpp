@@ -0,0 +1,26 @@
+#include "semphr.h"
+#include <chrono>
+#include <mutex>
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+	return new std::timed_mutex();
+}
+
+/** Ticks are taken as milliseconds, as with the default 1 kHz tick of the ESP32 */
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+	std::timed_mutex *mutex = static_cast<std::timed_mutex *>(semaphore);
+	if (ticks == portMAX_DELAY) {
+		mutex->lock();
+		return pdTRUE;
+	}
+	return mutex->try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+	static_cast<std::timed_mutex *>(semaphore)->unlock();
+	return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+	delete static_cast<std::timed_mutex *>(semaphore);
+}
@@ -0,0 +1,14 @@
+// Mutexes only, backed by std::timed_mutex. Like a FreeRTOS mutex, taking it twice from one task blocks.
+#ifndef HOST_SEMPHR_H
+#define HOST_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif
@@ -0,0 +1,5 @@
+// Reset reasons aren't simulated, the library only needs the header
+#ifndef HOST_ROM_RTC_H
+#define HOST_ROM_RTC_H
+
+#endif
@@ -17,6 +17,57 @@
 #else
 #include <core_version.h>
 #endif
+#include <EEPROM.h>
+#include <algorithm>
+#include <limits.h>
+
+// Instrumentation, these compile to nothing without WIFI_MANAGER_STATS
+#ifdef WIFI_MANAGER_STATS
+#define WM_STATS_START(name) unsigned long name = micros()
+#define WM_STATS_ADD(counter, value) (_stats.counter += (value))
+#define WM_STATS_ROUTE(route, start, bytes) _countRoute(AsyncWiFiManagerStats::route, start, bytes)
+#define WM_STATS_BYTES(route) (&_stats.routes[AsyncWiFiManagerStats::route].bytes)
+#else
+#define WM_STATS_START(name)
+#define WM_STATS_ADD(counter, value)
+#define WM_STATS_ROUTE(route, start, bytes)
+#define WM_STATS_BYTES(route) NULL
+#endif
+
+/** Format an IP address into a buffer of at least 16 characters */
+static void formatIP(IPAddress ip, char *buf) {
+	snprintf(buf, 16, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+}
+
+/** Parse a dotted quad without allocating, false unless the whole string is four octets */
+static bool parseIP(const char *str, IPAddress &ip) {
+	uint8_t octets[4];
+	for (int i = 0; i < 4; i++) {
+		if (i > 0 && *str++ != '.') {
+			return false;
+		}
+		if (*str < '0' || *str > '9') {
+			return false;
+		}
+		unsigned int octet = 0;
+		for (int digits = 0; *str >= '0' && *str <= '9'; digits++) {
+			if (digits == 3) {
+				return false;
+			}
+			octet = octet * 10 + (*str++ - '0');
+		}
+		if (octet > 255) {
+			return false;
+		}
+		octets[i] = octet;
+	}
+	if (*str != 0) {
+		return false;
+	}
+
+	ip = IPAddress(octets[0], octets[1], octets[2], octets[3]);
+	return true;
+}
 
 AsyncWiFiManagerParameter::AsyncWiFiManagerParameter(const char *custom) {
 	_id = NULL;
@@ -39,10 +90,8 @@ void AsyncWiFiManagerParameter::init(const char *id, const char *placeholder, co
 	_id = id;
 	_placeholder = placeholder;
 	_length = length;
-	_value = new char[length + 1];
-	for (int i = 0; i < length; i++) {
-		_value[i] = 0;
-	}
+	_value = AsyncWiFiManagerArena::values().allocate(length + 1);
+	memset(_value, 0, length + 1);
 	if (defaultValue != NULL) {
 		strncpy(_value, defaultValue, length);
 	}
@@ -50,7 +99,135 @@ void AsyncWiFiManagerParameter::init(const char *id, const char *placeholder, co
 	_customHTML = custom;
 }
 
+AsyncWiFiManagerParameter::AsyncWiFiManagerParameter(const char *id, const char *placeholder, int defaultValue, int min, int max) {
+	initTyped(id, placeholder, INT);
+	_data.i = defaultValue;
+	_min.i = min;
+	_max.i = max;
+}
+
+AsyncWiFiManagerParameter::AsyncWiFiManagerParameter(const char *id, const char *placeholder, double defaultValue, double min, double max) {
+	initTyped(id, placeholder, FLOAT);
+	_data.f = defaultValue;
+	_min.f = min;
+	_max.f = max;
+}
+
+AsyncWiFiManagerParameter::AsyncWiFiManagerParameter(const char *id, const char *placeholder, bool defaultValue) {
+	initTyped(id, placeholder, BOOL);
+	_data.i = defaultValue;
+}
+
+AsyncWiFiManagerParameter::AsyncWiFiManagerParameter(const char *id, const char *placeholder, IPAddress defaultValue) {
+	initTyped(id, placeholder, IP);
+	_data.ip = (uint32_t)defaultValue;
+}
+
+/** One of optionCount names, saved as its index. The options array must outlive the parameter. */
+AsyncWiFiManagerParameter::AsyncWiFiManagerParameter(const char *id, const char *placeholder, const char *const *options, uint8_t optionCount, uint8_t defaultOption) {
+	initTyped(id, placeholder, ENUM);
+	_options = options;
+	_optionCount = optionCount;
+	_data.i = defaultOption < optionCount ? defaultOption : 0;
+}
+
+void AsyncWiFiManagerParameter::initTyped(const char *id, const char *placeholder, Type type) {
+	// _value is only a buffer to format the binary value into, wide enough for any float
+	init(id, placeholder, NULL, type == FLOAT ? 47 : 15, "");
+	_type = type;
+	_data.i = 0;
+	_min.i = 0;
+	_max.i = 0;
+}
+
+/** Parse form text into a binary value of this parameter's type, false if it is malformed or out of range */
+bool AsyncWiFiManagerParameter::parse(const char *text, Value &value) {
+	char *end;
+	switch (_type) {
+	case INT: {
+		long parsed = strtol(text, &end, 10);
+		if (end == text || *end != 0 || parsed < _min.i || parsed > _max.i) {
+			return false;
+		}
+		value.i = parsed;
+		return true;
+	}
+
+	case FLOAT: {
+		float parsed = strtod(text, &end);
+		if (end == text || *end != 0 || !(parsed >= _min.f && parsed <= _max.f)) {
+			return false;		// The comparison also rejects NaN
+		}
+		value.f = parsed;
+		return true;
+	}
+
+	case BOOL:
+		// Checkboxes send "on" unless they have a value, and nothing at all when unchecked
+		if (*text == 0 || strcmp(text, "0") == 0 || strcmp(text, "false") == 0 || strcmp(text, "off") == 0) {
+			value.i = 0;
+		} else if (strcmp(text, "1") == 0 || strcmp(text, "true") == 0 || strcmp(text, "on") == 0) {
+			value.i = 1;
+		} else {
+			return false;
+		}
+		return true;
+
+	case IP: {
+		IPAddress ip;
+		if (!parseIP(text, ip)) {
+			return false;
+		}
+		value.ip = (uint32_t)ip;
+		return true;
+	}
+
+	case ENUM:
+		for (uint8_t i = 0; i < _optionCount; i++) {
+			if (strcmp(text, _options[i]) == 0) {
+				value.i = i;
+				return true;
+			}
+		}
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+/** Bytes this parameter takes in the saved record: the binary value, or the whole string buffer */
+size_t AsyncWiFiManagerParameter::storedSize() {
+	return _type == STRING ? _length + 1 : sizeof(Value);
+}
+
 const char* AsyncWiFiManagerParameter::getValue() {
+	switch (_type) {
+	case INT:
+		snprintf(_value, _length + 1, "%ld", (long)_data.i);
+		break;
+	case FLOAT: {
+		dtostrf(_data.f, 1, 6, _value);
+		// Drop the trailing zeros of the fixed precision
+		char *end = _value + strlen(_value) - 1;
+		while (*end == '0') {
+			*end-- = 0;
+		}
+		if (*end == '.') {
+			*end = 0;
+		}
+		break;
+	}
+	case BOOL:
+		return "1";		// The checkbox value, checked or not is in the custom HTML
+	case IP:
+		formatIP(IPAddress(_data.ip), _value);
+		break;
+	case ENUM:
+		return _options[_data.i];
+	default:
+		break;
+	}
 	return _value;
 }
 const char* AsyncWiFiManagerParameter::getID() {
@@ -65,11 +242,50 @@ int AsyncWiFiManagerParameter::getValueLength() {
 const char* AsyncWiFiManagerParameter::getCustomHTML() {
 	return _customHTML;
 }
+AsyncWiFiManagerParameter::Type AsyncWiFiManagerParameter::getType() {
+	return _type;
+}
+int AsyncWiFiManagerParameter::getInt() {
+	return _data.i;
+}
+float AsyncWiFiManagerParameter::getFloat() {
+	return _data.f;
+}
+bool AsyncWiFiManagerParameter::getBool() {
+	return _data.i != 0;
+}
+IPAddress AsyncWiFiManagerParameter::getIP() {
+	return IPAddress(_data.ip);
+}
+uint8_t AsyncWiFiManagerParameter::getOption() {
+	return _data.i;
+}
+
+/** The arena shared by all parameters, created on first use so global parameters can rely on it */
+AsyncWiFiManagerArena& AsyncWiFiManagerArena::values() {
+	static AsyncWiFiManagerArena arena;
+	return arena;
+}
+
+char* AsyncWiFiManagerArena::allocate(size_t size) {
+	if (size > WIFI_MANAGER_ARENA_CHUNK / 2) {
+		return new char[size];		// Would waste most of a block, keep the current one for smaller values
+	}
+
+	if (size > _free) {
+		_next = new char[WIFI_MANAGER_ARENA_CHUNK];
+		_free = WIFI_MANAGER_ARENA_CHUNK;
+	}
+
+	char *block = _next;
+	_next += size;
+	_free -= size;
+	return block;
+}
 
 #ifdef USE_EADNS
 AsyncWiFiManager::AsyncWiFiManager(AsyncWebServer *server, AsyncDNSServer *dns) : server(server), dnsServer(dns) {
 	_cacheHeads();
-	wifiSSIDs = NULL;
 #ifdef ESP32
 	loopMutex = xSemaphoreCreateMutex();
 #endif
@@ -77,13 +293,45 @@ AsyncWiFiManager::AsyncWiFiManager(AsyncWebServer *server, AsyncDNSServer *dns)
 #else
 AsyncWiFiManager::AsyncWiFiManager(AsyncWebServer *server, DNSServer *dns) : server(server), dnsServer(dns) {
 	_cacheHeads();
-	wifiSSIDs = NULL;
 #ifdef ESP32
 	loopMutex = xSemaphoreCreateMutex();
 #endif
 }
 #endif
 
+static const uint32_t FNV_OFFSET_BASIS = 2166136261UL;
+
+static inline uint32_t fnvStep(uint32_t hash, uint8_t c) {
+	return (hash ^ c) * 16777619UL;
+}
+
+/** FNV-1a hash of a string, which may be in PROGMEM */
+static uint32_t hashString(PGM_P str) {
+	uint32_t hash = FNV_OFFSET_BASIS;
+	char c;
+	while ((c = pgm_read_byte(str++)) != 0) {
+		hash = fnvStep(hash, c);
+	}
+	return hash;
+}
+
+/** FNV-1a hash of length bytes in RAM, pass the hash of the previous piece to hash several as one */
+static uint32_t hashBytes(const char *data, size_t length, uint32_t hash = FNV_OFFSET_BASIS) {
+	for (size_t i = 0; i < length; i++) {
+		hash = fnvStep(hash, data[i]);
+	}
+	return hash;
+}
+
+/** Quoted hash of a PROGMEM string, used as its ETag */
+static String contentETag(PGM_P content) {
+	uint32_t hash = hashString(content);
+
+	char etag[11];
+	snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long)hash);
+	return String(etag);
+}
+
 void AsyncWiFiManager::_cacheHeads() {
 	_wifiSaveHead = FPSTR(WFM_HTTP_HEAD);
 	_wifiSaveHead.replace("{v}", "Credentials Saved");
@@ -100,6 +348,10 @@ void AsyncWiFiManager::_cacheHeads() {
 	_resetHead = FPSTR(WFM_HTTP_HEAD);
 	_resetHead.replace("{v}", "Reset");
 
+	// The asset URLs carry the content hash, so a new firmware build is never served from a stale cache
+	_styleLink = String("<link rel=\"stylesheet\" href=\"/wm.css?v=") + String(HTTP_STYLE_ASSET.etag).substring(1, 9) + "\">";
+	_scriptLink = String("<script src=\"/wm.js?v=") + String(HTTP_SCRIPT_ASSET.etag).substring(1, 9) + "\"></script>";
+	_eventsLink = String("<script src=\"/wme.js?v=") + String(HTTP_EVENTS_SCRIPT_ASSET.etag).substring(1, 9) + "\"></script>";
 }
 
 void AsyncWiFiManager::setHostname(const char* hostname) {
@@ -111,18 +363,77 @@ void AsyncWiFiManager::setHostname(const char* hostname) {
 }
 
 void AsyncWiFiManager::addParameter(AsyncWiFiManagerParameter *p) {
+	if (p == NULL) {
+		return;
+	}
+
+	if (_paramsCount == _paramsCapacity) {
+		int capacity = _paramsCapacity == 0 ? 8 : _paramsCapacity * 2;
+		AsyncWiFiManagerParameter **params = new AsyncWiFiManagerParameter*[capacity];
+		uint16_t *index = new uint16_t[capacity];
+		for (int i = 0; i < _paramsCount; i++) {
+			params[i] = _params[i];
+		}
+		for (int i = 0; i < _paramIndexCount; i++) {
+			index[i] = _paramIndex[i];
+		}
+		delete[] _params;
+		delete[] _paramIndex;
+		_params = params;
+		_paramIndex = index;
+		_paramsCapacity = capacity;
+	}
+
+	if (p->getID() != NULL) {
+		// Insert after any parameters with the same ID, so they keep their order
+		int pos = _findParameter(p->getID());
+		while (pos < _paramIndexCount && strcmp(_params[_paramIndex[pos]]->getID(), p->getID()) == 0) {
+			pos++;
+		}
+		for (int i = _paramIndexCount; i > pos; i--) {
+			_paramIndex[i] = _paramIndex[i - 1];
+		}
+		_paramIndex[pos] = _paramsCount;
+		_paramIndexCount++;
+	}
+
 	_params[_paramsCount] = p;
 	_paramsCount++;
+	_invalidatePages();
 //  DEBUG_WM(F("Adding parameter"));
 //  DEBUG_WM(p->getID());
 }
 
+/** Position in _paramIndex of the first parameter whose ID is not less than id */
+int AsyncWiFiManager::_findParameter(const char *id) {
+	int low = 0;
+	int high = _paramIndexCount;
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (strcmp(_params[_paramIndex[mid]]->getID(), id) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
 void AsyncWiFiManager::dnsStart(bool start) {
 	//Make DNS control idempotent
 
 	if (start && !_dnsRunning) {
 		DEBUG_WM(F("Starting DNS server"));
 		_dnsRunning = true;
+		DEBUG_WM(toStringIp(WiFi.softAPIP()));
+		if (_useCaptiveDNS) {
+			_captiveDNS = new CaptiveDNSServer();
+			if (!_captiveDNS->start(DNS_PORT, WiFi.softAPIP(), DNS_TTL)) {
+				DEBUG_WM(F("DNS server did not start"));
+			}
+			return;
+		}
+
 		/* Setup the DNS server redirecting all the domains to the apIP */
 #ifdef USE_EADNS
 		dnsServer->setErrorReplyCode(AsyncDNSReplyCode::NoError);
@@ -130,8 +441,7 @@ void AsyncWiFiManager::dnsStart(bool start) {
 		dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
 #endif
 
-		dnsServer->setTTL(5);
-		DEBUG_WM(toStringIp(WiFi.softAPIP()));
+		dnsServer->setTTL(DNS_TTL);
 		if (!dnsServer->start(DNS_PORT, "*", WiFi.softAPIP())) {
 			DEBUG_WM(F("DNS server did not start"));
 		}
@@ -140,7 +450,12 @@ void AsyncWiFiManager::dnsStart(bool start) {
 	if (!start && _dnsRunning) {
 		DEBUG_WM(F("Stopping DNS server"));
 		_dnsRunning = false;
-		dnsServer->stop();
+		if (_captiveDNS != NULL) {
+			delete _captiveDNS;
+			_captiveDNS = NULL;
+		} else {
+			dnsServer->stop();
+		}
 	}
 }
 
@@ -151,14 +466,24 @@ bool AsyncWiFiManager::isAP() {
 
 wl_status_t AsyncWiFiManager::_connectWiFi() {
 	wl_status_t status = WL_DISCONNECTED;
-	if (_router_ssid.length() > 0) {
-		if (_router_pass.length() > 0) {
-			DEBUG_WM(_router_ssid);
-			DEBUG_WM(_router_pass);
-			status = WiFi.begin(_router_ssid.c_str(), _router_pass.c_str());
+	_attemptPending = true;
+	_attemptMs = millis();
+	_associated = false;
+	if (_networkCount > 0) {
+		if (_candidateIdx >= _networkCount) {
+			_rankNetworks(false);	// The networks changed since the last ranking
+		}
+		_attemptNetwork = _candidates[_candidateIdx];
+
+		const WiFiCredential &network = _networks[_attemptNetwork];
+		DEBUG_WM(network.ssid);
+		if (_beginFastConnect(network.ssid.c_str(), network.pass.c_str(), status)) {
+			// Connecting to the cached AP
+		} else if (network.pass.length() > 0) {
+			DEBUG_WM(network.pass);
+			status = WiFi.begin(network.ssid.c_str(), network.pass.c_str());
 		} else {
-			DEBUG_WM(_router_ssid);
-			status = WiFi.begin(_router_ssid.c_str());
+			status = WiFi.begin(network.ssid.c_str());
 		}
 	} else {
 		DEBUG_WM("Connecting with saved credentials:");
@@ -166,11 +491,19 @@ wl_status_t AsyncWiFiManager::_connectWiFi() {
 #ifdef ESP32
 	    wifi_config_t conf;
 	    esp_wifi_get_config((wifi_interface_t)ESP_IF_WIFI_STA, &conf);
-	    DEBUG_WM(String(reinterpret_cast<char*>(conf.sta.ssid)));
+	    char ssid[33];
+	    char pass[65];
+	    snprintf(ssid, sizeof(ssid), "%.*s", (int)sizeof(conf.sta.ssid), reinterpret_cast<char*>(conf.sta.ssid));
+	    snprintf(pass, sizeof(pass), "%.*s", (int)sizeof(conf.sta.password), reinterpret_cast<char*>(conf.sta.password));
+	    DEBUG_WM(ssid);
+		if (!_beginFastConnect(ssid, pass, status)) {
 #else
-		DEBUG_WM(WiFi.SSID());
+		String ssid = WiFi.SSID();
+		DEBUG_WM(ssid);
+		if (!_beginFastConnect(ssid.c_str(), WiFi.psk().c_str(), status)) {
 #endif
-		status = WiFi.begin();
+			status = WiFi.begin();
+		}
 	}
 
 	DEBUG_WM(status);
@@ -178,6 +511,244 @@ wl_status_t AsyncWiFiManager::_connectWiFi() {
 	return status;
 }
 
+#ifdef ESP32
+RTC_NOINIT_ATTR static WiFiFastConnect rtcFastConnect;
+#endif
+
+/** CRC-32 (IEEE), bitwise so it needs no table */
+static uint32_t crc32(const uint8_t *data, size_t length) {
+	uint32_t crc = 0xFFFFFFFFUL;
+	while (length-- > 0) {
+		crc ^= *data++;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+static bool readFastConnect(WiFiFastConnect &cache) {
+#ifdef ESP8266
+	if (!ESP.rtcUserMemoryRead(WIFI_MANAGER_RTC_OFFSET, reinterpret_cast<uint32_t*>(&cache), sizeof(cache))) {
+		return false;
+	}
+#else
+	cache = rtcFastConnect;
+#endif
+	// After power loss RTC memory holds garbage, the CRC catches that
+	return cache.crc != 0 && cache.crc == crc32(reinterpret_cast<const uint8_t*>(&cache), offsetof(WiFiFastConnect, crc));
+}
+
+static void writeFastConnect(WiFiFastConnect &cache, bool valid) {
+	cache.crc = valid ? crc32(reinterpret_cast<const uint8_t*>(&cache), offsetof(WiFiFastConnect, crc)) : 0;
+#ifdef ESP8266
+	ESP.rtcUserMemoryWrite(WIFI_MANAGER_RTC_OFFSET, reinterpret_cast<uint32_t*>(&cache), sizeof(cache));
+#else
+	rtcFastConnect = cache;
+#endif
+}
+
+/**
+ * Connect straight to the cached AP on its channel, with the cached lease as static IP, if the cache
+ * belongs to these credentials. This skips the all-channel probe and DHCP. Returns false, and leaves
+ * the connecting to the caller, if the normal path has to be taken.
+ */
+bool AsyncWiFiManager::_beginFastConnect(const char *ssid, const char *pass, wl_status_t &status) {
+	// Over both, with the terminator of the SSID as separator
+	uint32_t key = hashBytes(pass, strlen(pass), hashBytes(ssid, strlen(ssid) + 1));
+	_attemptKey = key;
+	_fastAttempt = false;
+
+	WiFiFastConnect cache;
+	if (!_fastReconnect || !readFastConnect(cache) || cache.key != key) {
+		_useDHCP();
+		return false;
+	}
+
+	DEBUG_WM(F("Fast connect on channel"));
+	DEBUG_WM(cache.channel);
+	if (!_sta_static_ip) {
+		WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+		_fastLease = true;
+	}
+	status = WiFi.begin(ssid, *pass != 0 ? pass : NULL, cache.channel, cache.bssid);
+	_fastAttempt = true;
+	return true;
+}
+
+/** The cached AP or lease didn't get us connected in time: forget them and connect the normal way */
+void AsyncWiFiManager::_checkFastConnect(unsigned long now) {
+	if (!_fastAttempt || now - _attemptMs < WIFI_MANAGER_FAST_CONNECT_TIMEOUT) {
+		return;
+	}
+	_fastAttempt = false;
+
+	if (!_staGotIP) {
+		DEBUG_WM(F("Fast connect failed"));
+		WiFiFastConnect cache;
+		memset(&cache, 0, sizeof(cache));
+		writeFastConnect(cache, false);
+#ifdef ESP32
+		WiFi.disconnect();
+#endif
+		_connectWiFi();
+	}
+}
+
+/** Remember the AP and lease of the connection that just came up, for the next boot or wake */
+void AsyncWiFiManager::_saveFastConnect() {
+	uint8_t *bssid = WiFi.BSSID();
+	if (bssid == NULL) {
+		return;
+	}
+
+	WiFiFastConnect cache;
+	memset(&cache, 0, sizeof(cache));
+	cache.key = _attemptKey;
+	cache.ip = (uint32_t)WiFi.localIP();
+	cache.gateway = (uint32_t)WiFi.gatewayIP();
+	cache.subnet = (uint32_t)WiFi.subnetMask();
+	cache.dns = (uint32_t)WiFi.dnsIP();
+	memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+	cache.channel = WiFi.channel();
+
+	WiFiFastConnect current;
+	if (readFastConnect(current) && memcmp(&current, &cache, offsetof(WiFiFastConnect, crc)) == 0) {
+		return;		// Unchanged, spare the write
+	}
+	writeFastConnect(cache, true);
+}
+
+/** Stop using a cached lease as static IP, so that the next connection runs DHCP again */
+void AsyncWiFiManager::_useDHCP() {
+	if (!_fastLease) {
+		return;
+	}
+	_fastLease = false;
+
+	if (!_sta_static_ip) {
+		WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+	}
+}
+
+/**
+ * Order the stored networks for the next connect. Networks seen in the last scan rank by signal
+ * strength, ahead of networks that were not seen; past successes, failures and connect time adjust
+ * that. After a save the primary (just entered) network is tried first.
+ */
+void AsyncWiFiManager::_rankNetworks(bool primaryFirst) {
+	WiFiScanSnapshot scan = getScanSnapshot();
+	long scores[WIFI_MANAGER_MAX_NETWORKS];
+
+	for (int i = 0; i < _networkCount; i++) {
+		scores[i] = _scoreNetwork(_networks[i], scan);
+		_candidates[i] = i;
+	}
+	if (primaryFirst && _networkCount > 0) {
+		scores[0] = LONG_MAX;
+	}
+
+	// Insertion sort, equal scores keep the configured order
+	for (int i = 1; i < _networkCount; i++) {
+		int8_t candidate = _candidates[i];
+		int j = i;
+		while (j > 0 && scores[_candidates[j - 1]] < scores[candidate]) {
+			_candidates[j] = _candidates[j - 1];
+			j--;
+		}
+		_candidates[j] = candidate;
+	}
+
+	_candidateIdx = 0;
+}
+
+long AsyncWiFiManager::_scoreNetwork(const WiFiCredential &network, const WiFiScanSnapshot &scan) {
+	long score = 0;
+
+	if (scan) {
+		score = -1000;	// Not seen, but it may be hidden or the scan may be old
+		for (int i = 0; i < scan->count; i++) {
+			// Results are RSSI sorted, so the first match is the strongest BSSID
+			if (strcmp(scan->results[i].SSID, network.ssid.c_str()) == 0) {
+				score = 10L * (scan->results[i].RSSI + 100);
+				break;
+			}
+		}
+	}
+
+	long history = 50L * network.successes - 50L * network.failures;
+	score += history > 500 ? 500 : (history < -500 ? -500 : history);
+	score -= network.connectMs / 100;
+
+	return score;
+}
+
+/** The current attempt failed, move on to the next candidate. Starts over with a fresh ranking after the last one. */
+void AsyncWiFiManager::_nextCandidate() {
+	if (_attemptNetwork >= 0) {
+		WiFiCredential &network = _networks[_attemptNetwork];
+		if (network.failures < 255) {
+			network.failures++;
+		}
+		_attemptNetwork = -1;
+
+		if (++_candidateIdx < _networkCount) {
+			return;
+		}
+	}
+
+	_rankNetworks(false);
+}
+
+/**
+ * While starting, give each candidate an equal share of the connect timeout. A timeout too short to
+ * share, like the default 0, sets no limit per candidate: each one is tried until the driver gives up.
+ */
+void AsyncWiFiManager::_checkCandidate(unsigned long now) {
+	if (_attemptNetwork < 0 || _candidateIdx >= _networkCount - 1) {
+		return;
+	}
+
+	unsigned long share = _connectTimeout / _networkCount;
+	if (share > 0 && now - _attemptMs >= share) {
+		DEBUG_WM(F("Trying next network"));
+		_nextCandidate();
+#ifdef ESP32
+		WiFi.disconnect();
+#endif
+		_connectWiFi();
+	}
+}
+
+/** Record the outcome of an attempt once the station has an IP address */
+void AsyncWiFiManager::_checkConnected() {
+	if (!_attemptPending) {
+		return;
+	}
+
+	if (!_staGotIP) {
+		return;
+	}
+	_attemptPending = false;
+
+	DEBUG_WM(String(F("Time to IP (ms): ")) + (_gotIPMs - _attemptMs) + (_fastAttempt ? F(" fast") : F("")));
+	_fastAttempt = false;
+
+	if (_attemptNetwork >= 0) {
+		WiFiCredential &network = _networks[_attemptNetwork];
+		if (network.successes < 255) {
+			network.successes++;
+		}
+		network.failures = 0;
+		network.connectMs = _gotIPMs - _attemptMs;
+		_attemptNetwork = -1;
+	}
+
+	if (_fastReconnect) {
+		_saveFastConnect();
+	}
+}
+
 void AsyncWiFiManager::_setupConfigPortal() {
 	DEBUG_WM(F(""));
 	DEBUG_WM(F("Configuring access point... "));
@@ -204,6 +775,8 @@ void AsyncWiFiManager::_setupConfigPortal() {
 
 
 	delay(500); // Without delay I've seen the IP address blank
+	_portalUrl = String(F("http://")) + WiFi.softAPIP().toString() + '/';
+	_invalidatePages();
 	dnsStart(true);
 
 	if (!_portalSet) {
@@ -215,6 +788,19 @@ void AsyncWiFiManager::_setupConfigPortal() {
         iApHandler = &server->on("/i", [this](AsyncWebServerRequest *req){ this->handleInfo(req); }).setFilter(ON_AP_FILTER);
         rApHandler = &server->on("/r", [this](AsyncWebServerRequest *req){ this->handleReset(req); }).setFilter(ON_AP_FILTER);
         fwLinkApHandler = &server->on("/fwlink", [this](AsyncWebServerRequest *req){ this->handleRoot(req); }).setFilter(ON_AP_FILTER);
+        cssApHandler = &server->on("/wm.css", HTTP_GET, [this](AsyncWebServerRequest *req){ this->sendAsset(req, HTTP_STYLE_ASSET); }).setFilter(ON_AP_FILTER);
+        jsApHandler = &server->on("/wm.js", HTTP_GET, [this](AsyncWebServerRequest *req){ this->sendAsset(req, HTTP_SCRIPT_ASSET); }).setFilter(ON_AP_FILTER);
+        apiScanApHandler = &server->on("/api/scan", HTTP_GET, [this](AsyncWebServerRequest *req){ this->handleApiScan(req); }).setFilter(ON_AP_FILTER);
+        apiInfoApHandler = &server->on("/api/info", HTTP_GET, [this](AsyncWebServerRequest *req){ this->handleApiInfo(req); }).setFilter(ON_AP_FILTER);
+        apiStatusApHandler = &server->on("/api/status", HTTP_GET, [this](AsyncWebServerRequest *req){ this->handleApiStatus(req); }).setFilter(ON_AP_FILTER);
+        apiSaveApHandler = &server->on("/api/save", HTTP_POST, [this](AsyncWebServerRequest *req){ this->handleApiSave(req); }).setFilter(ON_AP_FILTER);
+        eventsJsApHandler = &server->on("/wme.js", HTTP_GET, [this](AsyncWebServerRequest *req){ this->sendAsset(req, HTTP_EVENTS_SCRIPT_ASSET); }).setFilter(ON_AP_FILTER);
+		if (_useEvents) {
+			_eventSource = new AsyncEventSource("/events");
+			_eventSource->setFilter(ON_AP_FILTER);
+			server->addHandler(_eventSource);
+			_invalidatePages();		// The pages link the events script while there is a source
+		}
         server->onNotFound([this](AsyncWebServerRequest *req){ this->handleNotFound(req); });
 		server->begin(); // Web server start
 	}
@@ -261,60 +847,229 @@ void AsyncWiFiManager::setConnectTimeout(unsigned long timeout) {
 	_connectTimeout = timeout;
 }
 
-void AsyncWiFiManager::connect() {
-	_connect = true;
+/**
+ * Keep the rendered root, info and wifi pages and serve them again until something on them changes:
+ * a scan, a save, a parameter, or the connection state. Costs the RAM of up to four pages while the
+ * portal is up. Off by default.
+ */
+void AsyncWiFiManager::setPageCache(bool enable) {
+	_pageCache = enable;
+	if (!enable) {
+		_invalidatePages();
+	}
 }
 
-bool AsyncWiFiManager::start() {
-	DEBUG_WM(F(""));
-
-	WiFi.setAutoReconnect(true);
-	WiFi.persistent(true);
-#ifdef ESP8266
-	WiFi.setAutoConnect(false);
-	stationConnectedHandler = WiFi.onStationModeConnected(std::bind(&AsyncWiFiManager::onConnected, this, std::placeholders::_1));
-	stationDisconnectedHandler = WiFi.onStationModeDisconnected(std::bind(&AsyncWiFiManager::onDisconnected, this, std::placeholders::_1));
-#else
-#if ESP_ARDUINO_VERSION_MAJOR >= 2
-	stationConnectedHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onConnected, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WIFI_STA_CONNECTED);
-	stationDisconnectedHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onDisconnected, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
-#else
-	stationConnectedHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onConnected, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_CONNECTED);
-	stationDisconnectedHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onDisconnected, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_DISCONNECTED);
-#endif
-#endif
-
-	WiFi.mode(WIFI_STA);
-	_isAP = false;
+/**
+ * Push scan results and connection status to the portal pages over server-sent events on /events,
+ * instead of the pages reloading themselves to poll. A finished scan is sent as the networks that
+ * were added, changed quality or disappeared since the previous one. Takes effect the next time
+ * the portal starts.
+ */
+void AsyncWiFiManager::setServerEvents(bool enable) {
+	_useEvents = enable;
+	_invalidatePages();
+}
 
-	_connect = true;
-	bool started = _start();
-	WiFi.setAutoReconnect(false);	// Otherwise connecting to our AP is almost impossible
-	_connect = false;
+/**
+ * Send pages that aren't cached with chunked transfer encoding, rendered a piece at a time as the
+ * connection takes them: the wifi page one network and one parameter at a time. A client then costs
+ * about one TCP window of heap rather than the whole page. Off by default.
+ */
+void AsyncWiFiManager::setChunkedPages(bool enable) {
+	_chunkedPages = enable;
+}
 
-	return started;
+/**
+ * Serve the connection telemetry on /metrics of the station interface, in the Prometheus text
+ * format, so that a fleet of devices can be scraped where they are deployed. Off by default. The
+ * web server is started once the station has an address, so /metrics is there even on a device
+ * that never runs the portal; starting it again where the sketch already has does nothing.
+ */
+void AsyncWiFiManager::setMetricsEndpoint(bool enable) {
+	if (enable && metricsStaHandler == NULL) {
+		metricsStaHandler = &server->on("/metrics", HTTP_GET, [this](AsyncWebServerRequest *req){ this->handleMetrics(req); }).setFilter(ON_STA_FILTER);
+		if (WiFi.isConnected()) {
+			server->begin();
+		}
+	} else if (!enable && metricsStaHandler != NULL) {
+		server->removeHandler(metricsStaHandler);
+		metricsStaHandler = NULL;
+	}
 }
 
-bool AsyncWiFiManager::_start() {
+/**
+ * Answer the captive portal DNS queries with the built-in CaptiveDNSServer instead of the DNS server
+ * passed to the constructor, which may then be NULL. It drains up to WIFI_MANAGER_DNS_BATCH queries
+ * per loop() rather than one, and doesn't allocate per query. Takes effect the next time the portal
+ * starts.
+ */
+void AsyncWiFiManager::setCaptiveDNS(bool enable) {
+	_useCaptiveDNS = enable;
+}
+
+/**
+ * Remember the AP, channel and DHCP lease of the last good connection in RTC memory, and on the next
+ * boot or wake from deep sleep connect straight to that AP with that lease as static IP. If that gets
+ * no connection within WIFI_MANAGER_FAST_CONNECT_TIMEOUT the cache is dropped and the normal scan and
+ * DHCP follow. Off by default: the lease is reused without asking the DHCP server again.
+ */
+void AsyncWiFiManager::setFastReconnect(bool enable) {
+	_fastReconnect = enable;
+	if (!enable) {
+		_useDHCP();
+	}
+}
+
+/**
+ * Reconnect retries start at initialMs and double after every failed attempt, up to maxMs. Each delay
+ * is then spread by up to +/- jitterPercent so that devices losing the same router don't retry in
+ * lock-step. A successful connection resets the delay. The default is a fixed 10s without jitter.
+ */
+void AsyncWiFiManager::setConnectRetryBackoff(unsigned long initialMs, unsigned long maxMs, uint8_t jitterPercent) {
+	_retryInitial = initialMs;
+	_retryMax = maxMs < initialMs ? initialMs : maxMs;
+	_retryJitter = jitterPercent > 100 ? 100 : jitterPercent;
+	_retryAttempts = 0;
+}
+
+/** Delay before the next reconnect attempt */
+unsigned long AsyncWiFiManager::_nextRetryDelay() {
+	unsigned long delayMs = _retryInitial;
+	for (uint8_t i = 0; i < _retryAttempts && delayMs < _retryMax; i++) {
+		delayMs <<= 1;
+	}
+	if (delayMs > _retryMax) {
+		delayMs = _retryMax;
+	}
+	if (_retryAttempts < 255) {
+		_retryAttempts++;
+	}
+
+	unsigned long spread = delayMs / 100 * _retryJitter;
+	if (spread > 0) {
+		delayMs = delayMs - spread + random(2 * spread + 1);
+	}
+
+	return delayMs > 0 ? delayMs : 1;	// 0 means no retry pending
+}
+
+void AsyncWiFiManager::connect() {
+	_request(REQUEST_CONNECT);
+}
+
+bool AsyncWiFiManager::start() {
+	DEBUG_WM(F(""));
+
+	_beginStart();
+
+	_connect = true;
+	bool started = _start();
+	WiFi.setAutoReconnect(false);	// Otherwise connecting to our AP is almost impossible
+	_connect = false;
+	_sendStatusEvent();
+
+	return started;
+}
+
+/**
+ * Same as start() but returns immediately. loop() finishes the start once the connection is up or
+ * _connectTimeout has passed, then reports the outcome through getStartState() and the start callback.
+ */
+void AsyncWiFiManager::startAsync() {
+	DEBUG_WM(F(""));
+
+	_beginStart();
+
+	_connect = true;
+	_startConnect();
+}
+
+AsyncWiFiManager::StartState AsyncWiFiManager::getStartState() {
+	return _startState;
+}
+
+void AsyncWiFiManager::_beginStart() {
+	WiFi.setAutoReconnect(true);
+	WiFi.persistent(true);
+#ifdef ESP8266
+	WiFi.setAutoConnect(false);
+	stationConnectedHandler = WiFi.onStationModeConnected(std::bind(&AsyncWiFiManager::onConnected, this, std::placeholders::_1));
+	stationDisconnectedHandler = WiFi.onStationModeDisconnected(std::bind(&AsyncWiFiManager::onDisconnected, this, std::placeholders::_1));
+#else
+#if ESP_ARDUINO_VERSION_MAJOR >= 2
+	stationConnectedHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onConnected, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WIFI_STA_CONNECTED);
+	stationDisconnectedHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onDisconnected, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+#else
+	stationConnectedHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onConnected, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_CONNECTED);
+	stationDisconnectedHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onDisconnected, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_DISCONNECTED);
+#endif
+#endif
+	_registerGotIP();
+
+	WiFi.mode(WIFI_STA);
+	_isAP = false;
+}
+
+void AsyncWiFiManager::_registerGotIP() {
+	if (_gotIPRegistered) {
+		return;
+	}
+	_gotIPRegistered = true;
+
+#ifdef ESP8266
+	stationGotIPHandler = WiFi.onStationModeGotIP(std::bind(&AsyncWiFiManager::onStationIP, this, std::placeholders::_1));
+#else
+#if ESP_ARDUINO_VERSION_MAJOR >= 2
+	stationGotIPHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onStationIP, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WIFI_STA_GOT_IP);
+#else
+	stationGotIPHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onStationIP, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_GOT_IP);
+#endif
+#endif
+}
+
+bool AsyncWiFiManager::_start() {
+	_startConnect();
+
+	while (!WiFi.isConnected() && (millis() - _startMs < _connectTimeout)) {
+		_processEvents();
+		_checkFastConnect(millis());
+		_checkCandidate(millis());
+		delay(10);
+	}
+	_processEvents();
+	_checkConnected();
+
+	return _startFinish();
+}
+
+/** First half of a start: kick off the connection attempt */
+void AsyncWiFiManager::_startConnect() {
 	if (_sta_static_ip) {
 		DEBUG_WM(F("Custom STA IP/GW/Subnet/DNS"));
 		WiFi.config(_sta_static_ip, _sta_static_gw, _sta_static_sn, _sta_static_dns1, _sta_static_dns2);
 		DEBUG_WM(WiFi.localIP());
 	}
 
+	_staGotIP = false;
+
 	// attempt to connect; should it fail, fall back to AP
 	if (_connect) {
+		_attemptNetwork = -1;
+		_rankNetworks(_startSave);
 		_connectWiFi();
 	}
 
-	unsigned long startMs = millis();
+	_startMs = millis();
+	_startState = START_CONNECTING;
+}
 
-	while (!WiFi.isConnected() && (millis() - startMs < _connectTimeout)) {
-		delay(10);
-	}
+/** Second half of a start, once connected or timed out: fall back to the portal if needed */
+bool AsyncWiFiManager::_startFinish() {
+	_invalidatePages();		// The info page stops showing the attempt
 
 	if (WiFi.isConnected()) {
 		DEBUG_WM(F("returning"));
+		_startState = START_CONNECTED;
 		return true;
 	}
 
@@ -328,27 +1083,63 @@ bool AsyncWiFiManager::_start() {
 #ifdef ESP8266
 	DEBUG_WM(WiFi.SSID());
 	// If we don't do this, the persisted credentials get cleared
-	_router_ssid = WiFi.SSID();
-	_router_pass = WiFi.psk();
+	if (_networkCount == 0 && WiFi.SSID().length() > 0) {
+		setRouterCredentials(WiFi.SSID().c_str(), WiFi.psk().c_str());
+	}
 #endif
 	_startConfigPortal();
 	DEBUG_WM(WiFi.SSID());
 
-	_claim();
 	_lastConnectTime = millis();
-	_connectRetryTimeout = 10000;	// ms
-	_release();
+	_connectRetryTimeout = _nextRetryDelay();
 
 	// Have to do this if we want any automatic connection retries to happen
-	return WiFi.isConnected();
+	bool connected = WiFi.isConnected();
+	_startState = connected ? START_CONNECTED : START_PORTAL;
+	return connected;
+}
+
+/** Called from loop() while an asynchronous start or a portal connect is pending */
+void AsyncWiFiManager::_pollStart(unsigned long now) {
+	if (!_staGotIP && now - _startMs < _connectTimeout) {
+		_checkCandidate(now);
+		return;
+	}
+
+	bool connected = _startFinish();
+	WiFi.setAutoReconnect(false);	// Otherwise connecting to our AP is almost impossible
+	_connect = false;
+	_sendStatusEvent();
+
+	if (_startcallback != NULL) {
+		_startcallback(connected);
+	}
+
+	if (_startSave) {
+		_startSave = false;
+		if ( _savecallback != NULL) {
+		  //todo: check if any custom parameters actually exist, and check if they really changed maybe
+		  _savecallback();
+		}
+	}
+
+	// A save during the attempt: connect again with it, and call the save callback after that attempt
+	if (_connectAgain) {
+		_connectAgain = false;
+		_request(REQUEST_CONNECT);
+	}
 }
 
+/** Guards what web handlers share with loop() from the async TCP task: the scan snapshot, the telemetry and the pending save */
 void AsyncWiFiManager::_claim() {
 #ifdef ESP8266
 	noInterrupts();
 #else
+	WM_STATS_START(waitStart);
 	xSemaphoreTake(loopMutex, portMAX_DELAY);
+	WM_STATS_ADD(claimWaitMicros, micros() - waitStart);
 #endif
+	WM_STATS_ADD(claims, 1);
 }
 
 void AsyncWiFiManager::_release() {
@@ -361,233 +1152,704 @@ void AsyncWiFiManager::_release() {
 
 void AsyncWiFiManager::dumpInfo() {
 	Serial.printf("WM lastConnectTime=%lu, lastLoopTime=%lu, WiFi status=%d\n", _lastConnectTime, _lastLoopTime, WiFi.status());
+#ifdef WIFI_MANAGER_STATS
+	AsyncWiFiManagerStats stats = getStats();
+	Serial.printf("WM loops=%lu, loopMax=%luus, loopMean=%luus, scan=%luus, claimWait=%luus, dnsPolls=%lu\n",
+			(unsigned long)stats.loops, (unsigned long)stats.loopMaxMicros,
+			(unsigned long)(stats.loops > 0 ? stats.loopMicros / stats.loops : 0), (unsigned long)stats.scanMicros,
+			(unsigned long)stats.claimWaitMicros, (unsigned long)stats.dnsPolls);
+#endif
+}
+
+#ifdef WIFI_MANAGER_STATS
+static const char *const routeNames[AsyncWiFiManagerStats::ROUTE_COUNT] = {
+	"root", "wifi", "wifisave", "info", "reset", "asset",
+	"apiScan", "apiInfo", "apiStatus", "apiSave", "metrics", "redirect", "probe", "notFound"
+};
+
+/**
+ * Copy of the counters. Handlers update them from the async TCP task, so a copy taken while a
+ * request is being served may be off by that request.
+ */
+AsyncWiFiManagerStats AsyncWiFiManager::getStats() {
+	return _stats;
+}
+
+void AsyncWiFiManager::_countLoop(unsigned long start) {
+	uint32_t elapsed = micros() - start;
+
+	_stats.loops++;
+	_stats.loopMicros += elapsed;
+	if (elapsed > _stats.loopMaxMicros) {
+		_stats.loopMaxMicros = elapsed;
+	}
 }
 
+void AsyncWiFiManager::_countRoute(AsyncWiFiManagerStats::Route route, unsigned long start, size_t bytes) {
+	uint32_t elapsed = micros() - start;
+	AsyncWiFiManagerStats::RouteStats &stats = _stats.routes[route];
+
+	stats.requests++;
+	stats.micros += elapsed;
+	if (elapsed > stats.maxMicros) {
+		stats.maxMicros = elapsed;
+	}
+	stats.bytes += bytes;
+}
+
+/** Counters on the info page: one line per route that has been requested */
+void AsyncWiFiManager::sendStats(Print *out) {
+	AsyncWiFiManagerStats stats = getStats();
+
+	out->printf("<dt>Loop</dt><dd>%lu calls, max %lu us, mean %lu us</dd>",
+			(unsigned long)stats.loops, (unsigned long)stats.loopMaxMicros,
+			(unsigned long)(stats.loops > 0 ? stats.loopMicros / stats.loops : 0));
+	out->printf("<dt>Scans</dt><dd>%lu, %lu us</dd>", (unsigned long)stats.scans, (unsigned long)stats.scanMicros);
+	out->printf("<dt>Lock</dt><dd>%lu claims, %lu us waiting</dd>", (unsigned long)stats.claims, (unsigned long)stats.claimWaitMicros);
+	out->printf("<dt>DNS</dt><dd>%lu polls, %lu us, %lu queries</dd>", (unsigned long)stats.dnsPolls,
+			(unsigned long)stats.dnsMicros, (unsigned long)stats.dnsRequests);
+	for (int i = 0; i < AsyncWiFiManagerStats::ROUTE_COUNT; i++) {
+		const AsyncWiFiManagerStats::RouteStats &route = stats.routes[i];
+		if (route.requests == 0) {
+			continue;
+		}
+		out->printf("<dt>Route %s</dt><dd>%lu requests, %lu us mean, %lu us max, %lu bytes</dd>", routeNames[i],
+				(unsigned long)route.requests, (unsigned long)(route.micros / route.requests),
+				(unsigned long)route.maxMicros, (unsigned long)route.bytes);
+	}
+}
+#endif
+
 void AsyncWiFiManager::loop() {
+	WM_STATS_START(loopStart);
 	unsigned long now = millis();
 
 	_lastLoopTime = now;
 
-#ifndef USE_EADNS
 	if (isAP()) {
-		dnsServer->processNextRequest();
-	}
+		WM_STATS_START(dnsStart);
+		if (_captiveDNS != NULL) {
+#ifdef WIFI_MANAGER_STATS
+			_stats.dnsRequests += _captiveDNS->processRequests(WIFI_MANAGER_DNS_BATCH);
+#else
+			_captiveDNS->processRequests(WIFI_MANAGER_DNS_BATCH);
+#endif
+		}
+#ifndef USE_EADNS
+		else {
+			dnsServer->processNextRequest();
+		}
 #endif
+		WM_STATS_ADD(dnsPolls, 1);
+		WM_STATS_ADD(dnsMicros, micros() - dnsStart);
+	}
 
-	if (_connect) {
+	// The only synchronization on the way: one atomic load, which is all there is when idle
+	if (_requests.load(std::memory_order_acquire) != 0) {
+		_processRequests(now);
+	}
+
+	_checkConnected();
+	_checkFastConnect(now);
+
+	if (_associated && now - _rssiSampleMs >= 1000) {
+		_rssiSampleMs = now;
+		_lastRSSI = WiFi.RSSI();
+	}
+
+	if (_startState == START_CONNECTING) {
+		_pollStart(now);
+	} else if (_connect) {
 		DEBUG_WM(F("Connecting to new AP"));
-		unsigned long savedTimeout = _connectTimeout;
 #ifdef ESP32
 		WiFi.disconnect();
 #endif
-		_start();
-		_connect = false;
-		if ( _savecallback != NULL) {
-		  //todo: check if any custom parameters actually exist, and check if they really changed maybe
-		  _savecallback();
-		}
+		_startSave = true;
+		_startConnect();
 	}
 
-	_claim();
-	if (_connectRetryTimeout > 0 || _loop_ap_state >= 0 || _loop_scan || _loop_call_connected) {
-		if (_connectRetryTimeout > 0) {
-			if (now - _lastConnectTime > _connectRetryTimeout) {
-				DEBUG_WM(_connectRetryTimeout);
-				_lastConnectTime = now;
-				_release();
+	if (_wpsRunning && now - _wpsStartMs > _wpsTimeout) {
+		DEBUG_WM(F("WPS timed out"));
+		_finishWPS(false);
+	}
+
+	// Connecting would abort the scan, the pending start or WPS
+	if (_connectRetryTimeout > 0 && !_scanRunning && !_wpsRunning && _startState != START_CONNECTING
+			&& now - _lastConnectTime > _connectRetryTimeout) {
+		DEBUG_WM(_connectRetryTimeout);
+		_lastConnectTime = now;
+		_connectRetryTimeout = _nextRetryDelay();
 #ifdef ESP32
-				WiFi.disconnect();
+		WiFi.disconnect();
 #endif
-				_connectWiFi();
-			} else {
-				_release();
-			}
-		} else {
-			_release();
-		}
+		_nextCandidate();
+		_connectWiFi();
+	}
 
-		_claim();
-		if (_loop_ap_state >= 0) {
-			if (_loop_ap_state > 0 && millis() - _apOffTimeout > _loop_ap_state) {
-				_loop_ap_state = -1;
-				_release();
-				_stopConfigPortal();
-			} else if (_loop_ap_state == 0) {
-				_loop_ap_state = -1;
-				_release();
-				_startConfigPortal();
-			} else {
-				_release();
-			}
-		} else {
-			_release();
-		}
+	if (_loop_ap_state > 0 && millis() - _apOffTimeout > (unsigned long)_loop_ap_state) {
+		_loop_ap_state = -1;
+		_stopConfigPortal();
+	} else if (_loop_ap_state == 0) {
+		_loop_ap_state = -1;
+		_startConfigPortal();
+	}
 
-		_claim();
-		if (_loop_call_connected) {
-			_loop_call_connected = false;
-			_release();
-			stopConfigPortal(30000);
+	if (_loop_call_connected) {
+		_loop_call_connected = false;
+		_apOffTimeout = now;
+		_loop_ap_state = 30000;		// Leave the portal up a little longer for the final page
+		if (_connectedcallback != NULL) {
 			(*_connectedcallback)();
-		} else {
-			_release();
 		}
+	}
 
-		_claim();
-		if (_loop_scan) {
-			_release();
-			_scanNetworks();
-			_loop_scan = false;
-		} else {
-			_release();
-		}
-	} else {
-		_release();
+	if (_scanRunning) {
+		_collectScan();
 	}
+
+#ifdef WIFI_MANAGER_STATS
+	_countLoop(loopStart);
+#endif
 }
 
-void AsyncWiFiManager::sendNetworkList(AsyncResponseStream *response) {
-	String pager;
-	//display networks in page
-	for (int i = 0; i < wifiSSIDCount; i++) {
-		if (wifiSSIDs[i].duplicate == true) {
-			continue; // skip dups
-		}
+/** Called from the WiFi callbacks, never blocks */
+void AsyncWiFiManager::_post(WiFiManagerEvent::Type type, uint8_t reason) {
+	WiFiManagerEvent event;
+	event.type = type;
+	event.reason = reason;
+	event.ms = millis();
 
-		int quality = getRSSIasQuality(wifiSSIDs[i].RSSI);
+	if (_events.push(event)) {
+		_request(REQUEST_EVENTS);
+	} else {
+		DEBUG_WM(F("Event queue full, dropped event"));
+	}
+}
 
-		if (_minimumQuality == -1 || _minimumQuality < quality) {
-			char locked = ' ';
-#if defined(ESP8266)
-			if (wifiSSIDs[i].encryptionType != ENC_TYPE_NONE) {
+/** Hand work to loop(). Safe from any task. */
+void AsyncWiFiManager::_request(uint8_t request) {
+#ifdef ESP8266
+	// Callbacks don't preempt loop() or each other on ESP8266, and the core lacks atomic read-modify-write
+	_requests.store(_requests.load(std::memory_order_relaxed) | request, std::memory_order_release);
 #else
-            if (wifiSSIDs[i].encryptionType != WIFI_AUTH_OPEN) {
+	_requests.fetch_or(request, std::memory_order_release);
 #endif
-				locked = 'l';
-			}
-			response->printf(HTTP_ITEM, wifiSSIDs[i].SSID.c_str(), locked, quality);
+}
+
+uint8_t AsyncWiFiManager::_takeRequests() {
+#ifdef ESP8266
+	uint8_t requests = _requests.load(std::memory_order_acquire);
+	_requests.store(0, std::memory_order_relaxed);
+	return requests;
+#else
+	return _requests.exchange(0, std::memory_order_acq_rel);
+#endif
+}
+
+void AsyncWiFiManager::_processRequests(unsigned long now) {
+	uint8_t requests = _takeRequests();
+
+	if (requests & REQUEST_EVENTS) {
+		_processEvents();
+	}
+
+	if (requests & REQUEST_CONNECT) {
+		if (_startState == START_CONNECTING) {
+			_connectAgain = true;	// Finishing the start clears _connect, it is posted again then
 		} else {
-			DEBUG_WM(F("Skipping due to quality"));
+			_applySave();
+			_connect = true;
+			_sendStatusEvent();
 		}
 	}
 
-	if (wifiSSIDCount == 0) {
-		response->print(F("No networks found"));
+	if (requests & REQUEST_AP) {
+		_apOffTimeout = now;
+		_loop_ap_state = _apRequest.load(std::memory_order_relaxed);
 	}
-}
 
-void AsyncWiFiManager::copySSIDInfo(wifi_ssid_count_t n) {
-	if (n == WIFI_SCAN_FAILED) {
-		DEBUG_WM(F("scanNetworks returned: WIFI_SCAN_FAILED!"));
-	} else if (n == WIFI_SCAN_RUNNING) {
-		DEBUG_WM(F("scanNetworks returned: WIFI_SCAN_RUNNING!"));
-	} else if (n < 0) {
-		DEBUG_WM(F("scanNetworks failed with unknown error code!"));
-	} else if (n == 0) {
-		DEBUG_WM(F("No networks found"));
-		// page += F("No networks found. Refresh to scan again.");
-	} else {
-		DEBUG_WM(String("Found ") + n + " SSIDs");
+	if (requests & REQUEST_SCAN) {
+		_scanNetworks();
 	}
+}
 
-	if (n > 0) {
-		/* WE SHOULD MOVE THIS IN PLACE ATOMICALLY */
-		if (wifiSSIDs) {
-			delete[] wifiSSIDs;
-		}
+void AsyncWiFiManager::_processEvents() {
+	WiFiManagerEvent event;
+	while (_events.pop(event)) {
+		_processEvent(event);
+	}
+}
 
-		wifiSSIDs = new WiFiResult[n];
-		wifiSSIDCount = n;
+void AsyncWiFiManager::_processEvent(const WiFiManagerEvent &event) {
+	_invalidatePages();		// Station status and IP are on the info page
+	_recordEvent(event);
 
-		for (wifi_ssid_count_t i = 0; i < n; i++) {
-			wifiSSIDs[i].duplicate = false;
+	switch (event.type) {
+	case WiFiManagerEvent::STA_CONNECTED:
+		_connectRetryTimeout = 0;
+		_retryAttempts = 0;
+		break;
 
-#if defined(ESP8266)
-			bool res = WiFi.getNetworkInfo(i, wifiSSIDs[i].SSID, wifiSSIDs[i].encryptionType, wifiSSIDs[i].RSSI, wifiSSIDs[i].BSSID, wifiSSIDs[i].channel, wifiSSIDs[i].isHidden);
-#else
-            bool res = WiFi.getNetworkInfo(i, wifiSSIDs[i].SSID, wifiSSIDs[i].encryptionType, wifiSSIDs[i].RSSI, wifiSSIDs[i].BSSID, wifiSSIDs[i].channel);
-#endif
+	case WiFiManagerEvent::STA_DISCONNECTED:
+		_staGotIP = false;
+		_lastConnectTime = event.ms;
+		if (_connectRetryTimeout == 0) {
+			_connectRetryTimeout = _nextRetryDelay();	// Just lost the connection, otherwise loop() is already retrying
 		}
+		break;
+
+	case WiFiManagerEvent::WPS_DONE:
+		_finishWPS(event.reason == 0);
+		break;
+
+	case WiFiManagerEvent::STA_GOT_IP:
+		_staGotIP = true;
+		_gotIPMs = event.ms;
+		_loop_call_connected = _connectedcallback != NULL;	// Not from here, start() drains events too
+		if (metricsStaHandler != NULL) {
+			server->begin();	// See setMetricsEndpoint()
+		}
+		break;
+	}
 
-		// RSSI SORT
+	_sendStatusEvent();
+}
 
-		// old sort
-		for (int i = 0; i < n; i++) {
-			for (int j = i + 1; j < n; j++) {
-				if (wifiSSIDs[j].RSSI > wifiSSIDs[i].RSSI) {
-					std::swap(wifiSSIDs[i], wifiSSIDs[j]);
-				}
-			}
+/** Time the phases of the pending attempt and log disconnects, before the event changes any state */
+void AsyncWiFiManager::_recordEvent(const WiFiManagerEvent &event) {
+	_claim();
+	switch (event.type) {
+	case WiFiManagerEvent::STA_CONNECTED:
+		if (_attemptPending && !_associated) {
+			_telemetry.associate.add(event.ms - _attemptMs);
 		}
-
-		// remove duplicates ( must be RSSI sorted )
-		if (_removeDuplicateAPs) {
-			String cssid;
-			for (int i = 0; i < n; i++) {
-				if (wifiSSIDs[i].duplicate == true)
-					continue;
-				cssid = wifiSSIDs[i].SSID;
-				for (int j = i + 1; j < n; j++) {
-					if (cssid == wifiSSIDs[j].SSID) {
-						DEBUG_WM("DUP AP: " + wifiSSIDs[j].SSID);
-						wifiSSIDs[j].duplicate = true; // set dup aps to NULL
-					}
-				}
+		_associated = true;
+		_associatedMs = event.ms;
+		break;
+
+	case WiFiManagerEvent::STA_DISCONNECTED:
+		_telemetry.addDisconnect(event.ms, event.reason, _associated ? _lastRSSI : 0);
+		_associated = false;
+		_lastRSSI = 0;
+		break;
+
+	case WiFiManagerEvent::STA_GOT_IP:
+		if (_attemptPending && !_staGotIP) {
+			if (_associated) {
+				_telemetry.dhcp.add(event.ms - _associatedMs);
 			}
+			_telemetry.total.add(event.ms - _attemptMs);
 		}
+		break;
 
-		WiFi.scanDelete();
+	default:
+		break;
 	}
+	_release();
 }
 
-void AsyncWiFiManager::startConfigPortal() {
-	_claim();
-	_loop_ap_state = 0;
-	_release();
+bool WiFiManagerEventQueue::push(const WiFiManagerEvent &event) {
+	uint8_t head = _head.load(std::memory_order_relaxed);
+	if ((uint8_t)(head - _tail.load(std::memory_order_acquire)) == WIFI_MANAGER_EVENT_QUEUE) {
+		return false;
+	}
+
+	_events[head & (WIFI_MANAGER_EVENT_QUEUE - 1)] = event;
+	_head.store(head + 1, std::memory_order_release);	// Publishes the slot
+	return true;
 }
 
-void AsyncWiFiManager::startConfigPortal(const char *ssid, const char *pass) {
-	_claim();
-	setAPCredentials(ssid, pass);
-	_loop_ap_state = 0;
-	_release();
+bool WiFiManagerEventQueue::pop(WiFiManagerEvent &event) {
+	uint8_t tail = _tail.load(std::memory_order_relaxed);
+	if (tail == _head.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	event = _events[tail & (WIFI_MANAGER_EVENT_QUEUE - 1)];
+	_tail.store(tail + 1, std::memory_order_release);	// Hands the slot back
+	return true;
 }
 
-void AsyncWiFiManager::stopConfigPortal(int timeoutMs) {
-	_claim();
-	_apOffTimeout = millis();
-	_loop_ap_state = timeoutMs;	// Turn off after timeoutMs milliseconds
-	_release();
+static const uint16_t histogramBounds[WIFI_MANAGER_HISTOGRAM_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2000, 4000, 8000, 16000
+};
+
+void WiFiManagerHistogram::add(unsigned long ms) {
+	int bucket = 0;
+	while (bucket < WIFI_MANAGER_HISTOGRAM_BUCKETS - 1 && ms > histogramBounds[bucket]) {
+		bucket++;
+	}
+	counts[bucket]++;
+	count++;
+	sumMs += ms;
 }
 
-void AsyncWiFiManager::_scanNetworks() {
-	wifi_ssid_count_t n = WiFi.scanNetworks(false);
-	copySSIDInfo(n);
+unsigned long WiFiManagerHistogram::bound(int bucket) {
+	return bucket < WIFI_MANAGER_HISTOGRAM_BUCKETS - 1 ? histogramBounds[bucket] : 0;
 }
 
-bool AsyncWiFiManager::_startConfigPortal() {
-	if (!_isAP) {
-		DEBUG_WM(F("Enable AP"));
-		// Do one modal scan
-		bool connectAgain = false;
+void WiFiManagerTelemetry::addDisconnect(unsigned long ms, uint8_t reason, int8_t rssi) {
+	WiFiManagerDisconnect &entry = disconnects[disconnectCount % WIFI_MANAGER_DISCONNECT_LOG];
+	entry.ms = ms;
+	entry.reason = reason;
+	entry.rssi = rssi;
+	disconnectCount++;
+}
 
-#ifdef ESP8266
-		// For ESP8266, need to save the current SSID and password
-//		_router_ssid = WiFi.SSID();
-//		_router_pass = WiFi.psk();
-#else
-		wl_status_t status = WiFi.status();
-		if (status != WL_CONNECTED) {
-			WiFi.disconnect();	// ESP32, can't scan while trying to connect to an AP.
+const WiFiManagerDisconnect* WiFiManagerTelemetry::disconnect(int age) const {
+	if (age < 0 || age >= WIFI_MANAGER_DISCONNECT_LOG || (uint32_t)age >= disconnectCount) {
+		return NULL;
+	}
+	return &disconnects[(disconnectCount - 1 - age) % WIFI_MANAGER_DISCONNECT_LOG];
+}
+
+/** Format a BSSID as AA:BB:CC:DD:EE:FF into a buffer of at least 18 characters */
+static void formatBSSID(const uint8_t *bssid, char *buf) {
+	snprintf(buf, 18, "%02X:%02X:%02X:%02X:%02X:%02X", bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
+}
+
+static bool isSecure(const WiFiResult &result) {
+#if defined(ESP8266)
+	return result.encryptionType != ENC_TYPE_NONE;
+#else
+	return result.encryptionType != WIFI_AUTH_OPEN;
+#endif
+}
+
+/** True if the network is shown in the list: not a duplicate SSID and above the minimum quality */
+bool AsyncWiFiManager::isListed(const WiFiResult &result) {
+	if (result.duplicate == true) {
+		return false;
+	}
+	return _minimumQuality == -1 || _minimumQuality < getRSSIasQuality(result.RSSI);
+}
+
+/** One entry of the network list, the id lets the events script update the list in place */
+void AsyncWiFiManager::sendNetworkItem(Print *out, const WiFiResult &result) {
+	if (!isListed(result)) {
+		DEBUG_WM(F("Skipping duplicate or due to quality"));
+		return;
+	}
+
+	char qualityStr[4];
+	snprintf(qualityStr, sizeof(qualityStr), "%d", getRSSIasQuality(result.RSSI));
+	char bssid[18];
+	formatBSSID(result.BSSID, bssid);
+	const char *values[] = { result.SSID, isSecure(result) ? "l" : "", qualityStr, bssid };
+	sendTemplate(out, HTTP_ITEM, "vlqb", values);
+}
+
+/**
+ * Send the difference between two scans to the portal pages: networks that appeared, networks whose
+ * quality changed, and the BSSIDs of networks that are no longer listed. Both scans are at most
+ * WIFI_MANAGER_MAX_SCAN_RESULTS long, so the quadratic matching is cheap next to the scan itself.
+ */
+void AsyncWiFiManager::_sendScanEvent(const WiFiScanSnapshot &previous, const WiFiScanSnapshot &current) {
+	if (_eventSource == NULL || _eventSource->count() == 0) {
+		return;
+	}
+
+	wifi_ssid_count_t previousCount = previous ? previous->count : 0;
+	wifi_ssid_count_t currentCount = current ? current->count : 0;
+
+	StreamString data;
+	AsyncWiFiManagerJsonWriter json(&data);
+	char bssid[18];
+
+	json.beginObject();
+	json.beginArray("added");
+	for (int i = 0; i < currentCount; i++) {
+		const WiFiResult &result = current->results[i];
+		if (!isListed(result)) {
+			continue;
+		}
+		bool found = false;
+		for (int j = 0; j < previousCount && !found; j++) {
+			found = isListed(previous->results[j]) && memcmp(previous->results[j].BSSID, result.BSSID, sizeof(result.BSSID)) == 0;
+		}
+		if (!found) {
+			formatBSSID(result.BSSID, bssid);
+			json.beginObject();
+			json.add("b", bssid);
+			json.add("s", result.SSID);
+			json.add("q", (long)getRSSIasQuality(result.RSSI));
+			json.add("l", isSecure(result));
+			json.endObject();
+		}
+	}
+	json.endArray();
+
+	json.beginArray("changed");
+	for (int i = 0; i < currentCount; i++) {
+		const WiFiResult &result = current->results[i];
+		if (!isListed(result)) {
+			continue;
+		}
+		for (int j = 0; j < previousCount; j++) {
+			const WiFiResult &old = previous->results[j];
+			if (isListed(old) && memcmp(old.BSSID, result.BSSID, sizeof(result.BSSID)) == 0) {
+				int quality = getRSSIasQuality(result.RSSI);
+				if (quality != getRSSIasQuality(old.RSSI)) {
+					formatBSSID(result.BSSID, bssid);
+					json.beginObject();
+					json.add("b", bssid);
+					json.add("q", (long)quality);
+					json.endObject();
+				}
+				break;
+			}
+		}
+	}
+	json.endArray();
+
+	json.beginArray("removed");
+	for (int j = 0; j < previousCount; j++) {
+		const WiFiResult &old = previous->results[j];
+		if (!isListed(old)) {
+			continue;
+		}
+		bool found = false;
+		for (int i = 0; i < currentCount && !found; i++) {
+			found = isListed(current->results[i]) && memcmp(current->results[i].BSSID, old.BSSID, sizeof(old.BSSID)) == 0;
 		}
+		if (!found) {
+			formatBSSID(old.BSSID, bssid);
+			json.add(NULL, bssid);
+		}
+	}
+	json.endArray();
+	json.endObject();
+
+	_eventSource->send(data.c_str(), "scan");
+}
+
+/**
+ * Copy the completed scan into a free pool buffer and publish it. Returns false, leaving the results
+ * with the driver, if every other buffer is still held by a reader; loop() will try again.
+ */
+bool AsyncWiFiManager::copySSIDInfo(wifi_ssid_count_t n) {
+	if (n == WIFI_SCAN_FAILED) {
+		DEBUG_WM(F("scanNetworks returned: WIFI_SCAN_FAILED!"));
+	} else if (n == WIFI_SCAN_RUNNING) {
+		DEBUG_WM(F("scanNetworks returned: WIFI_SCAN_RUNNING!"));
+	} else if (n < 0) {
+		DEBUG_WM(F("scanNetworks failed with unknown error code!"));
+	} else if (n == 0) {
+		DEBUG_WM(F("No networks found"));
+		// page += F("No networks found. Refresh to scan again.");
+	} else {
+		DEBUG_WM(F("SSIDs found:"));
+		DEBUG_WM(n);
+	}
+
+	if (n > 0) {
+		// Fill a back buffer; readers keep whatever snapshot they already hold
+		WiFiScanResults *scan = getScanBackBuffer();
+		if (scan == NULL) {
+			return false;
+		}
+
+		// RSSI SORT - keep the strongest results in order, in the buffer itself. Equal signals keep
+		// driver order. Duplicates are removed on the way in, so the strongest BSSID of each SSID stays
+		// and a crowd of one SSID's BSSIDs can't push other networks out of the buffer.
+		uint32_t hashes[WIFI_MANAGER_MAX_SCAN_RESULTS];		// SSID hash of each kept result
+		String ssid;	// Reused for every entry, so its buffer is only allocated once
+		uint8_t encryptionType;
+		int32_t rssiValue;
+		uint8_t *bssid;
+		int32_t channel;
+		bool isHidden = false;
+		wifi_ssid_count_t kept = 0;
+		for (wifi_ssid_count_t i = 0; i < n; i++) {
+			int8_t rssi = WiFi.RSSI(i);
+			if (kept == WIFI_MANAGER_MAX_SCAN_RESULTS && rssi <= scan->results[kept - 1].RSSI) {
+				continue;
+			}
+
+#if defined(ESP8266)
+			WiFi.getNetworkInfo(i, ssid, encryptionType, rssiValue, bssid, channel, isHidden);
+#else
+            WiFi.getNetworkInfo(i, ssid, encryptionType, rssiValue, bssid, channel);
 #endif
+			uint32_t hash = hashBytes(ssid.c_str(), ssid.length());
+
+			// A new entry goes in at the end, or over the weakest when full. A stronger duplicate
+			// takes the place of the one it replaces.
+			wifi_ssid_count_t slot = kept;
+			if (_removeDuplicateAPs) {
+				for (wifi_ssid_count_t j = 0; j < kept; j++) {
+					if (hashes[j] == hash && strcmp(scan->results[j].SSID, ssid.c_str()) == 0) {
+						slot = j;
+						break;
+					}
+				}
+				if (slot < kept) {
+					DEBUG_WM(F("DUP AP:"));
+					DEBUG_WM(ssid.c_str());
+					if (rssi <= scan->results[slot].RSSI) {
+						continue;
+					}
+				}
+			}
+			if (slot == kept) {
+				if (kept < WIFI_MANAGER_MAX_SCAN_RESULTS) {
+					kept++;
+				} else {
+					slot--;
+				}
+			}
 
-		_scanNetworks();
+			for (; slot > 0 && scan->results[slot - 1].RSSI < rssi; slot--) {
+				scan->results[slot] = scan->results[slot - 1];
+				hashes[slot] = hashes[slot - 1];
+			}
+
+			WiFiResult &result = scan->results[slot];
+			strncpy(result.SSID, ssid.c_str(), sizeof(result.SSID) - 1);
+			result.SSID[sizeof(result.SSID) - 1] = 0;
+			memcpy(result.BSSID, bssid, sizeof(result.BSSID));
+			result.RSSI = rssi;
+			result.channel = channel;
+			result.encryptionType = encryptionType;
+			result.duplicate = false;
+			result.isHidden = isHidden;
+			hashes[slot] = hash;
+		}
+		scan->count = kept;
+
+		// Publish with a single pointer swap
+		for (int i = 0; i < WIFI_MANAGER_SCAN_BUFFERS; i++) {
+			if (_scanBuffers[i].get() == scan) {
+				WiFiScanSnapshot published(_scanBuffers[i]);
+				_claim();
+				wifiSSIDs.swap(published);
+				_release();
+			}
+		}
+
+		WiFi.scanDelete();
+	}
+
+	return true;
+}
+
+/**
+ * Find a pool buffer that is neither published nor still held by a reader. The pool is
+ * allocated by the first scan after the portal starts and freed when it stops.
+ */
+WiFiScanResults *AsyncWiFiManager::getScanBackBuffer() {
+	for (int i = 0; i < WIFI_MANAGER_SCAN_BUFFERS; i++) {
+		if (!_scanBuffers[i]) {
+			_scanBuffers[i].reset(new WiFiScanResults);
+		}
+	}
+
+	WiFiScanSnapshot front = getScanSnapshot();
+	for (int i = 0; i < WIFI_MANAGER_SCAN_BUFFERS; i++) {
+		// Only the pool references a free buffer. Readers copy the front pointer, never this one.
+		if (_scanBuffers[i].get() != front.get() && _scanBuffers[i].use_count() == 1) {
+			return _scanBuffers[i].get();
+		}
+	}
+
+	DEBUG_WM(F("All scan buffers in use"));
+	return NULL;
+}
+
+WiFiScanSnapshot AsyncWiFiManager::getScanSnapshot() {
+	_claim();
+	WiFiScanSnapshot scan = wifiSSIDs;
+	_release();
+
+	return scan;
+}
+
+void AsyncWiFiManager::startConfigPortal() {
+	_apRequest.store(0, std::memory_order_relaxed);
+	_request(REQUEST_AP);
+}
+
+void AsyncWiFiManager::startConfigPortal(const char *ssid, const char *pass) {
+	setAPCredentials(ssid, pass);
+	startConfigPortal();
+}
+
+void AsyncWiFiManager::stopConfigPortal(int timeoutMs) {
+	_apRequest.store(timeoutMs, std::memory_order_relaxed);	// Turn off after timeoutMs milliseconds
+	_request(REQUEST_AP);
+}
+
+void AsyncWiFiManager::_scanNetworks() {
+	if (_scanRunning) {
+		return;
+	}
+
+	WM_STATS_START(scanStart);
+	wifi_ssid_count_t n = WiFi.scanNetworks(true);
+	_scanRunning = true;
+	WM_STATS_ADD(scans, 1);
+	WM_STATS_ADD(scanMicros, micros() - scanStart);
+	if (n != WIFI_SCAN_RUNNING) {
+		_collectScan();
+	}
+}
+
+/** Called from loop() while a scan is running, publishes the results once it completes */
+void AsyncWiFiManager::_collectScan() {
+	wifi_ssid_count_t n = WiFi.scanComplete();
+	if (n == WIFI_SCAN_RUNNING) {
+		return;
+	}
+
+	WiFiScanSnapshot previous;
+	if (_eventSource != NULL) {
+		previous = getScanSnapshot();
+	}
+
+	WM_STATS_START(collectStart);
+	bool copied = copySSIDInfo(n);
+	WM_STATS_ADD(scanMicros, micros() - collectStart);
+	if (!copied) {
+		return;
+	}
+
+	_scanRunning = false;
+	_invalidatePages();
+	if (_eventSource != NULL) {
+		_sendScanEvent(previous, getScanSnapshot());
+	}
+
+	if (_scanThenConnect) {
+		_scanThenConnect = false;
+		if (WiFi.status() != WL_CONNECTED) {
+			_connectWiFi(); // Reconnect/carry on trying to connect
+		}
+	}
+}
+
+bool AsyncWiFiManager::_startConfigPortal() {
+	if (!_isAP) {
+		DEBUG_WM(F("Enable AP"));
+
+#ifdef ESP8266
+		// For ESP8266, need to save the current SSID and password
+//		_router_ssid = WiFi.SSID();
+//		_router_pass = WiFi.psk();
+#else
+		wl_status_t status = WiFi.status();
+		if (status != WL_CONNECTED) {
+			WiFi.disconnect();	// ESP32, can't scan while trying to connect to an AP.
+		}
+#endif
 
 		_setupConfigPortal();
 		WiFi.mode(WIFI_AP_STA);
 
-		if (WiFi.status() != WL_CONNECTED) {
+		// Scan in the background, the portal shows the results as soon as they are collected
+		_scanNetworks();
+		if (_scanRunning) {
+			_scanThenConnect = true;
+		} else if (WiFi.status() != WL_CONNECTED) {
 			_connectWiFi(); // Reconnect/carry on trying to connect
 		}
 
@@ -614,12 +1876,15 @@ void AsyncWiFiManager::_stopConfigPortal() {
 		}
 	}
 
-	if (wifiSSIDs != NULL) {
-		delete[] wifiSSIDs;
-		wifiSSIDs == NULL;
-	}
+	WiFiScanSnapshot released;
+	_claim();
+	wifiSSIDs.swap(released);
+	_release();
 
-	wifiSSIDCount = 0;
+	for (int i = 0; i < WIFI_MANAGER_SCAN_BUFFERS; i++) {
+		_scanBuffers[i].reset();	// Freed once the last reader lets go
+	}
+	_invalidatePages();
 
 	if (_portalSet){
 		_portalSet = false;
@@ -629,6 +1894,19 @@ void AsyncWiFiManager::_stopConfigPortal() {
 		server->removeHandler(iApHandler);
 		server->removeHandler(rApHandler);
 		server->removeHandler(fwLinkApHandler);
+		server->removeHandler(cssApHandler);
+		server->removeHandler(jsApHandler);
+		server->removeHandler(apiScanApHandler);
+		server->removeHandler(apiInfoApHandler);
+		server->removeHandler(apiStatusApHandler);
+		server->removeHandler(apiSaveApHandler);
+		server->removeHandler(eventsJsApHandler);
+		if (_eventSource != NULL) {
+			_eventSource->close();
+			server->removeHandler(_eventSource);	// Deletes it
+			_eventSource = NULL;
+			_invalidatePages();
+		}
 	}
 }
 
@@ -663,360 +1941,1320 @@ void AsyncWiFiManager::handleRoot(AsyncWebServerRequest *request) {
 		return;
 	}
 
-//  delay(20);
-
 	DEBUG_WM(F("Sending Captive Portal"));
 
-	AsyncResponseStream *response = request->beginResponseStream("text/html");
+	sendPage(request, PAGE_ROOT);
 
-	response->print(_rootHead);
-	response->print(FPSTR(HTTP_SCRIPT));
-	response->print(FPSTR(HTTP_STYLE));
-	response->print(_customHeadHTML);
-	response->print(FPSTR(HTTP_HEAD_END));
-	response->print("<h1>");
-	response->print(_ap_ssid);
-	response->print("</h1>");
-	response->print(F("<h3>AsyncWiFiManager</h3>"));
-	response->print(FPSTR(HTTP_PORTAL_OPTIONS));
-	response->print(_customOptionsHTML);
-	response->print(FPSTR(HTTP_END));
+	DEBUG_WM(F("Sent..."));
+}
 
-	request->send(response);
-//	AsyncWebServerResponse *response = request->beginResponse(200, "text/html", page);
-//
-//  response->addHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-//  response->addHeader("Pragma", "no-cache");
-//  response->addHeader("Expires", "-1");
-//
-//	request->send(response);
+void AsyncWiFiManager::renderRoot(Print *out) {
+	out->print(_rootHead);
+	out->print(_scriptLink);
+	out->print(_styleLink);
+	out->print(_customHeadHTML);
+	out->print(FPSTR(HTTP_HEAD_END));
+	out->print("<h1>");
+	out->print(_ap_ssid);
+	out->print("</h1>");
+	out->print(F("<h3>AsyncWiFiManager</h3>"));
+	out->print(FPSTR(HTTP_PORTAL_OPTIONS));
+	out->print(_customOptionsHTML);
+	out->print(FPSTR(HTTP_END));
+}
+
+/**
+ * Stream a PROGMEM template, replacing each {k} whose k is found in keys by the value at the same
+ * index. Literal text is copied through a small stack buffer, so no String is built on the way.
+ */
+void AsyncWiFiManager::sendTemplate(Print *out, PGM_P tmpl, const char *keys, const char *const values[]) {
+	char buf[64];
+	size_t len = 0;
+	char c;
+
+	while ((c = pgm_read_byte(tmpl)) != 0) {
+		char k = c == '{' ? pgm_read_byte(tmpl + 1) : 0;
+		if (k != 0 && pgm_read_byte(tmpl + 2) == '}') {
+			const char *key = strchr(keys, k);
+			if (key != NULL) {
+				out->write((const uint8_t *)buf, len);
+				len = 0;
+				out->print(values[key - keys]);
+				tmpl += 3;
+				continue;
+			}
+		}
 
-//	delay(100);
+		buf[len++] = c;
+		if (len == sizeof(buf)) {
+			out->write((const uint8_t *)buf, len);
+			len = 0;
+		}
+		tmpl++;
+	}
 
-	DEBUG_WM(F("Sent..."));
+	out->write((const uint8_t *)buf, len);
 }
 
-/** Wifi config page handler */
-static String oneString("1");
+void AsyncWiFiManager::sendFormParam(Print *out, const char *id, const char *placeholder, int length, const char *value, const char *custom) {
+	char lengthStr[12];
+	snprintf(lengthStr, sizeof(lengthStr), "%d", length);
+
+	const char *values[] = { id, id, placeholder, lengthStr, value, custom };
+	sendTemplate(out, HTTP_FORM_PARAM, "inplvc", values);
+}
+
+/** Form field for a typed parameter, with the input type and limits so the browser checks them first */
+void AsyncWiFiManager::sendTypedParam(Print *out, AsyncWiFiManagerParameter *param) {
+	char custom[64];
+
+	switch (param->getType()) {
+	case AsyncWiFiManagerParameter::ENUM: {
+		const char *values[] = { param->getID(), param->getID(), param->getPlaceholder() };
+		sendTemplate(out, HTTP_FORM_SELECT, "inp", values);
+		for (uint8_t i = 0; i < param->_optionCount; i++) {
+			const char *option[] = { i == param->getOption() ? " selected" : "", param->_options[i] };
+			sendTemplate(out, HTTP_FORM_OPTION, "sv", option);
+		}
+		out->print(F("</select>"));
+		return;
+	}
+	case AsyncWiFiManagerParameter::INT:
+		snprintf(custom, sizeof(custom), "type='number' min='%ld' max='%ld'", (long)param->_min.i, (long)param->_max.i);
+		break;
+	case AsyncWiFiManagerParameter::FLOAT:
+		strcpy(custom, "type='number' step='any'");
+		break;
+	case AsyncWiFiManagerParameter::BOOL:
+		snprintf(custom, sizeof(custom), "type='checkbox' style='width:auto'%s", param->getBool() ? " checked" : "");
+		break;
+	default:
+		custom[0] = 0;
+		break;
+	}
+
+	sendFormParam(out, param->getID(), param->getPlaceholder(), param->getValueLength(), param->getValue(), custom);
+}
+
+void AsyncWiFiManager::sendIPParam(Print *out, const char *id, const char *placeholder, IPAddress ip) {
+	char ipStr[16];
+	formatIP(ip, ipStr);
 
+	sendFormParam(out, id, placeholder, 15, ipStr, "");
+}
+
+/** Wifi config page handler */
 void AsyncWiFiManager::handleWifi(AsyncWebServerRequest *request) {
 	DEBUG_WM(F("Handle wifi"));
 
-	String useStatic = request->arg("static");
-	_loop_scan = request->hasParam("scan");
-	
-	AsyncResponseStream *response = request->beginResponseStream("text/html");
+	if (request->hasParam("scan") && _eventSource != NULL) {
+		_request(REQUEST_SCAN);		// The results arrive over /events, no need to reload
+	} else if (request->hasParam("scan")) {
+		WM_STATS_START(start);
+		const char *values[] = { request->arg("static").c_str() };
 
-	if (_loop_scan) {
-		_release();
+		_request(REQUEST_SCAN);
 
+		AsyncResponseStream *response = request->beginResponseStream("text/html");
 		response->print(_wifiHead);
-		response->print(FPSTR(HTTP_STYLE));
+		response->print(_styleLink);
 		response->print(_customHeadHTML);
-		String refresh = String(HTTP_SCAN_REFRESH);
-		refresh.replace("{s}", useStatic);
-		response->print(refresh);
+		sendTemplate(response, HTTP_SCAN_REFRESH, "s", values);
 		response->print(FPSTR(HTTP_HEAD_END));
 		response->print(F("Scanning..."));
 		response->print(FPSTR(HTTP_END));
 
+		WM_STATS_ROUTE(ROUTE_WIFI, start, response->available());
 		request->send(response);
 		return;
 	}
 
+	sendPage(request, request->arg("static") == "1" ? PAGE_WIFI_STATIC : PAGE_WIFI);
+
+	DEBUG_WM(F("Sent config page"));
+}
+
+/**
+ * Render the next piece of the wifi page: the head, then one network or one parameter at a time,
+ * then the rest of the form. Returns false once the page is complete.
+ */
+bool AsyncWiFiManager::renderWifiStep(Print *out, bool useStatic, WiFiManagerRenderState &state) {
+	enum {
+		STEP_HEAD, STEP_NETWORKS, STEP_PARAMS, STEP_END
+	};
+
+	switch (state.step) {
+	case STEP_HEAD:
+		out->print(_wifiHead);
+		out->print(_scriptLink);
+		if (_eventSource != NULL) {
+			out->print(_eventsLink);
+		}
+		out->print(_styleLink);
+		out->print(_customHeadHTML);
+		out->print(FPSTR(HTTP_HEAD_END));
+
+		//display networks in page
+		out->print(F("<div id='n'>"));
+		state.scan = getScanSnapshot();
+		state.step = STEP_NETWORKS;
+		state.item = 0;
+		return true;
+
+	case STEP_NETWORKS:
+		if (state.scan && state.item < state.scan->count) {
+			sendNetworkItem(out, state.scan->results[state.item++]);
+			return true;
+		}
+		out->print(F("</div>"));
+		if (!state.scan || state.scan->count == 0) {
+			out->print(F("<div id='nn'>No networks found</div>"));
+		}
+		state.scan.reset();
+		out->print("<br/>");
+
+		out->print(FPSTR(HTTP_FORM_START));
+		state.step = STEP_PARAMS;
+		state.item = 0;
+		return true;
+
+	case STEP_PARAMS:
+		// add the extra parameters to the form
+		if (state.item < _paramsCount) {
+			AsyncWiFiManagerParameter *param = _params[state.item++];
+			if (param->getID() != NULL && param->getType() != AsyncWiFiManagerParameter::STRING) {
+				sendTypedParam(out, param);
+			} else if (param->getID() != NULL) {
+				sendFormParam(out, param->getID(), param->getPlaceholder(),
+						param->getValueLength(), param->getValue(), param->getCustomHTML());
+			} else {
+				out->print(param->getCustomHTML());
+			}
+			return true;
+		}
+		if (_paramsCount > 0) {
+			out->print("<br/>");
+		}
+		state.step = STEP_END;
+		return true;
+
+	default:
+		break;
+	}
+
+	const char *values[] = { useStatic ? "1" : "" };
+	if (useStatic) {
+		sendIPParam(out, "ip", "Static IP", _sta_static_ip);
+		sendIPParam(out, "gw", "Static Gateway", _sta_static_gw);
+		sendIPParam(out, "sn", "Subnet", _sta_static_sn);
+		sendIPParam(out, "dns1", "DNS1", _sta_static_dns1);
+		sendIPParam(out, "dns2", "DNS2", _sta_static_dns2);
+
+		out->print("<br/>");
+	}
+
+	out->print(FPSTR(HTTP_FORM_END));
+
+	sendTemplate(out, HTTP_SCAN_LINK, "s", values);
+
+	out->print(FPSTR(HTTP_END));
+	return false;
+}
+
+/** Set the primary router network. Networks added with addRouterCredentials() are kept as backups. */
+void AsyncWiFiManager::setRouterCredentials(const char *ssid, const char *pass) {
+	int existing = _networkCount;
+	for (int i = 0; i < _networkCount; i++) {
+		if (_networks[i].ssid == ssid) {
+			existing = i;
+			break;
+		}
+	}
+	if (existing == WIFI_MANAGER_MAX_NETWORKS) {
+		existing--;		// Full, drop the last backup
+	} else if (existing == _networkCount) {
+		_networkCount++;
+	}
+
+	WiFiCredential network = _networks[existing];
+	if (network.ssid != ssid || network.pass != pass) {
+		network = WiFiCredential();		// New network or password, forget its history
+	}
+	network.ssid = ssid;
+	network.pass = pass;
+
+	for (int i = existing; i > 0; i--) {
+		_networks[i] = _networks[i - 1];
+	}
+	_networks[0] = network;
+	_attemptNetwork = -1;
+	_candidateIdx = WIFI_MANAGER_MAX_NETWORKS;
+}
+
+/** Add a backup router network, tried when the primary is out of range or fails */
+void AsyncWiFiManager::addRouterCredentials(const char *ssid, const char *pass) {
+	for (int i = 0; i < _networkCount; i++) {
+		if (_networks[i].ssid == ssid) {
+			_networks[i].pass = pass;
+			return;
+		}
+	}
+
+	if (_networkCount == WIFI_MANAGER_MAX_NETWORKS) {
+		DEBUG_WM(F("Too many networks, ignoring"));
+		return;
+	}
+
+	_networks[_networkCount].ssid = ssid;
+	_networks[_networkCount].pass = pass;
+	_networkCount++;
+	_attemptNetwork = -1;
+	_candidateIdx = WIFI_MANAGER_MAX_NETWORKS;
+}
+
+/** Forget all router networks, the credentials saved by the WiFi stack are used instead */
+void AsyncWiFiManager::clearRouterCredentials() {
+	for (int i = 0; i < _networkCount; i++) {
+		_networks[i] = WiFiCredential();
+	}
+	_networkCount = 0;
+	_attemptNetwork = -1;
+	_candidateIdx = WIFI_MANAGER_MAX_NETWORKS;
+}
+
+void AsyncWiFiManager::setAPCredentials(const char *ssid, const char *pass) {
+	_ap_ssid = ssid;
+	_ap_pass = pass;
+}
+
+/** The first typed parameter whose value in the request doesn't parse or is out of range, or NULL */
+AsyncWiFiManagerParameter* AsyncWiFiManager::_validateParameters(AsyncWebServerRequest *request) {
+	AsyncWiFiManagerParameter::Value value;
+	for (size_t i = 0; i < request->args(); i++) {
+		const char *name = request->argName(i).c_str();
+		for (int j = _findParameter(name); j < _paramIndexCount; j++) {
+			AsyncWiFiManagerParameter *param = _params[_paramIndex[j]];
+			if (strcmp(param->_id, name) != 0) {
+				break;
+			}
+			if (!param->parse(request->arg(i).c_str(), value)) {
+				return param;
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Store the custom parameters from a save request, and hand the credentials and static IP
+ * configuration to loop(), which applies them on the REQUEST_CONNECT that follows. Nothing is stored
+ * if a typed parameter is invalid, that parameter is returned instead. Otherwise returns NULL, and
+ * loop() also writes the parameters to the parameter store if there is one.
+ */
+AsyncWiFiManagerParameter* AsyncWiFiManager::saveCredentials(AsyncWebServerRequest *request) {
+	AsyncWiFiManagerParameter *invalid = _validateParameters(request);
+	if (invalid != NULL) {
+		DEBUG_WM(F("Invalid parameter"));
+		DEBUG_WM(invalid->_id);
+		return invalid;
+	}
+
+	//parameters, a string missing from the form is saved as empty, as is an unchecked checkbox
+	for (int i = 0; i < _paramIndexCount; i++) {
+		AsyncWiFiManagerParameter *param = _params[_paramIndex[i]];
+		if (param->_type == AsyncWiFiManagerParameter::STRING) {
+			param->_value[0] = 0;
+		} else if (param->_type == AsyncWiFiManagerParameter::BOOL) {
+			param->_data.i = 0;
+		}
+	}
+
+	// One pass over the request. Values are used where the server decoded them, strings are copied
+	// once into the parameter buffers and IP addresses are parsed straight into the configuration.
+	const char *ssid = "";
+	const char *pass = "";
+	IPAddress staticIPs[5];		// As in WiFiManagerPendingSave
+	uint8_t staticSet = 0;
+	for (size_t i = 0; i < request->args(); i++) {
+		const char *name = request->argName(i).c_str();
+		const String &value = request->arg(i);
+
+		int staticField = -1;
+		if (name[0] != 0 && name[1] == 0) {
+			if (name[0] == 's') {
+				ssid = value.c_str();
+			} else if (name[0] == 'p') {
+				pass = value.c_str();
+			}
+		} else if (strcmp(name, "ip") == 0) {
+			staticField = 0;
+		} else if (strcmp(name, "gw") == 0) {
+			staticField = 1;
+		} else if (strcmp(name, "sn") == 0) {
+			staticField = 2;
+		} else if (strcmp(name, "dns1") == 0) {
+			staticField = 3;
+		} else if (strcmp(name, "dns2") == 0) {
+			staticField = 4;
+		}
+		if (staticField >= 0) {
+			DEBUG_WM(F("static IP field"));
+			DEBUG_WM(name);
+			DEBUG_WM(value);
+			if (parseIP(value.c_str(), staticIPs[staticField])) {
+				staticSet |= 1 << staticField;		// Left as it was unless the field is a valid address
+			}
+		}
+
+		// each argument is looked up in the sorted index
+		for (int j = _findParameter(name); j < _paramIndexCount; j++) {
+			AsyncWiFiManagerParameter *param = _params[_paramIndex[j]];
+			if (strcmp(param->_id, name) != 0) {
+				break;
+			}
+			if (param->_type != AsyncWiFiManagerParameter::STRING) {
+				param->parse(value.c_str(), param->_data);
+			} else {
+				size_t length = std::min((size_t)value.length(), (size_t)param->_length);
+				memcpy(param->_value, value.c_str(), length);
+				param->_value[length] = 0;
+			}
+			DEBUG_WM(F("Parameter"));
+			DEBUG_WM(param->_id);
+			DEBUG_WM(param->getValue());
+		}
+	}
+
+	// loop() may be connecting with the current credentials right now, it takes these on the
+	// REQUEST_CONNECT the handler posts next. A second save before then replaces the first.
+	_claim();
+	_pendingSave.pending = true;
+	_pendingSave.ssid = ssid;
+	_pendingSave.pass = pass;
+	for (int i = 0; i < 5; i++) {
+		_pendingSave.staticIPs[i] = staticIPs[i];
+	}
+	_pendingSave.staticSet = staticSet;
+	_pendingSave.store = _store;		// Not from here, EEPROM.commit() stalls the flash for the whole write
 	_release();
 
-	response->print(_wifiHead);
-	response->print(FPSTR(HTTP_SCRIPT));
-	response->print(FPSTR(HTTP_STYLE));
-	response->print(_customHeadHTML);
-	response->print(FPSTR(HTTP_HEAD_END));
+	_invalidatePages();
+	return NULL;
+}
+
+/** Apply the credentials and static IP configuration of the last portal save, from loop() */
+void AsyncWiFiManager::_applySave() {
+	WiFiManagerPendingSave save;
 
-	//display networks in page
-	sendNetworkList(response);
-	response->print("<br/>");
+	_claim();
+	std::swap(save, _pendingSave);		// Moves the strings, nothing is allocated under the lock
+	_release();
+
+	if (!save.pending) {
+		return;		// connect() or WPS, with the credentials already set
+	}
+
+	IPAddress *staticIPs[] = { &_sta_static_ip, &_sta_static_gw, &_sta_static_sn, &_sta_static_dns1, &_sta_static_dns2 };
+	for (int i = 0; i < 5; i++) {
+		if (save.staticSet & (1 << i)) {
+			*staticIPs[i] = save.staticIPs[i];
+		}
+	}
+	if (save.ssid.length() > 0) {
+		setRouterCredentials(save.ssid.c_str(), save.pass.c_str());		// Empty when only parameters were saved
+	}
+
+	if (save.store) {
+		saveParameters();
+	}
+}
+
+/**
+ * Keep the parameter values in EEPROM from offset, in two slots that are written alternately. Each
+ * slot is a WiFiManagerConfigHeader and the values in the order the parameters were added: the
+ * binary value of typed parameters and the whole buffer of string parameters. The newest slot with
+ * a valid CRC is loaded, so a torn record is never used. Bump the version whenever the parameters
+ * change, a record with another version or length is ignored. loop() then saves the values after
+ * every portal save; call loadParameters() once all parameters are added. If the application
+ * hasn't started the EEPROM, loadParameters() starts it with configStoreSize() bytes. One started
+ * with less than that is left alone, and nothing is loaded or saved.
+ *
+ * The slots don't make the save atomic on ESP8266: EEPROM.commit() erases and rewrites the one
+ * flash sector behind the whole EEPROM, both slots included, so a reset during it can lose both
+ * and loadParameters() then keeps the defaults. On ESP32 the EEPROM is an NVS blob, which NVS
+ * replaces atomically.
+ */
+void AsyncWiFiManager::setParameterStore(size_t offset, uint16_t version) {
+	_store = true;
+	_storeOffset = offset;
+	_storeVersion = version;
+}
 
-	response->print(FPSTR(HTTP_FORM_START));
-	char parLength[2];
-	// add the extra parameters to the form
+size_t AsyncWiFiManager::_storeLength() {
+	size_t length = 0;
 	for (int i = 0; i < _paramsCount; i++) {
-		if (_params[i] == NULL) {
-			break;
+		if (_params[i]->_id != NULL) {
+			length += _params[i]->storedSize();
 		}
+	}
+	return length;
+}
+
+size_t AsyncWiFiManager::_storeSlotSize() {
+	return (sizeof(WiFiManagerConfigHeader) + _storeLength() + 3) & ~3;
+}
+
+/** EEPROM bytes the parameter store needs, the offset and both slots. Only final once all parameters are added. */
+size_t AsyncWiFiManager::configStoreSize() {
+	return _storeOffset + 2 * _storeSlotSize();
+}
 
-		String pitem = FPSTR(HTTP_FORM_PARAM);
-		if (_params[i]->getID() != NULL) {
-			pitem.replace("{i}", _params[i]->getID());
-			pitem.replace("{n}", _params[i]->getID());
-			pitem.replace("{p}", _params[i]->getPlaceholder());
-			snprintf(parLength, 2, "%d", _params[i]->getValueLength());
-			pitem.replace("{l}", parLength);
-			pitem.replace("{v}", _params[i]->getValue());
-			pitem.replace("{c}", _params[i]->getCustomHTML());
+/** Start the EEPROM if the application hasn't, otherwise check that it holds both slots */
+bool AsyncWiFiManager::_storeReady() {
+	size_t size = configStoreSize();
+	if (EEPROM.length() == 0) {
+		EEPROM.begin(size);
+	}
+	if (EEPROM.length() < size) {
+		DEBUG_WM(F("EEPROM too small for the parameters, bytes needed:"));
+		DEBUG_WM(size);
+		return false;
+	}
+	return true;
+}
+
+/** The slot holding the newest valid record for the current parameters and its header, or -1 */
+int AsyncWiFiManager::_storeCurrentSlot(WiFiManagerConfigHeader &header) {
+	size_t slotSize = _storeSlotSize();
+#if defined(ESP8266)
+	const uint8_t *data = EEPROM.getConstDataPtr() + _storeOffset;
+#else
+	const uint8_t *data = EEPROM.getDataPtr() + _storeOffset;
+#endif
+
+	int current = -1;
+	for (int slot = 0; slot < 2; slot++) {
+		const uint8_t *record = data + slot * slotSize;
+		WiFiManagerConfigHeader candidate;
+		memcpy(&candidate, record, sizeof(candidate));
+		if (candidate.magic != WIFI_MANAGER_CONFIG_MAGIC || candidate.version != _storeVersion
+				|| candidate.length != _storeLength()
+				|| candidate.crc != crc32(record + sizeof(candidate.crc), sizeof(candidate) - sizeof(candidate.crc) + candidate.length)) {
+			continue;
+		}
+		if (current == -1 || (int32_t)(candidate.sequence - header.sequence) > 0) {
+			current = slot;
+			header = candidate;
+		}
+	}
+	return current;
+}
+
+/** Read the saved values straight into the parameters. Returns false, keeping the defaults, if there are none. */
+bool AsyncWiFiManager::loadParameters() {
+	WiFiManagerConfigHeader header;
+	int slot = _store && _storeReady() ? _storeCurrentSlot(header) : -1;
+	if (slot < 0) {
+		DEBUG_WM(F("No saved parameters"));
+		return false;
+	}
+
+#if defined(ESP8266)
+	const uint8_t *values = EEPROM.getConstDataPtr() + _storeOffset + slot * _storeSlotSize() + sizeof(header);
+#else
+	const uint8_t *values = EEPROM.getDataPtr() + _storeOffset + slot * _storeSlotSize() + sizeof(header);
+#endif
+	for (int i = 0; i < _paramsCount; i++) {
+		AsyncWiFiManagerParameter *param = _params[i];
+		if (param->_id == NULL) {
+			continue;
+		}
+		if (param->_type == AsyncWiFiManagerParameter::STRING) {
+			memcpy(param->_value, values, param->_length);
+			param->_value[param->_length] = 0;
+		} else {
+			memcpy(&param->_data, values, sizeof(param->_data));
+			if (param->_type == AsyncWiFiManagerParameter::ENUM && param->_data.i >= param->_optionCount) {
+				param->_data.i = 0;
+			}
+		}
+		values += param->storedSize();
+	}
+
+	_invalidatePages();
+	return true;
+}
+
+/** Write the parameter values to the older slot, leaving the current one as it is, see setParameterStore() */
+bool AsyncWiFiManager::saveParameters() {
+	if (!_store || !_storeReady()) {
+		return false;
+	}
+
+	WiFiManagerConfigHeader header;
+	int current = _storeCurrentSlot(header);
+	uint32_t sequence = current < 0 ? 1 : header.sequence + 1;
+	int slot = current == 0 ? 1 : 0;
+
+	uint8_t *record = EEPROM.getDataPtr() + _storeOffset + slot * _storeSlotSize();
+	uint8_t *values = record + sizeof(header);
+	for (int i = 0; i < _paramsCount; i++) {
+		AsyncWiFiManagerParameter *param = _params[i];
+		if (param->_id == NULL) {
+			continue;
+		}
+		if (param->_type == AsyncWiFiManagerParameter::STRING) {
+			memcpy(values, param->_value, param->_length + 1);
 		} else {
-			pitem = _params[i]->getCustomHTML();
+			memcpy(values, &param->_data, sizeof(param->_data));
 		}
+		values += param->storedSize();
+	}
+
+	header.magic = WIFI_MANAGER_CONFIG_MAGIC;
+	header.version = _storeVersion;
+	header.sequence = sequence;
+	header.length = values - record - sizeof(header);
+	header.reserved = 0;
+	memcpy(record, &header, sizeof(header));
+	header.crc = crc32(record + sizeof(header.crc), sizeof(header) - sizeof(header.crc) + header.length);
+	memcpy(record, &header.crc, sizeof(header.crc));
+
+	bool committed = EEPROM.commit();
+	if (!committed) {
+		DEBUG_WM(F("Saving parameters failed"));
+	}
+	return committed;
+}
+
+/** Handle the WLAN save form and redirect to WLAN config page again */
+void AsyncWiFiManager::handleWifiSave(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
+	DEBUG_WM(F("WiFi save"));
+
+	//SAVE/connect here
+	AsyncWiFiManagerParameter *invalid = saveCredentials(request);
+
+	AsyncResponseStream *response = request->beginResponseStream("text/html");
+	if (invalid != NULL) {
+		const char *values[] = { invalid->getPlaceholder() };
+		response->setCode(400);
+		response->print(_wifiSaveHead);
+		response->print(_styleLink);
+		response->print(_customHeadHTML);
+		response->print(FPSTR(HTTP_HEAD_END));
+		sendTemplate(response, HTTP_INVALID, "p", values);
+		response->print(FPSTR(HTTP_END));
+
+		WM_STATS_ROUTE(ROUTE_WIFI_SAVE, start, response->available());
+		request->send(response);
+		return;
+	}
+
+	response->print(_wifiSaveHead);
+	response->print(_scriptLink);
+	response->print(_styleLink);
+	response->print(_customHeadHTML);
+	response->print(F("<meta http-equiv=\"refresh\" content=\"15; url=/i\">"));
+	response->print(FPSTR(HTTP_HEAD_END));
+	response->print(FPSTR(HTTP_SAVED));
+	response->print(FPSTR(HTTP_END));
+
+	WM_STATS_ROUTE(ROUTE_WIFI_SAVE, start, response->available());
+	request->send(response);
+
+	DEBUG_WM(F("Sent wifi save page"));
+
+	_request(REQUEST_CONNECT); //signal ready to connect/reset
+}
+
+/** Handle the info page */
+void AsyncWiFiManager::sendInfo(Print *out) {
+	out->print(F("<dt>Chip ID</dt><dd>"));
+#if defined(ESP8266)
+	out->print(ESP.getChipId());
+#else
+  out->print(getESP32ChipID());
+#endif
+	out->print(F("</dd>"));
+	out->print(F("<dt>Flash Chip ID</dt><dd>"));
+#if defined(ESP8266)
+	out->print(ESP.getFlashChipId());
+#else
+  out->print(F("N/A for ESP32"));
+#endif
+	out->print(F("</dd>"));
+	out->print(F("<dt>IDE Flash Size</dt><dd>"));
+	out->print(ESP.getFlashChipSize());
+	out->print(F(" bytes</dd>"));
+	out->print(F("<dt>Real Flash Size</dt><dd>"));
+#if defined(ESP8266)
+	out->print(ESP.getFlashChipRealSize());
+#else
+  out->print(F("N/A for ESP32"));
+#endif
+	out->print(F(" bytes</dd>"));
+	out->print(F("<dt>Soft AP IP</dt><dd>"));
+	out->print(WiFi.softAPIP().toString());
+	out->print(F("</dd>"));
+	out->print(F("<dt>Soft AP MAC</dt><dd>"));
+	out->print(WiFi.softAPmacAddress());
+	out->print(F("</dd>"));
+	out->print(F("<dt>AP SSID</dt><dd>"));
+#if defined(ESP8266)
+	struct softap_config conf_current;
+	wifi_softap_get_config(&conf_current);
+	out->print(String(reinterpret_cast<char*>(conf_current.ssid)));
+#else
+  wifi_config_t conf_current;
+  esp_wifi_get_config(WIFI_IF_AP, &conf_current);
+  out->print(String(reinterpret_cast<char*>(conf_current.ap.ssid)));
+#endif
+	out->print(F("</dd>"));
+	out->print(F("<dt>Network SSID</dt><dd id='ss'>"));
+	out->print(WiFi.SSID());
+	out->print(F("</dd>"));
+	out->print(F("<dt>Station IP</dt><dd id='ip'>"));
+	out->print(WiFi.localIP().toString());
+	out->print(F("</dd>"));
+	out->print(F("<dt>Station MAC</dt><dd>"));
+	out->print(WiFi.macAddress());
+	out->print(F("</dd>"));
+#ifdef WIFI_MANAGER_STATS
+	sendStats(out);
+#endif
+	out->print(F("</dl>"));
+}
+
+void AsyncWiFiManager::handleInfo(AsyncWebServerRequest *request) {
+	DEBUG_WM(F("Info"));
+
+	sendPage(request, PAGE_INFO);
 
-		response->print(pitem);
+	DEBUG_WM(F("Sent info page"));
+}
+
+void AsyncWiFiManager::renderInfo(Print *out) {
+	out->print(_infoHead);
+	out->print(_scriptLink);
+	out->print(_styleLink);
+	out->print(_customHeadHTML);
+	if (_eventSource != NULL) {
+		out->print(_eventsLink);
+	} else if (_connect == true) {
+		out->print(F("<meta http-equiv=\"refresh\" content=\"5; url=/i\">"));
 	}
-	if (_params[0] != NULL) {
-		response->print("<br/>");
+	out->print(FPSTR(HTTP_HEAD_END));
+	out->print(F("<dl>"));
+	if (_connect == true) {
+		out->print(F("<dt>Trying to connect</dt><dd id='st'>"));
+		out->print(WiFi.status());
+		out->print(F("</dd>"));
 	}
 
-	if (useStatic == oneString) {
+	sendInfo(out);
+
+	out->print(FPSTR(HTTP_END));
+}
 
-		String item = FPSTR(HTTP_FORM_PARAM);
-		item.replace("{i}", "ip");
-		item.replace("{n}", "ip");
-		item.replace("{p}", "Static IP");
-		item.replace("{l}", "15");
-		item.replace("{v}", _sta_static_ip.toString());
+void AsyncWiFiManager::renderPage(CachedPage page, Print *out) {
+	WiFiManagerRenderState state;
+	while (renderStep(page, out, state)) {
+	}
+}
 
-		response->print(item);
+/** Render the next piece of a page, returns false once it is complete. The root and info pages are one piece. */
+bool AsyncWiFiManager::renderStep(CachedPage page, Print *out, WiFiManagerRenderState &state) {
+	switch (page) {
+	case PAGE_ROOT:
+		renderRoot(out);
+		return false;
+	case PAGE_INFO:
+		renderInfo(out);
+		return false;
+	case PAGE_WIFI:
+		return renderWifiStep(out, false, state);
+	case PAGE_WIFI_STATIC:
+		return renderWifiStep(out, true, state);
+	default:
+		return false;
+	}
+}
+
+#ifdef WIFI_MANAGER_STATS
+static const AsyncWiFiManagerStats::Route pageRoutes[] = {
+	AsyncWiFiManagerStats::ROUTE_ROOT,
+	AsyncWiFiManagerStats::ROUTE_INFO,
+	AsyncWiFiManagerStats::ROUTE_WIFI,
+	AsyncWiFiManagerStats::ROUTE_WIFI
+};
+#endif
 
-		item = FPSTR(HTTP_FORM_PARAM);
-		item.replace("{i}", "gw");
-		item.replace("{n}", "gw");
-		item.replace("{p}", "Static Gateway");
-		item.replace("{l}", "15");
-		item.replace("{v}", _sta_static_gw.toString());
+/**
+ * Send one of the portal pages. With the page cache on, a page is rendered once and then served from
+ * the cache, with an ETag so that browsers can revalidate with a 304, until _invalidatePages().
+ */
+void AsyncWiFiManager::sendPage(AsyncWebServerRequest *request, CachedPage page) {
+	WM_STATS_START(start);
 
-		response->print(item);
+	// The info page changes by the second while connecting, and so do the counters on it
+#ifdef WIFI_MANAGER_STATS
+	bool cacheable = _pageCache && page != PAGE_INFO;
+#else
+	bool cacheable = _pageCache && !(page == PAGE_INFO && _connect);
+#endif
+	if (!cacheable && _chunkedPages) {
+		sendChunkedPage(request, page, WM_STATS_BYTES(Route(pageRoutes[page])));
+		WM_STATS_ROUTE(Route(pageRoutes[page]), start, 0);	// The last chunk adds the length
+		return;
+	}
+	if (!cacheable) {
+		// AsyncResponseStream grows by exactly what each write lacks, which for a page written
+		// piece by piece is one reallocation per piece once it is past the initial buffer
+		size_t length = _pageLengths[page] + WIFI_MANAGER_PAGE_SLACK;
+		AsyncResponseStream *response = request->beginResponseStream("text/html", length > 1460 ? length : 1460);
+		renderPage(page, response);
+		_pageLengths[page] = response->available();
+		WM_STATS_ROUTE(Route(pageRoutes[page]), start, response->available());
+		request->send(response);
+		return;
+	}
 
-		item = FPSTR(HTTP_FORM_PARAM);
-		item.replace("{i}", "sn");
-		item.replace("{n}", "sn");
-		item.replace("{p}", "Subnet");
-		item.replace("{l}", "15");
-		item.replace("{v}", _sta_static_sn.toString());
+	_claim();
+	WiFiManagerPagePtr cached = _pages[page];
+	uint32_t generation = _pageGeneration;
+	_release();
 
-		response->print(item);
+	if (!cached) {
+		std::shared_ptr<WiFiManagerPage> rendered = std::make_shared<WiFiManagerPage>();
+		renderPage(page, &rendered->body);
+		rendered->etag = contentETag(rendered->body.c_str());
+		cached = rendered;
 
-		item = FPSTR(HTTP_FORM_PARAM);
-		item.replace("{i}", "dns1");
-		item.replace("{n}", "dns1");
-		item.replace("{p}", "DNS1");
-		item.replace("{l}", "15");
-		item.replace("{v}", _sta_static_dns1.toString());
+		_claim();
+		if (generation == _pageGeneration) {
+			_pages[page] = cached;	// Unless invalidated while rendering
+		}
+		_release();
+	}
+
+	AsyncWebServerResponse *response;
+	size_t length = 0;
+
+	AsyncWebHeader *ifNoneMatch = request->getHeader("If-None-Match");
+	if (ifNoneMatch != NULL && ifNoneMatch->value() == cached->etag) {
+		response = request->beginResponse(304);
+	} else {
+		length = cached->body.length();
+		// The response keeps the page alive until it has been sent
+		response = request->beginResponse("text/html", length, [cached](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+			size_t remaining = cached->body.length() - index;
+			size_t count = remaining < maxLen ? remaining : maxLen;
+			memcpy(buffer, cached->body.c_str() + index, count);
+			return count;
+		});
+	}
+
+	response->addHeader("ETag", cached->etag);
+	response->addHeader("Cache-Control", "no-cache");
+	WM_STATS_ROUTE(Route(pageRoutes[page]), start, length);
+	request->send(response);
+}
+
+/**
+ * Fill the next chunk of a chunked response: first what didn't fit into the previous one, then
+ * steps of the render until the chunk is full or the render is complete.
+ */
+template<typename Step>
+static size_t fillChunk(WiFiManagerChunkedPage &chunked, uint8_t *buffer, size_t maxLen, Step step) {
+	size_t length = 0;
+	if (chunked.carried < chunked.carry.length()) {
+		length = std::min(chunked.carry.length() - chunked.carried, maxLen);
+		memcpy(buffer, chunked.carry.c_str() + chunked.carried, length);
+		chunked.carried += length;
+		if (chunked.carried < chunked.carry.length()) {
+			chunked.sent += length;
+			return length;
+		}
+	}
+	chunked.carry = StreamString();	// Frees it
+	chunked.carried = 0;
+
+	WiFiManagerChunkWriter out(buffer + length, maxLen - length, chunked.carry);
+	while (!chunked.done && !out.full()) {
+		chunked.done = !step(&out);
+	}
+
+	length += out.length();		// 0 once done and drained ends the response
+	chunked.sent += length;
+	if (length == 0 && chunked.bytes != NULL) {
+		*chunked.bytes += chunked.sent;
+		chunked.bytes = NULL;
+	}
+	return length;
+}
+
+/**
+ * Send a page with chunked transfer encoding, rendering it piece by piece as the connection takes
+ * it. Only the piece that didn't fit into the previous chunk is kept in between, rather than the
+ * whole page as with AsyncResponseStream.
+ */
+void AsyncWiFiManager::sendChunkedPage(AsyncWebServerRequest *request, CachedPage page, uint32_t *bytes) {
+	std::shared_ptr<WiFiManagerChunkedPage> chunked = std::make_shared<WiFiManagerChunkedPage>();
+	chunked->bytes = bytes;
+
+	AsyncWebServerResponse *response = request->beginChunkedResponse("text/html", [this, page, chunked](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+		return fillChunk(*chunked, buffer, maxLen, [this, page, chunked](Print *out) {
+			return renderStep(page, out, chunked->state);
+		});
+	});
+	response->addHeader("Cache-Control", "no-cache");
+	request->send(response);
+}
+
+/**
+ * Send a JSON document the same way as a chunked page: step(json, state) writes the next piece and
+ * returns false once the document is complete.
+ */
+template<typename Step>
+void AsyncWiFiManager::sendChunkedJson(AsyncWebServerRequest *request, int code, uint32_t *bytes, Step step) {
+	std::shared_ptr<WiFiManagerChunkedJson> chunked = std::make_shared<WiFiManagerChunkedJson>();
+	chunked->bytes = bytes;
+
+	AsyncWebServerResponse *response = request->beginChunkedResponse("application/json", [chunked, step](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+		return fillChunk(*chunked, buffer, maxLen, [chunked, &step](Print *out) {
+			chunked->json.setOutput(out);
+			return step(chunked->json, chunked->state);
+		});
+	});
+	response->setCode(code);
+	response->addHeader("Cache-Control", "no-cache");
+	request->send(response);
+}
 
-		response->print(item);
+size_t WiFiManagerChunkWriter::write(uint8_t c) {
+	return write(&c, 1);
+}
 
-		item = FPSTR(HTTP_FORM_PARAM);
-		item.replace("{i}", "dns2");
-		item.replace("{n}", "dns2");
-		item.replace("{p}", "DNS2");
-		item.replace("{l}", "15");
-		item.replace("{v}", _sta_static_dns2.toString());
+size_t WiFiManagerChunkWriter::write(const uint8_t *data, size_t size) {
+	size_t count = std::min(size, _space - _length);
+	memcpy(_buffer + _length, data, count);
+	_length += count;
+	if (count < size) {
+		_carry.write(data + count, size - count);
+	}
+	return size;
+}
 
-		response->print(item);
+/** Drop the cached pages, responses still sending one keep it until they are done */
+void AsyncWiFiManager::_invalidatePages() {
+	WiFiManagerPagePtr released[PAGE_COUNT];
 
-		response->print("<br/>");
+	_claim();
+	for (int i = 0; i < PAGE_COUNT; i++) {
+		_pages[i].swap(released[i]);
 	}
+	_pageGeneration++;
+	_release();
+}
 
-	response->print(FPSTR(HTTP_FORM_END));
+/** Handle the reset page */
+void AsyncWiFiManager::handleReset(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
+	DEBUG_WM(F("Reset"));
 
-	String scanLink = String(FPSTR(HTTP_SCAN_LINK));
-	scanLink.replace("{s}", useStatic);
-	response->print(scanLink);
+	AsyncResponseStream *response = request->beginResponseStream("text/html");
 
+	response->print(_resetHead);
+	response->print(_scriptLink);
+	response->print(_styleLink);
+	response->print(_customHeadHTML);
+	response->print(FPSTR(HTTP_HEAD_END));
+	response->print(F("Module will reset in a few seconds."));
 	response->print(FPSTR(HTTP_END));
 
+	WM_STATS_ROUTE(ROUTE_RESET, start, response->available());
 	request->send(response);
 
-	DEBUG_WM(F("Sent config page"));
+	DEBUG_WM(F("Sent reset page"));
+	delay(5000);
+#if defined(ESP8266)
+	ESP.reset();
+#else
+    ESP.restart();
+#endif
+	delay(2000);
 }
 
-void AsyncWiFiManager::setRouterCredentials(const char *ssid, const char *pass) {
-	_router_ssid = ssid;
-	_router_pass = pass;
-}
+/** JSON list of the last scan, ?scan=1 starts a new one */
+void AsyncWiFiManager::handleApiScan(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
+	DEBUG_WM(F("API scan"));
 
-void AsyncWiFiManager::setAPCredentials(const char *ssid, const char *pass) {
-	_ap_ssid = ssid;
-	_ap_pass = pass;
-}
+	if (request->hasParam("scan")) {
+		_request(REQUEST_SCAN);
+	}
 
-/** Handle the WLAN save form and redirect to WLAN config page again */
-void AsyncWiFiManager::handleWifiSave(AsyncWebServerRequest *request) {
-	DEBUG_WM(F("WiFi save"));
+	sendChunkedJson(request, 200, WM_STATS_BYTES(ROUTE_API_SCAN), [this](AsyncWiFiManagerJsonWriter &json, WiFiManagerRenderState &state) {
+		return renderApiScanStep(json, state);
+	});
+	WM_STATS_ROUTE(ROUTE_API_SCAN, start, 0);	// The last chunk adds the length
+}
+
+/** Render the next piece of /api/scan, one network at a time. Returns false once it is complete. */
+bool AsyncWiFiManager::renderApiScanStep(AsyncWiFiManagerJsonWriter &json, WiFiManagerRenderState &state) {
+	enum {
+		STEP_HEAD, STEP_NETWORKS
+	};
+
+	switch (state.step) {
+	case STEP_HEAD:
+		json.beginObject();
+		json.add("scanning", _scanRunning || (_requests.load(std::memory_order_relaxed) & REQUEST_SCAN) != 0);
+		json.beginArray("networks");
+		state.scan = getScanSnapshot();
+		state.step = STEP_NETWORKS;
+		state.item = 0;
+		return true;
 
-	//SAVE/connect here
-	_refresh_info = true;
-	_router_ssid = request->arg("s").c_str();
-	_router_pass = request->arg("p").c_str();
+	default:
+		while (state.scan && state.item < state.scan->count) {
+			const WiFiResult &result = state.scan->results[state.item++];
+			if (result.duplicate == true) {
+				continue; // skip dups
+			}
 
-	//parameters
-	for (int i = 0; i < _paramsCount; i++) {
-		if (_params[i] == NULL) {
-			break;
+			char bssid[18];
+			formatBSSID(result.BSSID, bssid);
+
+			json.beginObject();
+			json.add("ssid", result.SSID);
+			json.add("bssid", bssid);
+			json.add("rssi", (long)result.RSSI);
+			json.add("quality", (long)getRSSIasQuality(result.RSSI));
+			json.add("channel", (long)result.channel);
+			json.add("secure", isSecure(result));
+			json.add("hidden", (bool)result.isHidden);
+			json.endObject();
+			return true;
 		}
-		//read parameter
-		String value = request->arg(_params[i]->getID()).c_str();
-		//store it in array
-		value.toCharArray(_params[i]->_value, _params[i]->_length);
-		DEBUG_WM(F("Parameter"));
-		DEBUG_WM(_params[i]->getID());
-		DEBUG_WM(value);
-	}
-
-	if (request->hasArg("ip")) {
-		DEBUG_WM(F("static ip"));
-		DEBUG_WM(request->arg("ip"));
-		//_sta_static_ip.fromString(request->arg("ip"));
-		String ip = request->arg("ip");
-		optionalIPFromString(&_sta_static_ip, ip.c_str());
-	}
-	if (request->hasArg("gw")) {
-		DEBUG_WM(F("static gateway"));
-		DEBUG_WM(request->arg("gw"));
-		String gw = request->arg("gw");
-		optionalIPFromString(&_sta_static_gw, gw.c_str());
-	}
-	if (request->hasArg("sn")) {
-		DEBUG_WM(F("static netmask"));
-		DEBUG_WM(request->arg("sn"));
-		String sn = request->arg("sn");
-		optionalIPFromString(&_sta_static_sn, sn.c_str());
-	}
-	if (request->hasArg("dns1")) {
-		DEBUG_WM(F("static DNS 1"));
-		DEBUG_WM(request->arg("dns1"));
-		String dns1 = request->arg("dns1");
-		optionalIPFromString(&_sta_static_dns1, dns1.c_str());
-	}
-	if (request->hasArg("dns2")) {
-		DEBUG_WM(F("static DNS 2"));
-		DEBUG_WM(request->arg("dns2"));
-		String dns2 = request->arg("dns2");
-		optionalIPFromString(&_sta_static_dns2, dns2.c_str());
+		state.scan.reset();
+		json.endArray();
+		json.endObject();
+		return false;
 	}
+}
 
-	AsyncResponseStream *response = request->beginResponseStream("text/html");
-
-	response->print(_wifiSaveHead);
-	response->print(FPSTR(HTTP_SCRIPT));
-	response->print(FPSTR(HTTP_STYLE));
-	response->print(_customHeadHTML);
-	response->print(F("<meta http-equiv=\"refresh\" content=\"15; url=/i\">"));
-	response->print(FPSTR(HTTP_HEAD_END));
-	response->print(FPSTR(HTTP_SAVED));
-	response->print(FPSTR(HTTP_END));
-
-	request->send(response);
-
-	DEBUG_WM(F("Sent wifi save page"));
+/** JSON version of the info page */
+void AsyncWiFiManager::handleApiInfo(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
+	DEBUG_WM(F("API info"));
 
-	_connect = true; //signal ready to connect/reset
+	sendChunkedJson(request, 200, WM_STATS_BYTES(ROUTE_API_INFO), [this](AsyncWiFiManagerJsonWriter &json, WiFiManagerRenderState &state) {
+		return renderApiInfoStep(json, state);
+	});
+	WM_STATS_ROUTE(ROUTE_API_INFO, start, 0);
 }
 
-/** Handle the info page */
-void AsyncWiFiManager::sendInfo(AsyncResponseStream *response) {
-	response->print(F("<dt>Chip ID</dt><dd>"));
-#if defined(ESP8266)
-	response->print(ESP.getChipId());
-#else
-  response->print(getESP32ChipID());
-#endif
-	response->print(F("</dd>"));
-	response->print(F("<dt>Flash Chip ID</dt><dd>"));
+/** Render the next piece of /api/info: the device, the telemetry, then the stats a route at a time */
+bool AsyncWiFiManager::renderApiInfoStep(AsyncWiFiManagerJsonWriter &json, WiFiManagerRenderState &state) {
+	enum {
+		STEP_DEVICE, STEP_TELEMETRY, STEP_STATS, STEP_ROUTES, STEP_END
+	};
+
+	switch (state.step) {
+	case STEP_DEVICE: {
+		json.beginObject();
 #if defined(ESP8266)
-	response->print(ESP.getFlashChipId());
+		json.add("chipId", (long)ESP.getChipId());
+		json.add("flashChipId", (long)ESP.getFlashChipId());
+		json.add("flashRealSize", (long)ESP.getFlashChipRealSize());
 #else
-  response->print(F("N/A for ESP32"));
+		json.add("chipId", getESP32ChipID());
 #endif
-	response->print(F("</dd>"));
-	response->print(F("<dt>IDE Flash Size</dt><dd>"));
-	response->print(ESP.getFlashChipSize());
-	response->print(F(" bytes</dd>"));
-	response->print(F("<dt>Real Flash Size</dt><dd>"));
+		json.add("flashSize", (long)ESP.getFlashChipSize());
+		json.add("softAPIP", WiFi.softAPIP());
+		json.add("softAPMac", WiFi.softAPmacAddress());
 #if defined(ESP8266)
-	response->print(ESP.getFlashChipRealSize());
+		struct softap_config conf_current;
+		wifi_softap_get_config(&conf_current);
+		json.add("apSSID", reinterpret_cast<char*>(conf_current.ssid));
 #else
-  response->print(F("N/A for ESP32"));
+		wifi_config_t conf_current;
+		esp_wifi_get_config(WIFI_IF_AP, &conf_current);
+		json.add("apSSID", reinterpret_cast<char*>(conf_current.ap.ssid));
 #endif
-	response->print(F(" bytes</dd>"));
-	response->print(F("<dt>Soft AP IP</dt><dd>"));
-	response->print(WiFi.softAPIP().toString());
-	response->print(F("</dd>"));
-	response->print(F("<dt>Soft AP MAC</dt><dd>"));
-	response->print(WiFi.softAPmacAddress());
-	response->print(F("</dd>"));
-	response->print(F("<dt>AP SSID</dt><dd>"));
-#if defined(ESP8266)
-	struct softap_config conf_current;
-	wifi_softap_get_config(&conf_current);
-	response->print(String(reinterpret_cast<char*>(conf_current.ssid)));
-#else
-  wifi_config_t conf_current;
-  esp_wifi_get_config(WIFI_IF_AP, &conf_current);
-  response->print(String(reinterpret_cast<char*>(conf_current.ap.ssid)));
+		json.add("ssid", WiFi.SSID());
+		json.add("stationIP", WiFi.localIP());
+		json.add("stationMac", WiFi.macAddress());
+		state.step = STEP_TELEMETRY;
+		return true;
+	}
+
+	case STEP_TELEMETRY:
+		writeTelemetry(json);
+		state.step = STEP_STATS;
+		return true;
+
+#ifdef WIFI_MANAGER_STATS
+	case STEP_STATS: {
+		AsyncWiFiManagerStats stats = getStats();
+		json.beginObject("stats");
+		json.add("loops", (long)stats.loops);
+		json.add("loopMaxMicros", (long)stats.loopMaxMicros);
+		json.add("loopMeanMicros", (long)(stats.loops > 0 ? stats.loopMicros / stats.loops : 0));
+		json.add("scans", (long)stats.scans);
+		json.add("scanMicros", (long)stats.scanMicros);
+		json.add("claims", (long)stats.claims);
+		json.add("claimWaitMicros", (long)stats.claimWaitMicros);
+		json.add("dnsPolls", (long)stats.dnsPolls);
+		json.add("dnsMicros", (long)stats.dnsMicros);
+		json.add("dnsRequests", (long)stats.dnsRequests);
+		json.beginObject("routes");
+		state.step = STEP_ROUTES;
+		state.item = 0;
+		return true;
+	}
+
+	case STEP_ROUTES:
+		if (state.item < AsyncWiFiManagerStats::ROUTE_COUNT) {
+			AsyncWiFiManagerStats::RouteStats route = getStats().routes[state.item];
+			json.beginObject(routeNames[state.item++]);
+			json.add("requests", (long)route.requests);
+			json.add("micros", (long)route.micros);
+			json.add("maxMicros", (long)route.maxMicros);
+			json.add("bytes", (long)route.bytes);
+			json.endObject();
+			return true;
+		}
+		json.endObject();
+		json.endObject();
+		state.step = STEP_END;
+		return true;
 #endif
-	response->print(F("</dd>"));
-	response->print(F("<dt>Network SSID</dt><dd>"));
-	response->print(WiFi.SSID());
-	response->print(F("</dd>"));
-	response->print(F("<dt>Station IP</dt><dd>"));
-	response->print(WiFi.localIP().toString());
-	response->print(F("</dd>"));
-	response->print(F("<dt>Station MAC</dt><dd>"));
-	response->print(WiFi.macAddress());
-	response->print(F("</dd>"));
-	response->print(F("</dl>"));
+
+	default:
+		json.endObject();
+		return false;
+	}
 }
 
-void AsyncWiFiManager::handleInfo(AsyncWebServerRequest *request) {
-	DEBUG_WM(F("Info"));
+void AsyncWiFiManager::writeStatus(AsyncWiFiManagerJsonWriter &json) {
+	json.beginObject();
+	json.add("ap", isAP());
+	json.add("connecting", _connect);
+	json.add("connected", WiFi.isConnected());
+	json.add("status", (long)WiFi.status());
+	json.add("ssid", WiFi.SSID());
+	json.add("ip", WiFi.localIP());
+	json.endObject();
+}
 
-	AsyncResponseStream *response = request->beginResponseStream("text/html");
+/** Same fields as /api/status, pushed to the portal pages whenever the connection state changes */
+void AsyncWiFiManager::_sendStatusEvent() {
+	if (_eventSource == NULL || _eventSource->count() == 0) {
+		return;
+	}
 
-	response->print(_infoHead);
-	response->print(FPSTR(HTTP_SCRIPT));
-	response->print(FPSTR(HTTP_STYLE));
-	response->print(_customHeadHTML);
-	if (_connect == true) {
-		response->print(F("<meta http-equiv=\"refresh\" content=\"5; url=/i\">"));
+	StreamString data;
+	AsyncWiFiManagerJsonWriter json(&data);
+	writeStatus(json);
+	_eventSource->send(data.c_str(), "status");
+}
+
+/** JSON connection status, for clients polling after a save */
+void AsyncWiFiManager::handleApiStatus(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
+	sendChunkedJson(request, 200, WM_STATS_BYTES(ROUTE_API_STATUS), [this](AsyncWiFiManagerJsonWriter &json, WiFiManagerRenderState &state) {
+		writeStatus(json);
+		return false;
+	});
+	WM_STATS_ROUTE(ROUTE_API_STATUS, start, 0);
+}
+
+/** Copy of the connection telemetry, consistent even while loop() is recording an event */
+WiFiManagerTelemetry AsyncWiFiManager::getTelemetry() {
+	_claim();
+	WiFiManagerTelemetry telemetry = _telemetry;
+	_release();
+
+	return telemetry;
+}
+
+static void writeHistogram(AsyncWiFiManagerJsonWriter &json, const char *key, const WiFiManagerHistogram &histogram) {
+	json.beginObject(key);
+	json.beginArray("counts");
+	for (int i = 0; i < WIFI_MANAGER_HISTOGRAM_BUCKETS; i++) {
+		json.add(NULL, (long)histogram.counts[i]);
 	}
-	response->print(FPSTR(HTTP_HEAD_END));
-	response->print(F("<dl>"));
-	if (_connect == true) {
-		response->print(F("<dt>Trying to connect</dt><dd>"));
-		response->print(WiFi.status());
-		response->print(F("</dd>"));
+	json.endArray();
+	json.add("count", (long)histogram.count);
+	json.add("sumMs", (long)histogram.sumMs);
+	json.endObject();
+}
+
+/** The "telemetry" object of /api/info */
+void AsyncWiFiManager::writeTelemetry(AsyncWiFiManagerJsonWriter &json) {
+	WiFiManagerTelemetry telemetry = getTelemetry();
+
+	json.beginObject("telemetry");
+	json.add("uptimeMs", (long)millis());
+	json.beginArray("boundsMs");	// Upper limits of the buckets, the last one has none
+	for (int i = 0; i < WIFI_MANAGER_HISTOGRAM_BUCKETS - 1; i++) {
+		json.add(NULL, (long)WiFiManagerHistogram::bound(i));
+	}
+	json.endArray();
+	writeHistogram(json, "associate", telemetry.associate);
+	writeHistogram(json, "dhcp", telemetry.dhcp);
+	writeHistogram(json, "total", telemetry.total);
+	json.add("disconnectCount", (long)telemetry.disconnectCount);
+	json.beginArray("disconnects");		// Most recent first
+	const WiFiManagerDisconnect *entry;
+	for (int i = 0; (entry = telemetry.disconnect(i)) != NULL; i++) {
+		json.beginObject();
+		json.add("ms", (long)entry->ms);
+		json.add("reason", (long)entry->reason);
+		json.add("rssi", (long)entry->rssi);
+		json.endObject();
 	}
+	json.endArray();
+	json.endObject();
+}
 
-	sendInfo(response);
+/** Milliseconds as seconds, the base unit of Prometheus, without trailing zeros: 250 is 0.25 */
+static void formatSeconds(char *buf, unsigned long ms) {
+	int length = snprintf(buf, 16, "%lu.%03lu", ms / 1000, ms % 1000);
+	while (buf[length - 1] == '0') {
+		length--;
+	}
+	if (buf[length - 1] == '.') {
+		length--;
+	}
+	buf[length] = 0;
+}
 
-	response->print(FPSTR(HTTP_END));
+static void sendHistogram(Print *out, const char *name, const char *help, const WiFiManagerHistogram &histogram) {
+	char seconds[16];
+	out->printf("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+	uint32_t cumulative = 0;
+	for (int i = 0; i < WIFI_MANAGER_HISTOGRAM_BUCKETS - 1; i++) {
+		cumulative += histogram.counts[i];
+		formatSeconds(seconds, WiFiManagerHistogram::bound(i));
+		out->printf("%s_bucket{le=\"%s\"} %lu\n", name, seconds, (unsigned long)cumulative);
+	}
+	out->printf("%s_bucket{le=\"+Inf\"} %lu\n", name, (unsigned long)histogram.count);
+	formatSeconds(seconds, histogram.sumMs);
+	out->printf("%s_sum %s\n%s_count %lu\n", name, seconds, name, (unsigned long)histogram.count);
+}
 
+/**
+ * Connection telemetry in the Prometheus text format, see setMetricsEndpoint(). Durations are in
+ * seconds. The disconnect log is only in /api/info: as labelled series, every disconnect would
+ * start a time series of its own.
+ */
+void AsyncWiFiManager::handleMetrics(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
+	WiFiManagerTelemetry telemetry = getTelemetry();
+	AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+	char seconds[16];
+
+	formatSeconds(seconds, millis());
+	response->printf("# HELP wifi_uptime_seconds_total Time since boot\n# TYPE wifi_uptime_seconds_total counter\n"
+			"wifi_uptime_seconds_total %s\n", seconds);
+	response->printf("# HELP wifi_rssi_dbm Signal strength of the router\n# TYPE wifi_rssi_dbm gauge\nwifi_rssi_dbm %d\n", (int)_lastRSSI);
+	sendHistogram(response, "wifi_associate_seconds", "WiFi.begin() to connected", telemetry.associate);
+	sendHistogram(response, "wifi_dhcp_seconds", "Connected to IP address", telemetry.dhcp);
+	sendHistogram(response, "wifi_connect_seconds", "WiFi.begin() to IP address", telemetry.total);
+	response->printf("# HELP wifi_disconnects_total Station disconnects since boot\n# TYPE wifi_disconnects_total counter\n"
+			"wifi_disconnects_total %lu\n", (unsigned long)telemetry.disconnectCount);
+
+	WM_STATS_ROUTE(ROUTE_METRICS, start, response->available());
 	request->send(response);
-
-	DEBUG_WM(F("Sent info page"));
 }
 
-/** Handle the reset page */
-void AsyncWiFiManager::handleReset(AsyncWebServerRequest *request) {
-	DEBUG_WM(F("Reset"));
+/** Same fields as the save form, answers with JSON instead of a page */
+void AsyncWiFiManager::handleApiSave(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
+	DEBUG_WM(F("API save"));
 
-	AsyncResponseStream *response = request->beginResponseStream("text/html");
+	AsyncWiFiManagerParameter *invalid = NULL;
+	bool valid = request->hasArg("s");
+	if (valid) {
+		invalid = saveCredentials(request);
+		valid = invalid == NULL;
+	}
+	const char *invalidID = invalid != NULL ? invalid->getID() : NULL;
+
+	sendChunkedJson(request, valid ? 200 : 400, WM_STATS_BYTES(ROUTE_API_SAVE), [valid, invalidID](AsyncWiFiManagerJsonWriter &json, WiFiManagerRenderState &state) {
+		json.beginObject();
+		json.add("saved", valid);
+		if (invalidID != NULL) {
+			json.add("error", "invalid");
+			json.add("param", invalidID);
+		} else if (!valid) {
+			json.add("error", "missing s");
+		}
+		json.endObject();
+		return false;
+	});
+	WM_STATS_ROUTE(ROUTE_API_SAVE, start, 0);
 
-	response->print(_resetHead);
-	response->print(FPSTR(HTTP_SCRIPT));
-	response->print(FPSTR(HTTP_STYLE));
-	response->print(_customHeadHTML);
-	response->print(FPSTR(HTTP_HEAD_END));
-	response->print(F("Module will reset in a few seconds."));
-	response->print(FPSTR(HTTP_END));
+	if (valid) {
+		_request(REQUEST_CONNECT); //signal ready to connect/reset
+	}
+}
 
-	request->send(response);
+/** Whether an Accept-Encoding value allows gzip: named or covered by *, and not with q=0 */
+static bool acceptsGzip(const char *acceptEncoding) {
+	const char *at = strstr(acceptEncoding, "gzip");
+	if (at == NULL) {
+		at = strchr(acceptEncoding, '*');
+	}
+	if (at == NULL) {
+		return false;
+	}
+	const char *end = strchr(at, ',');
+	const char *q = strstr(at, "q=");
+	return q == NULL || (end != NULL && q > end) || atof(q + 2) > 0;
+}
 
-	DEBUG_WM(F("Sent reset page"));
-	delay(5000);
-#if defined(ESP8266)
-	ESP.reset();
-#else
-    ESP.restart();
-#endif
-	delay(2000);
+/**
+ * Send a static asset, gzipped if the client accepts it, or 304 if the client already has this
+ * version. The two encodings have their own ETags. Without the plain copy, a client that rules
+ * out gzip gets 406.
+ */
+void AsyncWiFiManager::sendAsset(AsyncWebServerRequest *request, const WiFiManagerAsset &asset) {
+	WM_STATS_START(start);
+	AsyncWebServerResponse *response;
+
+	// No Accept-Encoding at all means any encoding will do, but the plain copy is the safer bet
+	AsyncWebHeader *acceptEncoding = request->getHeader("Accept-Encoding");
+	bool gzipAccepted = acceptEncoding == NULL || acceptsGzip(acceptEncoding->value().c_str());
+	if (asset.plain == NULL && !gzipAccepted) {
+		WM_STATS_ROUTE(ROUTE_ASSET, start, 0);
+		request->send(406, "text/plain", "Only available gzipped");
+		return;
+	}
+	bool gzip = asset.plain == NULL || (acceptEncoding != NULL && gzipAccepted);
+	const char *etag = gzip ? asset.gzipETag : asset.etag;
+
+	AsyncWebHeader *ifNoneMatch = request->getHeader("If-None-Match");
+	if (ifNoneMatch != NULL && ifNoneMatch->value() == etag) {
+		response = request->beginResponse(304);
+		WM_STATS_ROUTE(ROUTE_ASSET, start, 0);
+	} else if (gzip) {
+		response = request->beginResponse_P(200, asset.contentType, asset.gzip, asset.gzipLength);
+		response->addHeader("Content-Encoding", "gzip");
+		WM_STATS_ROUTE(ROUTE_ASSET, start, asset.gzipLength);
+	} else {
+		response = request->beginResponse_P(200, asset.contentType, asset.plain);
+		WM_STATS_ROUTE(ROUTE_ASSET, start, strlen_P(asset.plain));
+	}
+
+	response->addHeader("ETag", etag);
+	response->addHeader("Vary", "Accept-Encoding");
+	response->addHeader("Cache-Control", "public, max-age=31536000");
+	request->send(response);
 }
 
 //removed as mentioned here https://github.com/tzapu/AsyncWiFiManager/issues/114
@@ -1029,7 +3267,58 @@ void AsyncWiFiManager::handleReset(AsyncWebServerRequest *request) {
 
  }*/
 
+// Connectivity checks of the common OSes. Redirecting them to the portal makes the OS show its sign-in page.
+static const char *const captiveProbes[] = {
+	"/generate_204",				// Android, Chrome OS
+	"/gen_204",
+	"/hotspot-detect.html",			// Apple
+	"/library/test/success.html",
+	"/connecttest.txt",				// Windows
+	"/ncsi.txt",
+	"/redirect",
+	"/canonical.html",				// Firefox
+	"/success.txt"
+};
+
+static uint32_t probeLengths() {
+	uint32_t lengths = 0;
+	for (size_t i = 0; i < sizeof(captiveProbes) / sizeof(captiveProbes[0]); i++) {
+		lengths |= 1UL << strlen(captiveProbes[i]);	// All shorter than 32
+	}
+	return lengths;
+}
+
+// Bit n is set if some probe path is n characters long
+static const uint32_t captiveProbeLengths = probeLengths();
+
+/** Any path whose length no probe has is turned away by a single test */
+static bool isCaptiveProbe(const String &url) {
+	unsigned int length = url.length();
+	if (length >= 32 || (captiveProbeLengths & (1UL << length)) == 0) {
+		return false;
+	}
+
+	for (size_t i = 0; i < sizeof(captiveProbes) / sizeof(captiveProbes[0]); i++) {
+		if (strcmp(url.c_str(), captiveProbes[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void AsyncWiFiManager::handleNotFound(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
+
+	// Answered even while connecting, so that the OS shows the portal as soon as it can
+	if (isCaptiveProbe(request->url()) && ON_AP_FILTER(request)) {
+		AsyncWebServerResponse *response = request->beginResponse(302);
+		response->addHeader("Location", _portalUrl);
+		response->addHeader("Cache-Control", "no-store");
+		WM_STATS_ROUTE(ROUTE_PROBE, start, 0);
+		request->send(response);
+		return;
+	}
+
 	DEBUG_WM(F("Handle not found"));
 
 	if (_connect) {
@@ -1064,21 +3353,27 @@ void AsyncWiFiManager::handleNotFound(AsyncWebServerRequest *request) {
 		response->print("\n");
 	}
 
+	WM_STATS_ROUTE(ROUTE_NOT_FOUND, start, response->available());
 	request->send(response);
 }
 
 /** Redirect to captive portal if we got a request for another domain. Return true in that case so the page handler do not try to handle the request again. */
 bool AsyncWiFiManager::captivePortal(AsyncWebServerRequest *request) {
+	WM_STATS_START(start);
 	if (!isIp(request->host())) {
 	DEBUG_WM(request->url());
 	DEBUG_WM(F("Request redirected to captive portal, AP IP="));
 	DEBUG_WM(WiFi.softAPIP());
 	DEBUG_WM(F("Client IP="));
 	DEBUG_WM(request->client()->localIP());
+		IPAddress ip = request->client()->localIP();
+		char location[23];
+		snprintf(location, sizeof(location), "http://%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+
 		AsyncWebServerResponse *response = request->beginResponse(302,
 				"text/html", "");
-		response->addHeader("Location",
-				String("http://") + toStringIp(request->client()->localIP()));
+		response->addHeader("Location", location);
+		WM_STATS_ROUTE(ROUTE_REDIRECT, start, 0);
 		request->send(response);
 		return true;
 	}
@@ -1097,72 +3392,176 @@ void AsyncWiFiManager::setSaveConfigCallback(void (*func)(void)) {
 
 #ifdef ESP8266
 void AsyncWiFiManager::onStationIP(const WiFiEventStationModeGotIP& evt) {
-	_claim();
-	_loop_call_connected = true;
-	_release();
+	_post(WiFiManagerEvent::STA_GOT_IP);
 	DEBUG_WM(toStringIp(evt.ip));
 }
 
 void AsyncWiFiManager::onConnected(const WiFiEventStationModeConnected& evt) {
 	DEBUG_WM(F("Connected"));
-	_claim();
-	_connectRetryTimeout = 0;
-	_release();
+	_post(WiFiManagerEvent::STA_CONNECTED);
 }
 
 void AsyncWiFiManager::onDisconnected(const WiFiEventStationModeDisconnected& evt) {
 	DEBUG_WM(F("Disconnected"));
-	_claim();
-	_lastConnectTime = millis();
-	_connectRetryTimeout = 10000;	// ms
-	_release();
+	_post(WiFiManagerEvent::STA_DISCONNECTED, evt.reason);
 }
 #else
 void AsyncWiFiManager::onStationIP(WiFiEvent_t event, WiFiEventInfo_t info) {
-	_claim();
-	_loop_call_connected = true;
-	_release();
+	_post(WiFiManagerEvent::STA_GOT_IP);
 	DEBUG_WM(toStringIp(WiFi.localIP()));
 }
 
 void AsyncWiFiManager::onConnected(WiFiEvent_t event, WiFiEventInfo_t info) {
 	DEBUG_WM(F("Connected"));
-	_claim();
-	_connectRetryTimeout = 0;
-	_release();
+	_post(WiFiManagerEvent::STA_CONNECTED);
 }
 
 void AsyncWiFiManager::onDisconnected(WiFiEvent_t event, WiFiEventInfo_t info) {
 	DEBUG_WM(F("Disconnected"));
-	_claim();
-	_lastConnectTime = millis();
-	_connectRetryTimeout = 10000;	// ms
-	_release();
+#if ESP_ARDUINO_VERSION_MAJOR >= 2
+	_post(WiFiManagerEvent::STA_DISCONNECTED, info.wifi_sta_disconnected.reason);
+#else
+	_post(WiFiManagerEvent::STA_DISCONNECTED, info.disconnected.reason);
+#endif
 }
 #endif
 
-//start up connected callback
-void AsyncWiFiManager::setConnectedCallback(void (*func)(void)) {
-	_connectedcallback = func;
 #ifdef ESP8266
-	stationGotIPHandler = WiFi.onStationModeGotIP(std::bind(&AsyncWiFiManager::onStationIP, this, std::placeholders::_1));
+AsyncWiFiManager *AsyncWiFiManager::_wpsManager = NULL;
+
+void AsyncWiFiManager::onWPSStatus(int status) {
+	if (_wpsManager != NULL) {
+		_wpsManager->_post(WiFiManagerEvent::WPS_DONE, status);	// WPS_CB_ST_SUCCESS is 0
+	}
+}
 #else
+void AsyncWiFiManager::onWPS(WiFiEvent_t event, WiFiEventInfo_t info) {
+	DEBUG_WM(F("WPS event"));
 #if ESP_ARDUINO_VERSION_MAJOR >= 2
-	stationGotIPHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onStationIP, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WIFI_STA_GOT_IP);
+	_post(WiFiManagerEvent::WPS_DONE, event == ARDUINO_EVENT_WPS_ER_SUCCESS ? 0 : 1);
 #else
-	stationGotIPHandler = WiFi.onEvent(std::bind(&AsyncWiFiManager::onStationIP, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_GOT_IP);
+	_post(WiFiManagerEvent::WPS_DONE, event == SYSTEM_EVENT_STA_WPS_ER_SUCCESS ? 0 : 1);
+#endif
+}
+#endif
+
+/**
+ * Get the router credentials with the WPS push button: press the button on the router within
+ * timeout ms. Returns at once and loop() carries on, the portal stays up meanwhile. The credentials
+ * are then used as if saved from the portal: the manager connects with them, and calls the save
+ * callback once that has succeeded or timed out. Returns false if WPS couldn't be started, or while
+ * a connection attempt or WPS is already in progress.
+ */
+bool AsyncWiFiManager::startWPS(unsigned long timeout) {
+	if (_wpsRunning || _connect || _startState == START_CONNECTING) {
+		return false;
+	}
+	DEBUG_WM(F("Starting WPS"));
+
+	_registerGotIP();
+	WiFi.enableSTA(true);
+#ifdef ESP8266
+	wifi_station_disconnect();		// WiFi.disconnect() would also erase the saved credentials
+	_wpsManager = this;
+	wifi_wps_disable();
+	bool started = wifi_wps_enable(WPS_TYPE_PBC) && wifi_set_wps_cb(&AsyncWiFiManager::onWPSStatus) && wifi_wps_start();
+#else
+	if (!_wpsRegistered) {
+		_wpsRegistered = true;
+#if ESP_ARDUINO_VERSION_MAJOR >= 2
+		WiFi.onEvent(std::bind(&AsyncWiFiManager::onWPS, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WPS_ER_SUCCESS);
+		WiFi.onEvent(std::bind(&AsyncWiFiManager::onWPS, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WPS_ER_FAILED);
+		WiFi.onEvent(std::bind(&AsyncWiFiManager::onWPS, this, std::placeholders::_1, std::placeholders::_2), ARDUINO_EVENT_WPS_ER_TIMEOUT);
+#else
+		WiFi.onEvent(std::bind(&AsyncWiFiManager::onWPS, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_WPS_ER_SUCCESS);
+		WiFi.onEvent(std::bind(&AsyncWiFiManager::onWPS, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_WPS_ER_FAILED);
+		WiFi.onEvent(std::bind(&AsyncWiFiManager::onWPS, this, std::placeholders::_1, std::placeholders::_2), SYSTEM_EVENT_STA_WPS_ER_TIMEOUT);
+#endif
+	}
+	WiFi.disconnect();
+	esp_wps_config_t config = WPS_CONFIG_INIT_DEFAULT(ESP_WPS_MODE);
+	esp_wifi_wps_disable();
+	bool started = esp_wifi_wps_enable(&config) == ESP_OK && esp_wifi_wps_start(0) == ESP_OK;
+#endif
+
+	if (!started) {
+		DEBUG_WM(F("WPS failed to start"));
+#ifdef ESP8266
+		wifi_wps_disable();
+#else
+		esp_wifi_wps_disable();
+#endif
+		_connectRetryTimeout = 1;	// Back to the saved credentials on the next loop()
+		return false;
+	}
+
+	_wpsRunning = true;
+	_wpsStartMs = millis();
+	_wpsTimeout = timeout;
+	return true;
+}
+
+bool AsyncWiFiManager::isWPSRunning() {
+	return _wpsRunning;
+}
+
+/** Called from loop() when WPS has completed, failed or timed out */
+void AsyncWiFiManager::_finishWPS(bool success) {
+	if (!_wpsRunning) {
+		return;
+	}
+	_wpsRunning = false;
+
+#ifdef ESP8266
+	wifi_wps_disable();
+#else
+	esp_wifi_wps_disable();
 #endif
+
+	if (!success) {
+		DEBUG_WM(F("WPS failed"));
+		_lastConnectTime = millis();
+		_connectRetryTimeout = 1;	// Back to the saved credentials on the next loop()
+		return;
+	}
+
+	DEBUG_WM(F("WPS succeeded"));
+	// The SDK has stored the credentials it received in the station configuration
+#ifdef ESP8266
+	setRouterCredentials(WiFi.SSID().c_str(), WiFi.psk().c_str());
+#else
+	wifi_config_t conf;
+	esp_wifi_get_config(WIFI_IF_STA, &conf);
+	char ssid[33];
+	char pass[65];
+	snprintf(ssid, sizeof(ssid), "%.*s", (int)sizeof(conf.sta.ssid), reinterpret_cast<char*>(conf.sta.ssid));
+	snprintf(pass, sizeof(pass), "%.*s", (int)sizeof(conf.sta.password), reinterpret_cast<char*>(conf.sta.password));
+	setRouterCredentials(ssid, pass);
 #endif
+	_request(REQUEST_CONNECT); //signal ready to connect, as a portal save does
+}
+
+//start up connected callback
+void AsyncWiFiManager::setConnectedCallback(void (*func)(void)) {
+	_connectedcallback = func;
+	_registerGotIP();
+}
+
+//called when an asynchronous start or a portal connect completes
+void AsyncWiFiManager::setStartCallback(void (*func)(bool connected)) {
+	_startcallback = func;
 }
 
 //sets a custom element to add to head, like a new style tag
 void AsyncWiFiManager::setCustomHeadHTML(const char *element) {
 	_customHeadHTML = element;
+	_invalidatePages();
 }
 
 //sets a custom element to add to options page
 void AsyncWiFiManager::setCustomOptionsHTML(const char *element) {
 	_customOptionsHTML = element;
+	_invalidatePages();
 }
 
 //if this is true, remove duplicated Access Points - defaut true
@@ -1192,10 +3591,9 @@ int AsyncWiFiManager::getRSSIasQuality(int RSSI) {
 }
 
 /** Is this an IP? */
-bool AsyncWiFiManager::isIp(String str) {
-	for (int i = 0; i < str.length(); i++) {
-		int c = str.charAt(i);
-		if (c != '.' && (c < '0' || c > '9')) {
+bool AsyncWiFiManager::isIp(const String &str) {
+	for (const char *c = str.c_str(); *c != 0; c++) {
+		if (*c != '.' && (*c < '0' || *c > '9')) {
 			return false;
 		}
 	}
@@ -1211,3 +3609,86 @@ String AsyncWiFiManager::toStringIp(IPAddress ip) {
 	res += String(((ip >> 8 * 3)) & 0xFF);
 	return res;
 }
+
+void AsyncWiFiManagerJsonWriter::beginObject(const char *key) {
+	_key(key);
+	_out->print('{');
+	_first = true;
+}
+
+void AsyncWiFiManagerJsonWriter::endObject() {
+	_out->print('}');
+	_first = false;
+}
+
+void AsyncWiFiManagerJsonWriter::beginArray(const char *key) {
+	_key(key);
+	_out->print('[');
+	_first = true;
+}
+
+void AsyncWiFiManagerJsonWriter::endArray() {
+	_out->print(']');
+	_first = false;
+}
+
+void AsyncWiFiManagerJsonWriter::add(const char *key, const char *value) {
+	_key(key);
+	_string(value);
+}
+
+void AsyncWiFiManagerJsonWriter::add(const char *key, const String &value) {
+	add(key, value.c_str());
+}
+
+void AsyncWiFiManagerJsonWriter::add(const char *key, long value) {
+	_key(key);
+	_out->print(value);
+}
+
+void AsyncWiFiManagerJsonWriter::add(const char *key, bool value) {
+	_key(key);
+	_out->print(value ? F("true") : F("false"));
+}
+
+void AsyncWiFiManagerJsonWriter::add(const char *key, IPAddress value) {
+	char ip[16];
+	formatIP(value, ip);
+	add(key, ip);
+}
+
+/** Separator and key of the next member, the key is omitted for array elements */
+void AsyncWiFiManagerJsonWriter::_key(const char *key) {
+	if (!_first) {
+		_out->print(',');
+	}
+	_first = false;
+
+	if (key != NULL) {
+		_string(key);
+		_out->print(':');
+	}
+}
+
+void AsyncWiFiManagerJsonWriter::_string(const char *str) {
+	_out->print('"');
+	while (*str != 0) {
+		// Write runs of plain characters in one go, escape the rest
+		size_t run = 0;
+		while (str[run] != 0 && str[run] != '"' && str[run] != '\\' && (uint8_t)str[run] >= 0x20) {
+			run++;
+		}
+		_out->write((const uint8_t *)str, run);
+		str += run;
+
+		if (*str == '"' || *str == '\\') {
+			_out->print('\\');
+			_out->print(*str++);
+		} else if (*str != 0) {
+			char escaped[7];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", *str++);
+			_out->print(escaped);
+		}
+	}
+	_out->print('"');
+}
@@ -15,7 +15,10 @@
 #else
 #include <DNSServer.h>
 #endif
+#include "CaptiveDNSServer.h"
+#include <StreamString.h>
 #include <memory>
+#include <atomic>
 
 // fix crash on ESP32 (see https://github.com/alanswx/ESPAsyncWiFiManager/issues/44)
 #if defined(ESP8266)
@@ -34,20 +37,39 @@ extern "C" {
 
 const char WFM_HTTP_HEAD[] PROGMEM
 		= "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>{v}</title>";
-const char HTTP_STYLE[] PROGMEM
-		= "<style>.c{text-align: center;} div,input{padding:5px;font-size:1em;} input{width:95%;} body{text-align: center;font-family:verdana;} button{border:0;border-radius:0.3rem;background-color:#1fa3ec;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;} .q{float: right;width: 64px;text-align: right;} .l{background: url(\"data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAALVBMVEX///8EBwfBwsLw8PAzNjaCg4NTVVUjJiZDRUUUFxdiZGSho6OSk5Pg4eFydHTCjaf3AAAAZElEQVQ4je2NSw7AIAhEBamKn97/uMXEGBvozkWb9C2Zx4xzWykBhFAeYp9gkLyZE0zIMno9n4g19hmdY39scwqVkOXaxph0ZCXQcqxSpgQpONa59wkRDOL93eAXvimwlbPbwwVAegLS1HGfZAAAAABJRU5ErkJggg==\") no-repeat left center;background-size: 1em;}</style>";
-const char HTTP_SCRIPT[] PROGMEM
-		= "<script>function c(l){document.getElementById('s').value=l.innerText||l.textContent;document.getElementById('p').focus();};function t(){var x=document.getElementById('p');if(x.type === 'password'){x.type='text';}else{x.type='password';}}</script>";
+// A static asset served from flash, generated from web/ by tools/build_assets.py. Only the gzipped
+// copy is served, plain is NULL unless the library is built with WIFI_MANAGER_PLAIN_ASSETS. The
+// minified text is declared as HTTP_STYLE_CSS, HTTP_SCRIPT_JS and HTTP_EVENTS_SCRIPT_JS for sketches
+// that print it themselves. HTTP_STYLE and HTTP_SCRIPT keep their old value, the same text in <style>
+// and <script> elements. None of them takes flash unless used.
+class WiFiManagerAsset {
+public:
+	const char *contentType;
+	PGM_P plain;
+	const uint8_t *gzip;
+	size_t gzipLength;
+	const char *etag;		// Hash of the plain text, also used in the asset URLs
+	const char *gzipETag;
+};
+
+// /wm.css, /wm.js and /wme.js, so that clients only fetch them once (see sendAsset)
+#include "AsyncWiFiManagerAssets.h"
+
 const char HTTP_HEAD_END[] PROGMEM
 		= "</head><body><div style='text-align:left;display:inline-block;min-width:260px;'>";
 const char HTTP_PORTAL_OPTIONS[] PROGMEM
 		= "<a href=\"/wifi?static=0\"><button>Configure WiFi</button></a><p/><a href=\"/wifi?static=1\"><button>Configure Static WiFi</button></a><p/><a href=\"/i\"><button>Info</button></a><p/><form action=\"/r\" method=\"post\"><button>Reset</button></form>";
-const char HTTP_ITEM[]
-		= "<div><a href='#p' onclick='c(this)'>%s</a>&nbsp;<span class='q %c'>%d%</span></div>";
+const char HTTP_ITEM[] PROGMEM
+		= "<div id='{b}'><a href='#p' onclick='c(this)'>{v}</a>&nbsp;<span class='q {l}'>{q}%</span></div>";
 const char HTTP_FORM_START[] PROGMEM
 		= "<form method='get' action='wifisave'><input id='s' name='s' autocapitalize='none' length=32 placeholder='SSID'><br/><input id='p' name='p' length=64 type='password' placeholder='password'><p><input type='checkbox' style='width:auto' onclick='t()'><label for='p'>Show Password</label><br>";
 const char HTTP_FORM_PARAM[] PROGMEM
 		= "<br/><label for='{i}'>{p}</label><input id='{i}' name='{n}' length={l} value='{v}' {c}>";
+const char HTTP_FORM_SELECT[] PROGMEM
+		= "<br/><label for='{i}'>{p}</label><select id='{i}' name='{n}'>";
+const char HTTP_FORM_OPTION[] PROGMEM = "<option{s}>{v}</option>";
+const char HTTP_INVALID[] PROGMEM
+		= "<div>Invalid value for {p}<br/><a href='/wifi'>Back</a></div>";
 const char HTTP_FORM_END[] PROGMEM
 		= "<br/><button type='submit'>save</button></form>";
 const char HTTP_SCAN_LINK[] PROGMEM
@@ -58,46 +80,387 @@ const char HTTP_SAVED[] PROGMEM
 		= "<div>Credentials Saved<br />Trying to connect ESP to network.<br />If it fails reconnect to AP to try again</div>";
 const char HTTP_END[] PROGMEM = "</div></body></html>";
 
-#define WIFI_MANAGER_MAX_PARAMS 10
+#ifndef WIFI_MANAGER_ARENA_CHUNK
+#define WIFI_MANAGER_ARENA_CHUNK 256		// Parameter values are allocated from blocks of this size
+#endif
+
+// Bump allocator for parameter values: one heap block per WIFI_MANAGER_ARENA_CHUNK bytes of values
+// instead of one per parameter. Parameters live as long as the program, so nothing is ever freed.
+class AsyncWiFiManagerArena {
+public:
+	char* allocate(size_t size);
+
+	static AsyncWiFiManagerArena& values();
+private:
+	char *_next = NULL;
+	size_t _free = 0;
+};
 
 class AsyncWiFiManagerParameter {
 public:
+	// Everything but STRING is kept in binary, checked when the form is saved and formatted for the form
+	enum Type : uint8_t {
+		STRING, INT, FLOAT, BOOL, IP, ENUM
+	};
+
 	AsyncWiFiManagerParameter(const char *custom);
 	AsyncWiFiManagerParameter(const char *id, const char *placeholder,
 			const char *defaultValue, int length);
 	AsyncWiFiManagerParameter(const char *id, const char *placeholder,
 			const char *defaultValue, int length, const char *custom);
+	// Numbers: the three values must have the same type, so ("t", "T", 1.5, 0.0, 10.0) rather than
+	// ("t", "T", 1.5, 0, 10), which matches both of these and doesn't compile
+	AsyncWiFiManagerParameter(const char *id, const char *placeholder,
+			int defaultValue, int min, int max);
+	AsyncWiFiManagerParameter(const char *id, const char *placeholder,
+			double defaultValue, double min, double max);
+	AsyncWiFiManagerParameter(const char *id, const char *placeholder,
+			bool defaultValue);
+	AsyncWiFiManagerParameter(const char *id, const char *placeholder,
+			IPAddress defaultValue);
+	AsyncWiFiManagerParameter(const char *id, const char *placeholder,
+			const char *const *options, uint8_t optionCount, uint8_t defaultOption);
 
 	const char* getID();
 	const char* getValue();
 	const char* getPlaceholder();
 	int getValueLength();
 	const char* getCustomHTML();
+
+	Type getType();
+	int getInt();
+	float getFloat();
+	bool getBool();
+	IPAddress getIP();
+	uint8_t getOption();
 private:
+	union Value {
+		int32_t i;		// INT, BOOL and the ENUM option index
+		float f;
+		uint32_t ip;
+	};
+
 	const char *_id;
 	const char *_placeholder;
 	char *_value;
 	int _length;
 	const char *_customHTML;
+	Type _type = STRING;
+	Value _data;
+	Value _min;
+	Value _max;
+	const char *const *_options = NULL;
+	uint8_t _optionCount = 0;
 
 	void init(const char *id, const char *placeholder, const char *defaultValue,
 			int length, const char *custom);
+	void initTyped(const char *id, const char *placeholder, Type type);
+	bool parse(const char *text, Value &value);
+	size_t storedSize();
 
 	friend class AsyncWiFiManager;
 };
 
+#ifndef WIFI_MANAGER_MAX_SCAN_RESULTS
+#define WIFI_MANAGER_MAX_SCAN_RESULTS 32	// Strongest networks kept from each scan, after removing duplicates
+#endif
+#define WIFI_MANAGER_SCAN_BUFFERS 2			// Front buffer published to readers, back buffer being filled
+
+// Packed, self-contained copy of one scan entry: 43 bytes, nothing points into driver memory
 class WiFiResult {
 public:
-	bool duplicate;
-	String SSID;
+	char SSID[33];
+	uint8_t BSSID[6];
+	int8_t RSSI;
+	uint8_t channel;
 	uint8_t encryptionType;
-	int32_t RSSI;
-	uint8_t *BSSID;
-	int32_t channel;
-	bool isHidden;
+	bool duplicate:1;		// Never set since duplicates are left out of the buffer, kept for sketches that test it
+	bool isHidden:1;
+};
+static_assert(sizeof(WiFiResult) == 43, "WiFiResult layout changed, update the memory figures");
 
-	WiFiResult() {
+// One complete scan, about 1.4 KB with the default capacity. The manager allocates
+// WIFI_MANAGER_SCAN_BUFFERS of these while the portal is up and reuses them for every scan.
+// Published to readers as an immutable, reference counted snapshot.
+class WiFiScanResults {
+public:
+	wifi_ssid_count_t count;
+	WiFiResult results[WIFI_MANAGER_MAX_SCAN_RESULTS];
+};
+
+typedef std::shared_ptr<const WiFiScanResults> WiFiScanSnapshot;
+
+#define WIFI_MANAGER_CONFIG_MAGIC 0x4D57		// "WM"
+
+// Header of each of the two EEPROM slots holding the saved parameter values, which follow it.
+// The CRC comes first and covers the rest of the header and the values.
+class WiFiManagerConfigHeader {
+public:
+	uint32_t crc;
+	uint16_t magic;
+	uint16_t version;	// Set by the application, a record with another version is ignored
+	uint32_t sequence;	// The valid slot with the higher sequence is the current one
+	uint16_t length;	// Bytes of values after the header
+	uint16_t reserved;
+};
+static_assert(sizeof(WiFiManagerConfigHeader) == 16, "WiFiManagerConfigHeader must not have padding");
+
+#ifndef WIFI_MANAGER_DNS_BATCH
+#define WIFI_MANAGER_DNS_BATCH 16		// Most queries the built-in DNS responder answers per loop()
+#endif
+
+#ifndef WIFI_MANAGER_MAX_NETWORKS
+#define WIFI_MANAGER_MAX_NETWORKS 4		// Router credentials kept for connection attempts
+#endif
+
+// Stored router credentials and how connecting with them went so far
+class WiFiCredential {
+public:
+	String ssid;
+	String pass;
+	uint8_t successes = 0;
+	uint8_t failures = 0;				// Since the last success
+	unsigned long connectMs = 0;		// WiFi.begin() to IP address on the last success
+};
+
+// A portal save as decoded by the web handler, held under _claim() until loop() applies it
+class WiFiManagerPendingSave {
+public:
+	bool pending = false;
+	String ssid;
+	String pass;
+	IPAddress staticIPs[5];			// ip, gw, sn, dns1, dns2
+	uint8_t staticSet = 0;			// Bit per address given as a valid address in the form
+	bool store = false;				// Write the parameters to the parameter store
+};
+
+#ifndef WIFI_MANAGER_RTC_OFFSET
+#define WIFI_MANAGER_RTC_OFFSET 120		// ESP8266 RTC user memory block of the fast connect cache (the last 8 of 128)
+#endif
+#ifndef WIFI_MANAGER_FAST_CONNECT_TIMEOUT
+#define WIFI_MANAGER_FAST_CONNECT_TIMEOUT 2000	// Give up on the cached AP and lease after this many ms
+#endif
+
+// Last good connection: which AP it was and the lease it got. Kept in RTC memory, which survives
+// deep sleep and resets but not power loss, so a wake can skip the channel scan and DHCP. 32 bytes.
+class WiFiFastConnect {
+public:
+	uint32_t key;			// Hash of the SSID and password it belongs to
+	uint32_t ip;
+	uint32_t gateway;
+	uint32_t subnet;
+	uint32_t dns;
+	uint8_t bssid[6];
+	uint8_t channel;
+	uint8_t reserved;
+	uint32_t crc;			// Over everything above, zero means invalid
+};
+
+#ifndef WIFI_MANAGER_EVENT_QUEUE
+#define WIFI_MANAGER_EVENT_QUEUE 8		// WiFi events buffered between two loop() calls, a power of two up to 128
+#endif
+static_assert((WIFI_MANAGER_EVENT_QUEUE & (WIFI_MANAGER_EVENT_QUEUE - 1)) == 0 && WIFI_MANAGER_EVENT_QUEUE <= 128,
+		"WIFI_MANAGER_EVENT_QUEUE must be a power of two up to 128");
+
+#ifndef WIFI_MANAGER_WPS_TIMEOUT
+#define WIFI_MANAGER_WPS_TIMEOUT 120000		// The push button walk time of the WPS spec
+#endif
+
+// A station event, as posted by the WiFi callbacks
+class WiFiManagerEvent {
+public:
+	enum Type : uint8_t {
+		STA_CONNECTED,
+		STA_DISCONNECTED,
+		STA_GOT_IP,
+		WPS_DONE
+	};
+
+	Type type;
+	uint8_t reason;			// Disconnect reason from the SDK, for WPS_DONE 0 on success
+	unsigned long ms;		// millis() when it happened
+};
+
+// Lock-free ring with a single producer, the WiFi callbacks, and a single consumer, loop().
+// Each side only ever stores its own index, so atomic loads and stores are all it needs.
+class WiFiManagerEventQueue {
+public:
+	bool push(const WiFiManagerEvent &event);
+	bool pop(WiFiManagerEvent &event);
+private:
+	WiFiManagerEvent _events[WIFI_MANAGER_EVENT_QUEUE];
+	std::atomic<uint8_t> _head{0};	// Next slot to fill, producer only
+	std::atomic<uint8_t> _tail{0};	// Next slot to read, consumer only
+};
+
+#ifndef WIFI_MANAGER_DISCONNECT_LOG
+#define WIFI_MANAGER_DISCONNECT_LOG 8		// Most recent station disconnects kept by the telemetry
+#endif
+#define WIFI_MANAGER_HISTOGRAM_BUCKETS 9	// Up to 100, 250, 500 ms, 1, 2, 4, 8, 16 s and longer
+
+// Counts of connection phase durations in fixed buckets, see WiFiManagerTelemetry
+class WiFiManagerHistogram {
+public:
+	uint32_t counts[WIFI_MANAGER_HISTOGRAM_BUCKETS];
+	uint32_t count;
+	uint32_t sumMs;
+
+	void add(unsigned long ms);
+	static unsigned long bound(int bucket);		// Upper limit of a bucket in ms, 0 for the last one
+};
+
+// A station disconnect as reported by the SDK
+class WiFiManagerDisconnect {
+public:
+	uint32_t ms;		// millis() when it happened
+	uint8_t reason;		// Disconnect reason from the SDK
+	int8_t rssi;		// Last signal strength sampled while connected, 0 if it wasn't
+};
+
+// How connecting went, see AsyncWiFiManager::getTelemetry(). Only the attempts the manager starts with
+// WiFi.begin() are timed, reconnects of the SDK itself are not. About 300 bytes.
+class WiFiManagerTelemetry {
+public:
+	WiFiManagerHistogram associate;		// WiFi.begin() to connected
+	WiFiManagerHistogram dhcp;			// Connected to IP address
+	WiFiManagerHistogram total;			// WiFi.begin() to IP address
+	WiFiManagerDisconnect disconnects[WIFI_MANAGER_DISCONNECT_LOG];	// Ring, see disconnect()
+	uint32_t disconnectCount;			// Since boot, the ring holds the last of these
+
+	void addDisconnect(unsigned long ms, uint8_t reason, int8_t rssi);
+	const WiFiManagerDisconnect* disconnect(int age) const;	// 0 is the most recent, NULL past the oldest kept
+};
+
+#ifdef WIFI_MANAGER_STATS
+// What the manager costs, compiled in with -DWIFI_MANAGER_STATS. Times are in microseconds.
+class AsyncWiFiManagerStats {
+public:
+	enum Route : uint8_t {
+		ROUTE_ROOT,
+		ROUTE_WIFI,
+		ROUTE_WIFI_SAVE,
+		ROUTE_INFO,
+		ROUTE_RESET,
+		ROUTE_ASSET,		// /wm.css and /wm.js
+		ROUTE_API_SCAN,
+		ROUTE_API_INFO,
+		ROUTE_API_STATUS,
+		ROUTE_API_SAVE,
+		ROUTE_METRICS,		// /metrics on the station interface
+		ROUTE_REDIRECT,		// Captive portal redirects
+		ROUTE_PROBE,		// OS connectivity probes
+		ROUTE_NOT_FOUND,
+		ROUTE_COUNT
+	};
+
+	class RouteStats {
+	public:
+		uint32_t requests;
+		uint32_t micros;		// Rendering, in total
+		uint32_t maxMicros;
+		uint32_t bytes;			// Response bodies, in total
+	};
+
+	uint32_t loops;
+	uint32_t loopMaxMicros;
+	uint64_t loopMicros;		// In total, divide by loops for the mean
+	uint32_t scans;
+	uint32_t scanMicros;		// Starting scans and collecting their results
+	uint32_t claims;
+	uint32_t claimWaitMicros;	// Waiting for the lock in _claim(), always 0 on ESP8266
+	uint32_t dnsPolls;			// DNS server calls from loop()
+	uint32_t dnsRequests;		// Queries taken by the built-in responder, see setCaptiveDNS()
+	uint32_t dnsMicros;
+	RouteStats routes[ROUTE_COUNT];
+};
+#endif
+
+#ifndef WIFI_MANAGER_PAGE_SLACK
+#define WIFI_MANAGER_PAGE_SLACK 256		// Added to the last length of a page for the buffer of the next render
+#endif
+
+// A rendered portal page and its ETag, shared with the responses still sending it
+class WiFiManagerPage {
+public:
+	StreamString body;
+	String etag;
+};
+
+typedef std::shared_ptr<const WiFiManagerPage> WiFiManagerPagePtr;
+
+// How far a page has been rendered, so the next chunk of a chunked response carries on from there
+class WiFiManagerRenderState {
+public:
+	uint8_t step = 0;
+	int item = 0;
+	WiFiScanSnapshot scan;		// The list is sent from one scan even if another completes meanwhile
+};
+
+// A chunked page being sent: the render state and what didn't fit into the previous chunk
+class WiFiManagerChunkedPage {
+public:
+	WiFiManagerRenderState state;
+	StreamString carry;
+	size_t carried = 0;		// Bytes of carry already sent
+	bool done = false;
+	size_t sent = 0;
+	uint32_t *bytes = NULL;	// Route counter the body length is added to after the last chunk, NULL without WIFI_MANAGER_STATS
+};
+
+// Prints into a response buffer, whatever doesn't fit goes to the carry of the page
+class WiFiManagerChunkWriter : public Print {
+public:
+	WiFiManagerChunkWriter(uint8_t *buffer, size_t space, StreamString &carry)
+		: _buffer(buffer), _space(space), _carry(carry) {
 	}
+
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *data, size_t size) override;
+	size_t length() {
+		return _length;
+	}
+	bool full() {
+		return _length == _space;
+	}
+private:
+	uint8_t *_buffer;
+	size_t _space;
+	size_t _length = 0;
+	StreamString &_carry;
+};
+
+// Minimal JSON writer that prints straight into a response, so no document is built in memory
+class AsyncWiFiManagerJsonWriter {
+public:
+	AsyncWiFiManagerJsonWriter(Print *out = NULL) : _out(out) {
+	}
+
+	// Carry on the same document in another output, the next chunk of a chunked response
+	void setOutput(Print *out) {
+		_out = out;
+	}
+
+	void beginObject(const char *key = NULL);
+	void endObject();
+	void beginArray(const char *key = NULL);
+	void endArray();
+	void add(const char *key, const char *value);
+	void add(const char *key, const String &value);
+	void add(const char *key, long value);
+	void add(const char *key, bool value);
+	void add(const char *key, IPAddress value);
+private:
+	Print *_out;
+	bool _first = true;
+
+	void _key(const char *key);
+	void _string(const char *str);
+};
+
+// A chunked JSON response being sent, the writer keeps its place in the document between chunks
+class WiFiManagerChunkedJson : public WiFiManagerChunkedPage {
+public:
+	AsyncWiFiManagerJsonWriter json;
 };
 
 class AsyncWiFiManager {
@@ -107,10 +470,22 @@ public:
 #else
 	AsyncWiFiManager(AsyncWebServer * server, DNSServer *dns);
 #endif
-	~AsyncWiFiManager() {}
+	~AsyncWiFiManager() {
+		delete[] _params;
+		delete[] _paramIndex;
+	}
+
+	enum StartState {
+		START_IDLE,			// Not started yet
+		START_CONNECTING,	// Waiting for the router connection
+		START_CONNECTED,	// Connected to the router
+		START_PORTAL		// Timed out, the config portal is up
+	};
 
 	void loop();
 	bool start();
+	void startAsync();
+	StartState getStartState();
 	void connect();
 
 	void setHostname(const char* hostname);
@@ -128,10 +503,27 @@ public:
 
 	void setSaveConfigCallback(void (*func)(void));
 	void setConnectedCallback(void (*func)(void));
+	void setStartCallback(void (*func)(bool connected));
 	void setConnectTimeout(unsigned long timeout);
+	void setConnectRetryBackoff(unsigned long initialMs, unsigned long maxMs, uint8_t jitterPercent = 0);
+	void setFastReconnect(bool enable);
+	void setCaptiveDNS(bool enable);
+	void setPageCache(bool enable);
+	void setChunkedPages(bool enable);
+	void setParameterStore(size_t offset, uint16_t version);
+	bool loadParameters();
+	bool saveParameters();
+	size_t configStoreSize();
+	void setServerEvents(bool enable);
+	bool startWPS(unsigned long timeout = WIFI_MANAGER_WPS_TIMEOUT);
+	bool isWPSRunning();
+	WiFiManagerTelemetry getTelemetry();
+	void setMetricsEndpoint(bool enable);
 	void setAPCallback(void (*func)(AsyncWiFiManager *myAsyncWiFiManager));
 
 	void setRouterCredentials(const char* ssid, const char* pass);
+	void addRouterCredentials(const char* ssid, const char* pass);
+	void clearRouterCredentials();
 	void setAPCredentials(const char* ssid, const char* pass);
 
 	void stopConfigPortal(int timeoutMs=1);
@@ -140,6 +532,9 @@ public:
 	bool isAP();
 
 	void dumpInfo();
+#ifdef WIFI_MANAGER_STATS
+	AsyncWiFiManagerStats getStats();
+#endif
 
 private:
 	bool _debug = false;
@@ -149,9 +544,38 @@ private:
 	void _setupConfigPortal();
 	wl_status_t _connectWiFi();
 	void _scanNetworks();
+	void _collectScan();
 	bool _start();
+	void _beginStart();
+	void _registerGotIP();
+	void _startConnect();
+	bool _startFinish();
+	void _pollStart(unsigned long now);
+	unsigned long _nextRetryDelay();
+	void _rankNetworks(bool primaryFirst);
+	long _scoreNetwork(const WiFiCredential &network, const WiFiScanSnapshot &scan);
+	void _nextCandidate();
+	void _checkCandidate(unsigned long now);
+	void _checkConnected();
+	bool _beginFastConnect(const char *ssid, const char *pass, wl_status_t &status);
+	void _checkFastConnect(unsigned long now);
+	void _saveFastConnect();
+	void _useDHCP();
+	void _post(WiFiManagerEvent::Type type, uint8_t reason = 0);
+	void _request(uint8_t request);
+	uint8_t _takeRequests();
+	void _processRequests(unsigned long now);
+	void _processEvents();
+	void _processEvent(const WiFiManagerEvent &event);
 	void _claim();
 	void _release();
+#ifdef WIFI_MANAGER_STATS
+	void _countLoop(unsigned long start);
+	void _countRoute(AsyncWiFiManagerStats::Route route, unsigned long start, size_t bytes);
+	void sendStats(Print *out);
+
+	AsyncWiFiManagerStats _stats{};
+#endif
 	void _cacheHeads();
 
 	AsyncWebServer *server;
@@ -163,17 +587,58 @@ private:
 
     unsigned long _connectTimeout = 0;	// After initial connect attempt, wait this long for a connection to be created - can prevent creation of AP
     unsigned long _connectRetryTimeout = 0;
+    unsigned long _retryInitial = 10000;	// Reconnect backoff, see setConnectRetryBackoff()
+    unsigned long _retryMax = 10000;
+    uint8_t _retryJitter = 0;				// Percent
+    uint8_t _retryAttempts = 0;				// Failed attempts since the last connection
     unsigned long _apOffTimeout = 0;
     unsigned long _lastConnectTime = 0;
     unsigned long _lastLoopTime = 0;
 
     bool _connect = false;			// Config Portal requested connection
+	StartState _startState = START_IDLE;
+	unsigned long _startMs = 0;		// When the current connection attempt began
+	bool _startSave = false;		// Call the save callback when the pending connect completes
+	bool _loop_call_connected = false;	// call the connected callback from loop() - avoids re-entrancy issues
+	bool _connectAgain = false;		// A save or connect() arrived during the pending start, see _pollStart()
+	WiFiManagerPendingSave _pendingSave;	// Written by the save handlers under _claim(), applied by loop()
+	bool _staGotIP = false;			// Station has an IP address, set from the WiFi event
+
+	// Work posted to loop() by other tasks. Everything else is only touched from loop() and needs no lock.
+	enum {
+		REQUEST_EVENTS = 1,			// WiFi events waiting in _events
+		REQUEST_CONNECT = 2,		// Connect with the saved credentials
+		REQUEST_SCAN = 4,
+		REQUEST_AP = 8				// Start or stop the portal, see _apRequest
+	};
+	std::atomic<uint8_t> _requests{0};
+	std::atomic<int> _apRequest{-1};	// Next _loop_ap_state
+	WiFiManagerEventQueue _events;
+	bool _gotIPRegistered = false;
 	bool _isAP = false;				// True if AP is enabled
 	int _loop_ap_state = -1;
-	bool _loop_scan = false;
+	bool _scanRunning = false;		// An async scan has been started and not yet collected
+	bool _scanThenConnect = false;	// Reconnect to the router once the scan has been collected
 	bool _dnsRunning = false;		// Make calls to dns server idempotent
-	String _router_ssid;
-	String _router_pass;
+	bool _useCaptiveDNS = false;	// See setCaptiveDNS()
+	CaptiveDNSServer *_captiveDNS = NULL;	// Only while the portal is up
+	WiFiCredential _networks[WIFI_MANAGER_MAX_NETWORKS];	// Primary first, then backups
+	int _networkCount = 0;
+	int8_t _candidates[WIFI_MANAGER_MAX_NETWORKS];		// Network indexes in the order they are tried
+	int _candidateIdx = 0;
+	int _attemptNetwork = -1;		// Network of the current attempt, until it has an IP
+	bool _attemptPending = false;	// A connection attempt is waiting for its IP address
+	unsigned long _attemptMs = 0;
+	unsigned long _gotIPMs = 0;		// When the station got its IP address, set from the WiFi event
+	bool _associated = false;		// Station is connected to an AP, may not have an IP address yet
+	unsigned long _associatedMs = 0;
+	int8_t _lastRSSI = 0;			// Sampled once a second while connected, for the disconnect log
+	unsigned long _rssiSampleMs = 0;
+	WiFiManagerTelemetry _telemetry{};	// Written by loop(), copied under _claim() by getTelemetry()
+	bool _fastReconnect = false;	// See setFastReconnect()
+	bool _fastAttempt = false;		// The current attempt uses the cached AP and lease
+	bool _fastLease = false;		// The cached lease is configured as a static IP
+	uint32_t _attemptKey = 0;		// Credential hash of the current attempt
 	String _ap_ssid;
 	String _ap_pass;
 
@@ -185,8 +650,30 @@ private:
 	AsyncWebHandler* iApHandler;
 	AsyncWebHandler* rApHandler;
 	AsyncWebHandler* fwLinkApHandler;
+	AsyncWebHandler* cssApHandler;
+	AsyncWebHandler* jsApHandler;
+	AsyncWebHandler* eventsJsApHandler;
+	AsyncEventSource* _eventSource = NULL;	// /events, while the portal is up and setServerEvents() is on
+	bool _useEvents = false;
+	AsyncWebHandler* apiScanApHandler;
+	AsyncWebHandler* apiInfoApHandler;
+	AsyncWebHandler* apiStatusApHandler;
+	AsyncWebHandler* apiSaveApHandler;
+	AsyncWebHandler* metricsStaHandler = NULL;	// /metrics, see setMetricsEndpoint()
 	
-	bool   _refresh_info = true;	// Refresh the info HTML when true
+	// Rendered pages, see setPageCache(). Swapped under _claim() since handlers run in another task.
+	enum CachedPage {
+		PAGE_ROOT,
+		PAGE_INFO,
+		PAGE_WIFI,
+		PAGE_WIFI_STATIC,
+		PAGE_COUNT
+	};
+	bool _pageCache = false;
+	bool _chunkedPages = false;
+	WiFiManagerPagePtr _pages[PAGE_COUNT];
+	uint32_t _pageGeneration = 0;	// Bumped by _invalidatePages(), so that stale renders aren't kept
+	size_t _pageLengths[PAGE_COUNT] = {};	// Of the last render, so the next one gets a buffer it fits in
 	String _customHeadHTML;
 	String _customOptionsHTML;
 	String _wifiSaveHead;
@@ -194,6 +681,10 @@ private:
 	String _rootHead;
 	String _infoHead;
 	String _resetHead;
+	String _portalUrl;				// Where connectivity probes are sent, set when the AP comes up
+	String _styleLink;
+	String _scriptLink;
+	String _eventsLink;
 
 	IPAddress _ap_static_ip;
 	IPAddress _ap_static_gw;
@@ -204,7 +695,29 @@ private:
 	IPAddress _sta_static_dns1= (uint32_t)0x00000000;
 	IPAddress _sta_static_dns2= (uint32_t)0x00000000;
 
-	void sendInfo(AsyncResponseStream *response);
+	void sendInfo(Print *out);
+	void sendPage(AsyncWebServerRequest *request, CachedPage page);
+	void sendChunkedPage(AsyncWebServerRequest *request, CachedPage page, uint32_t *bytes);
+	void renderPage(CachedPage page, Print *out);
+	bool renderStep(CachedPage page, Print *out, WiFiManagerRenderState &state);
+	void renderRoot(Print *out);
+	void renderInfo(Print *out);
+	bool renderWifiStep(Print *out, bool useStatic, WiFiManagerRenderState &state);
+	void _invalidatePages();
+	void _sendScanEvent(const WiFiScanSnapshot &previous, const WiFiScanSnapshot &current);
+	void _sendStatusEvent();
+	void writeStatus(AsyncWiFiManagerJsonWriter &json);
+	template<typename Step>
+	void sendChunkedJson(AsyncWebServerRequest *request, int code, uint32_t *bytes, Step step);
+	bool renderApiScanStep(AsyncWiFiManagerJsonWriter &json, WiFiManagerRenderState &state);
+	bool renderApiInfoStep(AsyncWiFiManagerJsonWriter &json, WiFiManagerRenderState &state);
+	void writeTelemetry(AsyncWiFiManagerJsonWriter &json);
+	void _recordEvent(const WiFiManagerEvent &event);
+	bool isListed(const WiFiResult &result);
+	void sendTemplate(Print *out, PGM_P tmpl, const char *keys, const char *const values[]);
+	void sendFormParam(Print *out, const char *id, const char *placeholder, int length, const char *value, const char *custom);
+	void sendIPParam(Print *out, const char *id, const char *placeholder, IPAddress ip);
+	void sendAsset(AsyncWebServerRequest *request, const WiFiManagerAsset &asset);
 
 	void handleRoot(AsyncWebServerRequest*);
 	void handleWifi(AsyncWebServerRequest*);
@@ -212,6 +725,13 @@ private:
 	void handleInfo(AsyncWebServerRequest*);
 	void handleReset(AsyncWebServerRequest*);
 	void handleNotFound(AsyncWebServerRequest*);
+	void handleApiScan(AsyncWebServerRequest*);
+	void handleApiInfo(AsyncWebServerRequest*);
+	void handleApiStatus(AsyncWebServerRequest*);
+	void handleApiSave(AsyncWebServerRequest*);
+	void handleMetrics(AsyncWebServerRequest*);
+	AsyncWiFiManagerParameter* saveCredentials(AsyncWebServerRequest*);
+	void _applySave();
 	void handle204(AsyncWebServerRequest*);
 	bool captivePortal(AsyncWebServerRequest*);
 	void dnsStart(bool start);
@@ -219,35 +739,46 @@ private:
 	void onStationIP(const WiFiEventStationModeGotIP& evt);
 	void onConnected(const WiFiEventStationModeConnected& evt);
 	void onDisconnected(const WiFiEventStationModeDisconnected& evt);
+	static void onWPSStatus(int status);
+	static AsyncWiFiManager *_wpsManager;	// The SDK callback has no context argument
 #else
 	SemaphoreHandle_t loopMutex;
 	void onStationIP(WiFiEvent_t event, WiFiEventInfo_t info);
 	void onConnected(WiFiEvent_t event, WiFiEventInfo_t info);
 	void onDisconnected(WiFiEvent_t event, WiFiEventInfo_t info);
+	void onWPS(WiFiEvent_t event, WiFiEventInfo_t info);
+	bool _wpsRegistered = false;
 #endif
+	bool _wpsRunning = false;		// See startWPS()
+	unsigned long _wpsStartMs = 0;
+	unsigned long _wpsTimeout = 0;
+	void _finishWPS(bool success);
 
 	// DNS server
 	const byte DNS_PORT = 53;
+	const uint32_t DNS_TTL = 5;
 
-	// Scanned WiFi access point SSIDs
-	WiFiResult *wifiSSIDs = 0;
-	wifi_ssid_count_t wifiSSIDCount = 0;
+	// Scanned WiFi access point SSIDs, swapped under _claim() since handlers read it from other tasks
+	WiFiScanSnapshot wifiSSIDs;
+	std::shared_ptr<WiFiScanResults> _scanBuffers[WIFI_MANAGER_SCAN_BUFFERS];
 	bool _removeDuplicateAPs = true;
 	int  _minimumQuality     = -1;
 	bool shouldscan          = false;
 
-	void          sendNetworkList(AsyncResponseStream *response);
+	void          sendNetworkItem(Print *out, const WiFiResult &result);
 	static int    getRSSIasQuality(int RSSI);
-	static bool   isIp(String str);
+	static bool   isIp(const String &str);
 	static String toStringIp(IPAddress ip);
-	void          copySSIDInfo(wifi_ssid_count_t n);
+	bool          copySSIDInfo(wifi_ssid_count_t n);
+	WiFiScanResults *getScanBackBuffer();
+	WiFiScanSnapshot getScanSnapshot();
 
 	void (*_apcallback)(AsyncWiFiManager*) = NULL;	// Call when AP mode state changes
 
 	void (*_savecallback)(void) = NULL;				// Call when ConfigPortal saves data
 
-    bool _loop_call_connected = false;					// call the connected callback when true - avoids re-entrancy issues
 	void (*_connectedcallback)(void) = NULL;		// Call when we have an IP address
+	void (*_startcallback)(bool) = NULL;			// Call when an asynchronous start or a portal connect completes
 #ifdef ESP8266
 	WiFiEventHandler stationGotIPHandler;
 	WiFiEventHandler stationConnectedHandler;
@@ -258,21 +789,27 @@ private:
 	WiFiEventId_t stationDisconnectedHandler;
 #endif
 
+	// Grows as parameters are added; _paramIndex holds the positions of the ones with an ID, sorted by ID
 	int _paramsCount = 0;
-	AsyncWiFiManagerParameter *_params[WIFI_MANAGER_MAX_PARAMS];
+	int _paramsCapacity = 0;
+	AsyncWiFiManagerParameter **_params = NULL;
+	int _paramIndexCount = 0;
+	uint16_t *_paramIndex = NULL;
+
+	int _findParameter(const char *id);
+	AsyncWiFiManagerParameter* _validateParameters(AsyncWebServerRequest *request);
+	void sendTypedParam(Print *out, AsyncWiFiManagerParameter *param);
+
+	// Parameter values in EEPROM, two slots of _storeSlotSize bytes from _storeOffset
+	bool _store = false;
+	size_t _storeOffset = 0;
+	uint16_t _storeVersion = 0;
+	size_t _storeLength();
+	size_t _storeSlotSize();
+	int _storeCurrentSlot(WiFiManagerConfigHeader &header);
+	bool _storeReady();
 
 	template<typename Generic> void DEBUG_WM(Generic text);
-
-	template<class T>
-	auto optionalIPFromString(T *obj, const char *s) ->
-			decltype( obj->fromString(s) ) {
-		return obj->fromString(s);
-	}
-	auto optionalIPFromString(...) -> bool {
-		DEBUG_WM(
-				"NO fromString METHOD ON IPAddress, you need ESP8266 core 2.1.0 or newer for Custom IP configuration to work.");
-		return false;
-	}
 };
 
 #endif
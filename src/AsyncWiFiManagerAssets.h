@@ -0,0 +1,135 @@
+// Generated by tools/build_assets.py from the sources in web/, do not edit
+#ifndef AsyncWiFiManagerAssets_h
+#define AsyncWiFiManagerAssets_h
+
+// Served from /wm.css, 653 bytes, 494 gzipped
+const char HTTP_STYLE_CSS[] PROGMEM
+		= ".c{text-align:center}div,input{padding:5px;font-size:1em}input{width:95%}body{text-align:center;font"
+		"-family:verdana}button{border:0;border-radius:0.3rem;background-color:#1fa3ec;color:#fff;line-height"
+		":2.4rem;font-size:1.2rem;width:100%}.q{float:right;width:64px;text-align:right}.l{background:url(\"da"
+		"ta:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAALVBMVEX///8EBwfBwsLw8PAzNjaCg4NT"
+		"VVUjJiZDRUUUFxdiZGSho6OSk5Pg4eFydHTCjaf3AAAAZElEQVQ4je2NSw7AIAhEBamKn97/uMXEGBvozkWb9C2Zx4xzWykBhFAe"
+		"Yp9gkLyZE0zIMno9n4g19hmdY39scwqVkOXaxph0ZCXQcqxSpgQpONa59wkRDOL93eAXvimwlbPbwwVAegLS1HGfZAAAAABJRU5E"
+		"rkJggg==\") no-repeat left center;background-size:1em}";
+const char HTTP_STYLE[] PROGMEM
+		= "<style>.c{text-align:center}div,input{padding:5px;font-size:1em}input{width:95%}body{text-align:cent"
+		"er;font-family:verdana}button{border:0;border-radius:0.3rem;background-color:#1fa3ec;color:#fff;line"
+		"-height:2.4rem;font-size:1.2rem;width:100%}.q{float:right;width:64px;text-align:right}.l{background:"
+		"url(\"data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAALVBMVEX///8EBwfBwsLw8PAzN"
+		"jaCg4NTVVUjJiZDRUUUFxdiZGSho6OSk5Pg4eFydHTCjaf3AAAAZElEQVQ4je2NSw7AIAhEBamKn97/uMXEGBvozkWb9C2Zx4xzW"
+		"ykBhFAeYp9gkLyZE0zIMno9n4g19hmdY39scwqVkOXaxph0ZCXQcqxSpgQpONa59wkRDOL93eAXvimwlbPbwwVAegLS1HGfZAAAA"
+		"ABJRU5ErkJggg==\") no-repeat left center;background-size:1em}</style>";
+#ifdef WIFI_MANAGER_PLAIN_ASSETS
+#define HTTP_STYLE_PLAIN HTTP_STYLE_CSS
+#else
+#define HTTP_STYLE_PLAIN NULL
+#endif
+const uint8_t HTTP_STYLE_GZ[] PROGMEM = {
+		0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x65,0x92,0x6f,0x6f,0xa2,0x40,0x10,0xc6,0xbf,0x8a,
+		0xe9,0xa5,0xc9,0x5d,0x52,0x10,0x15,0x6d,0xc1,0xf4,0x05,0x50,0x6a,0xb5,0xfe,0xa7,0x50,0xcb,0xbb,0x85,
+		0x5d,0x96,0x15,0xd8,0xc5,0x75,0x15,0xd4,0xf0,0xdd,0x2b,0xd5,0xdc,0x99,0xdc,0xbe,0xd9,0x99,0x79,0xf2,
+		0x4c,0x7e,0x93,0x19,0x39,0x3c,0x09,0x54,0x0a,0x09,0xa4,0x04,0x53,0x3d,0x44,0x54,0x20,0x5e,0x41,0xb2,
+		0x7f,0x20,0x34,0xdf,0x89,0x53,0x0e,0x20,0x24,0x14,0xeb,0xdd,0xbc,0xec,0x47,0x8c,0x0a,0x69,0x4b,0x8e,
+		0x48,0x6f,0xa1,0xac,0xba,0xe8,0x05,0x81,0x22,0xd6,0xb5,0xee,0x7d,0x15,0x30,0x78,0xf8,0xbf,0xd5,0xc5,
+		0x14,0x81,0x8c,0xa4,0x07,0x7d,0x8f,0x38,0x04,0x14,0x54,0xc1,0x4e,0x08,0x46,0x4f,0x01,0xe3,0x10,0x71,
+		0x5d,0xe9,0x5f,0x02,0x89,0x03,0x48,0x76,0x5b,0x5d,0x91,0x3b,0x1c,0x65,0xfd,0x00,0x84,0x09,0xe6,0x6c,
+		0x47,0xa1,0x14,0xb2,0x94,0x71,0xfd,0x57,0x2b,0x02,0x1d,0x14,0xf6,0xaf,0x59,0x14,0x45,0xfd,0x94,0x50,
+		0x24,0xc5,0x88,0xe0,0x58,0xe8,0x6d,0x59,0xad,0x6d,0x37,0x90,0x72,0xbb,0x2e,0x5c,0x08,0x5b,0x8a,0x72,
+		0x5f,0xc9,0x9b,0x53,0x94,0x32,0x20,0x74,0x5e,0x3b,0xae,0x4a,0x4f,0x3d,0x8f,0x76,0xc3,0xfd,0xa3,0x55,
+		0x72,0x7a,0xfa,0x07,0xa0,0xef,0x78,0xfa,0xfb,0x0e,0x02,0x01,0x74,0x92,0x01,0x8c,0x9a,0x39,0xc5,0x67,
+		0xbe,0x2d,0xea,0xa9,0x0f,0xc4,0x33,0x67,0xcb,0x42,0x79,0x1f,0x60,0x66,0x9c,0xdf,0xd4,0x71,0x63,0xdb,
+		0xc5,0xe7,0xc8,0xaa,0x53,0x03,0x5b,0xc6,0xe4,0xfc,0x99,0x76,0x3e,0xe4,0x83,0xba,0x30,0xf6,0xcc,0x89,
+		0x67,0xaf,0x9a,0xcd,0xe6,0x93,0x6d,0x16,0x91,0x59,0x6c,0xc7,0xc5,0xd3,0xdc,0x38,0x4e,0xd7,0xc0,0xc2,
+		0xea,0xf4,0xc3,0xf3,0xdc,0xf5,0x88,0xf8,0x2f,0x4b,0xd7,0x75,0x5f,0x4b,0x48,0xfc,0x81,0x13,0xb3,0xde,
+		0xcc,0x49,0xba,0x73,0xac,0xa2,0xd7,0x03,0x7c,0xfb,0xb0,0xd6,0x20,0xea,0xd4,0xbd,0x7c,0x3b,0xb5,0x17,
+		0xde,0x42,0x5d,0xa3,0xf6,0xd4,0x29,0x1e,0x8d,0xa1,0x11,0xdb,0x26,0xc8,0xde,0xa9,0xf6,0xd8,0xdc,0x4d,
+		0x56,0xf6,0xc0,0xdc,0xb3,0x63,0xf2,0x19,0x68,0x56,0xdb,0x2f,0xd5,0xf2,0xf8,0x79,0x48,0xcc,0xf8,0xd5,
+		0x40,0x5f,0xb9,0x86,0x93,0xf1,0xc1,0xb7,0x95,0xe3,0x70,0x42,0x99,0x46,0x55,0xdc,0xd2,0xe2,0x0c,0x7e,
+		0x75,0xb4,0x6d,0x58,0x6c,0xbc,0x64,0xb6,0x02,0x65,0x1e,0x2b,0xbe,0xb5,0x5a,0x84,0x9b,0xd2,0xc9,0xf1,
+		0x22,0x9f,0x4d,0x41,0x57,0x2b,0x92,0xe5,0xcb,0x6c,0xac,0x75,0x90,0xb1,0xda,0x93,0xac,0x48,0x83,0x79,
+		0x50,0x14,0x9e,0x81,0xf0,0xd8,0x69,0xbd,0x0d,0x22,0xff,0x67,0x64,0x73,0xb4,0x74,0xbb,0x36,0x4f,0x46,
+		0x18,0xe3,0xe7,0xe7,0xbb,0x3f,0x0d,0xca,0x24,0x8e,0x72,0x04,0x44,0x23,0x45,0x91,0x68,0x5c,0x0f,0xe3,
+		0x66,0xbf,0x7f,0x6f,0xea,0x1b,0x82,0xb6,0x63,0xff,0x8d,0x02,0x00,0x00
+};
+const WiFiManagerAsset HTTP_STYLE_ASSET = { "text/css", HTTP_STYLE_PLAIN, HTTP_STYLE_GZ, sizeof(HTTP_STYLE_GZ), "\"de9ac70c\"", "\"de9ac70c-gz\"" };
+
+// Served from /wm.js, 226 bytes, 156 gzipped
+const char HTTP_SCRIPT_JS[] PROGMEM
+		= "function c(l){document.getElementById('s').value=l.innerText||l.textContent;document.getElementById("
+		"'p').focus();}function t(){var x=document.getElementById('p');if(x.type==='password'){x.type='text';"
+		"}else{x.type='password';}}";
+const char HTTP_SCRIPT[] PROGMEM
+		= "<script>function c(l){document.getElementById('s').value=l.innerText||l.textContent;document.getElem"
+		"entById('p').focus();}function t(){var x=document.getElementById('p');if(x.type==='password'){x.type"
+		"='text';}else{x.type='password';}}</script>";
+#ifdef WIFI_MANAGER_PLAIN_ASSETS
+#define HTTP_SCRIPT_PLAIN HTTP_SCRIPT_JS
+#else
+#define HTTP_SCRIPT_PLAIN NULL
+#endif
+const uint8_t HTTP_SCRIPT_GZ[] PROGMEM = {
+		0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x7d,0x8e,0x31,0x0e,0xc3,0x20,0x10,0x04,0xbf,0xe2,
+		0x0e,0x68,0xf8,0x00,0xa2,0x71,0x94,0x22,0x7d,0x3e,0x80,0xe0,0x88,0x90,0x08,0x20,0x38,0x1c,0x5b,0x98,
+		0xbf,0x07,0x4b,0x89,0xbb,0xa4,0xda,0xd3,0xee,0x8e,0x6e,0x6d,0x0d,0x1a,0x5d,0x0c,0x93,0xa6,0x9e,0x35,
+		0x13,0x75,0x7d,0x42,0x40,0xfe,0x00,0xbc,0x7a,0x38,0xce,0x79,0xbb,0x19,0x4a,0x0a,0x61,0x7c,0x51,0xbe,
+		0x82,0xf4,0xdc,0x85,0x00,0xf9,0x0e,0x2b,0xee,0xbb,0xe7,0x38,0xf4,0x12,0x03,0x8e,0xa6,0xf8,0x49,0xa7,
+		0x41,0xdb,0x11,0x16,0xca,0x44,0xb7,0xdf,0x8f,0x48,0x59,0x5b,0x54,0x9e,0x56,0xf9,0x0f,0x14,0xce,0xd2,
+		0x95,0xe3,0x96,0x40,0x4a,0x49,0x92,0x2a,0xe5,0x15,0xb3,0x21,0xac,0x7d,0x4c,0x72,0x2c,0x20,0xa2,0x83,
+		0x2f,0x70,0x7a,0x67,0x4d,0xf4,0xfe,0x06,0xa5,0xac,0x77,0x34,0xe2,0x00,0x00,0x00
+};
+const WiFiManagerAsset HTTP_SCRIPT_ASSET = { "application/javascript", HTTP_SCRIPT_PLAIN, HTTP_SCRIPT_GZ, sizeof(HTTP_SCRIPT_GZ), "\"2602bdbb\"", "\"2602bdbb-gz\"" };
+
+// Served from /wme.js when server-sent events are on, 1176 bytes, 586 gzipped
+const char HTTP_EVENTS_SCRIPT_JS[] PROGMEM
+		= "var e=new EventSource('/events');function g(i){return document.getElementById(i);}function q(x){retu"
+		"rn parseInt(x.lastChild.textContent);}function p(l,x){var c=l.firstChild;while(c&&!(c.id&&q(c)<q(x))"
+		"){c=c.nextSibling;}l.insertBefore(x,c);}e.addEventListener('scan',function(m){var d=JSON.parse(m.dat"
+		"a),l=g('n'),z=g('nn');if(!l){return;}d.removed.forEach(function(b){var x=g(b);if(x){l.removeChild(x)"
+		";}});d.changed.forEach(function(n){var x=g(n.b);if(x){x.lastChild.textContent=n.q+'%';l.removeChild("
+		"x);p(l,x);}});d.added.forEach(function(n){if(g(n.b)){return;}var x=document.createElement('div');x.i"
+		"d=n.b;x.innerHTML=\"<a href='#p' onclick='c(this)'></a>&nbsp;<span class='q\"+(n.l?\" l\":\"\")+\"'></span>"
+		"\";x.firstChild.textContent=n.s;x.lastChild.textContent=n.q+'%';p(l,x);if(z){z.style.display='none';}"
+		"});});e.addEventListener('status',function(m){var d=JSON.parse(m.data),x;if(x=g('st')){x.textContent"
+		"=d.status;}if(x=g('ip')){x.textContent=d.ip;}if(x=g('ss')){x.textContent=d.ssid;}});document.addEven"
+		"tListener('DOMContentLoaded',function(){var a=document.querySelector(\"a[href*='scan=1']\");if(a&&wind"
+		"ow.fetch){a.onclick=function(){fetch('/api/scan?scan=1');return false;};}});";
+#ifdef WIFI_MANAGER_PLAIN_ASSETS
+#define HTTP_EVENTS_SCRIPT_PLAIN HTTP_EVENTS_SCRIPT_JS
+#else
+#define HTTP_EVENTS_SCRIPT_PLAIN NULL
+#endif
+const uint8_t HTTP_EVENTS_SCRIPT_GZ[] PROGMEM = {
+		0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x8d,0x54,0xcb,0x6e,0xdb,0x30,0x10,0xfc,0x15,0x45,
+		0x45,0x45,0xb2,0x31,0x18,0xf4,0x5a,0x5a,0x09,0x90,0x34,0x40,0x53,0x24,0xcd,0xc1,0xbd,0x15,0x3d,0xd0,
+		0xe4,0xca,0x26,0x4a,0x53,0x32,0x49,0xdb,0x72,0x0c,0xfd,0x7b,0x56,0x0f,0x3f,0xd0,0x38,0x68,0x01,0xc3,
+		0xa0,0xec,0x9d,0x99,0x9d,0xd9,0x15,0xd7,0xd2,0x27,0x90,0x3b,0xd8,0x24,0xf7,0x6b,0x70,0x71,0x52,0xae,
+		0xbc,0x02,0x4a,0xae,0xa0,0x7d,0x0a,0x84,0x89,0x62,0xe5,0x54,0x34,0xa5,0x4b,0x66,0xd4,0xb0,0x9d,0x87,
+		0xb8,0xf2,0x2e,0xd1,0xa5,0x5a,0x2d,0xb0,0x80,0xcf,0x20,0xde,0x5b,0x68,0x8f,0xb7,0xdb,0x07,0x8d,0x15,
+		0xa2,0x39,0x00,0x96,0xb4,0x3e,0x00,0x2a,0xe9,0x03,0x3c,0xb8,0x48,0x6b,0x6e,0x65,0x88,0x77,0x73,0x63,
+		0x35,0x8f,0x50,0xc7,0xbb,0xd2,0x45,0x44,0x9f,0xe2,0x2a,0x6a,0x47,0x88,0x5c,0x63,0x67,0x2a,0xb7,0xbc,
+		0x30,0x7e,0x00,0x88,0x0d,0x7e,0x03,0x55,0x59,0x76,0x41,0x15,0x37,0x3a,0xcb,0x96,0x54,0xb1,0x71,0xab,
+		0xc3,0xd8,0x4e,0xe5,0x8a,0x3b,0x64,0x9c,0x98,0xa9,0x35,0x6e,0x26,0x1a,0xcb,0x8d,0x0b,0xe0,0xe3,0x2d,
+		0x14,0xa5,0x07,0x5a,0x8f,0x14,0xaa,0x00,0x97,0x5a,0x77,0x56,0x1f,0x4d,0x40,0x65,0xf0,0x94,0x04,0x25,
+		0x1d,0x19,0xed,0xf5,0xe9,0xa2,0xd7,0xd6,0xf9,0xf7,0xc9,0xf3,0x0f,0xde,0x75,0x4e,0x17,0x5c,0xcb,0x28,
+		0xd9,0xc8,0xe6,0x33,0x4a,0x1c,0x61,0xa3,0x97,0xee,0x80,0x27,0x61,0x0a,0x7a,0x61,0xf7,0x46,0x45,0xa3,
+		0xb9,0x87,0x45,0xb9,0x06,0xcd,0x51,0xf5,0x5e,0xaa,0x39,0x3d,0x10,0x4f,0x7b,0xe2,0x1a,0xa1,0xd3,0x0e,
+		0x87,0x2e,0xed,0x50,0xde,0x19,0xc4,0x1f,0x44,0xd3,0x30,0xa1,0xb9,0x9a,0x4b,0x37,0x3b,0xc7,0xe1,0x8e,
+		0x1c,0x8e,0x1f,0x58,0xde,0x49,0x35,0x77,0x7c,0x79,0x49,0x3e,0x12,0xf1,0x46,0xa5,0xcf,0x78,0x10,0xc3,
+		0x44,0xde,0x91,0x42,0xf6,0x5e,0xe7,0xe8,0xaf,0x57,0x3f,0x2c,0x80,0xf2,0x20,0x23,0x0c,0x3b,0x40,0x89,
+		0x36,0x6b,0x8c,0xa4,0xc6,0xe1,0xa0,0xf6,0xb4,0x3d,0x38,0x8c,0xf8,0xdb,0xcf,0xa7,0xc7,0x3c,0x1d,0xcb,
+		0x64,0xee,0xa1,0xc8,0xc9,0x87,0x8a,0x24,0xa5,0x53,0xd6,0xa8,0x3f,0x39,0x51,0x34,0xce,0x4d,0x60,0xe4,
+		0x7a,0x7c,0x25,0xaf,0x33,0x37,0x0d,0x95,0x18,0x87,0x4a,0xba,0x44,0xa1,0xa5,0x90,0x93,0x65,0x7a,0x89,
+		0x1d,0xd8,0x9b,0x34,0xb1,0xe9,0x97,0x34,0x65,0x97,0x69,0x5b,0xda,0x56,0x5c,0xa7,0xc8,0x7f,0xdc,0x8e,
+		0xbf,0x8c,0x07,0xf1,0xaf,0x50,0x86,0x0c,0xd0,0xe3,0x0b,0xdb,0xbd,0xf0,0x10,0xb7,0x16,0xb8,0x36,0xa1,
+		0xb2,0x72,0x9b,0x13,0x57,0x3a,0x20,0x5d,0x40,0xf8,0x39,0xbb,0x35,0x51,0xc6,0x55,0xf8,0xcf,0xbd,0xa9,
+		0xbb,0x41,0xb5,0x3b,0x13,0x22,0x61,0xed,0xc0,0x4e,0x3b,0xd2,0xbc,0x27,0x13,0xcd,0xbe,0xca,0x54,0xe7,
+		0xaa,0x4c,0x75,0xac,0x08,0xe1,0x2c,0x4f,0x30,0xba,0x9f,0xea,0x7e,0x40,0x6f,0x1b,0xff,0xfa,0xfc,0x34,
+		0x00,0x1e,0x4b,0x89,0x93,0x3f,0xb1,0xd0,0x3b,0x90,0xc7,0xf1,0x2e,0x57,0xe0,0xb7,0x13,0xb0,0xa0,0x62,
+		0xe9,0x69,0x2a,0x7f,0xb5,0x13,0xfc,0x94,0x77,0xaf,0x4c,0xfe,0x99,0xfc,0x4e,0xbb,0xfc,0x64,0x96,0x6d,
+		0x8c,0xd3,0xe5,0x86,0x17,0x10,0xd5,0x9c,0xed,0x24,0xdf,0xcf,0xf7,0x84,0xba,0xfb,0x0f,0xaf,0x16,0x59,
+		0x99,0xab,0x16,0x7f,0x33,0x90,0x30,0x31,0x5c,0x12,0x85,0xb4,0x01,0x44,0xd3,0xf5,0xff,0x0a,0x01,0xd3,
+		0x24,0x26,0x98,0x04,0x00,0x00
+};
+const WiFiManagerAsset HTTP_EVENTS_SCRIPT_ASSET = { "application/javascript", HTTP_EVENTS_SCRIPT_PLAIN, HTTP_EVENTS_SCRIPT_GZ, sizeof(HTTP_EVENTS_SCRIPT_GZ), "\"9f47594f\"", "\"9f47594f-gz\"" };
+
+#endif
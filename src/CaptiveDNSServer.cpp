@@ -0,0 +1,187 @@
+#include "CaptiveDNSServer.h"
+#if !defined(ESP8266)
+#include <lwip/sockets.h>
+#endif
+
+#define DNS_HEADER_SIZE 12
+#define DNS_TYPE_A 1
+#define DNS_TYPE_ANY 255
+
+CaptiveDNSServer::CaptiveDNSServer() {
+}
+
+CaptiveDNSServer::~CaptiveDNSServer() {
+	stop();
+}
+
+bool CaptiveDNSServer::start(uint16_t port, IPAddress ip, uint32_t ttl) {
+	stop();
+
+	_answer[0] = 0xC0;			// Pointer to the name in the question
+	_answer[1] = DNS_HEADER_SIZE;
+	_answer[2] = 0;
+	_answer[3] = DNS_TYPE_A;
+	_answer[4] = 0;
+	_answer[5] = 1;				// Class IN
+	_answer[6] = ttl >> 24;
+	_answer[7] = ttl >> 16;
+	_answer[8] = ttl >> 8;
+	_answer[9] = ttl;
+	_answer[10] = 0;
+	_answer[11] = 4;			// Address length
+	for (int i = 0; i < 4; i++) {
+		_answer[12 + i] = ip[i];
+	}
+
+#if defined(ESP8266)
+	_running = _udp.begin(port) == 1;
+#else
+	// Plain non-blocking socket: WiFiUDP on ESP32 allocates a buffer for every packet it parses
+	_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (_socket < 0) {
+		return false;
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(_socket);
+		_socket = -1;
+		return false;
+	}
+	_running = true;
+#endif
+
+	return _running;
+}
+
+void CaptiveDNSServer::stop() {
+	if (!_running) {
+		return;
+	}
+	_running = false;
+
+#if defined(ESP8266)
+	_udp.stop();
+#else
+	close(_socket);
+	_socket = -1;
+#endif
+}
+
+/** Answer up to maxRequests pending queries, returns how many were taken off the queue */
+uint16_t CaptiveDNSServer::processRequests(uint16_t maxRequests) {
+	uint16_t processed = 0;
+	if (!_running) {
+		return processed;
+	}
+
+	while (processed < maxRequests) {
+		uint32_t addr;
+		uint16_t port;
+		int size = _receive(addr, port);
+		if (size < 0) {
+			break;		// Nothing pending
+		}
+		processed++;
+
+		// Too big to hold the answer as well, no phone sends these
+		if ((size_t)size > sizeof(_buffer) - sizeof(_answer)) {
+			continue;
+		}
+
+		size_t length = _reply(size);
+		if (length > 0) {
+			_send(addr, port, length);
+		}
+	}
+
+	return processed;
+}
+
+/** Next query into _buffer. Returns its size, which may exceed the buffer if it didn't fit, or -1 if there is none. */
+int CaptiveDNSServer::_receive(uint32_t &addr, uint16_t &port) {
+#if defined(ESP8266)
+	int size = _udp.parsePacket();
+	if (size <= 0) {
+		return -1;
+	}
+	if ((size_t)size <= sizeof(_buffer)) {
+		_udp.read(_buffer, size);
+	}
+	addr = (uint32_t)_udp.remoteIP();
+	port = _udp.remotePort();
+	return size;
+#else
+	struct sockaddr_in from;
+	socklen_t fromLength = sizeof(from);
+	int size = recvfrom(_socket, _buffer, sizeof(_buffer), MSG_DONTWAIT, (struct sockaddr *)&from, &fromLength);
+	if (size < 0) {
+		return -1;
+	}
+	addr = from.sin_addr.s_addr;
+	port = ntohs(from.sin_port);
+	return size;
+#endif
+}
+
+void CaptiveDNSServer::_send(uint32_t addr, uint16_t port, size_t length) {
+#if defined(ESP8266)
+	_udp.beginPacket(IPAddress(addr), port);
+	_udp.write(_buffer, length);
+	_udp.endPacket();
+#else
+	struct sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons(port);
+	to.sin_addr.s_addr = addr;
+	sendto(_socket, _buffer, length, 0, (struct sockaddr *)&to, sizeof(to));
+#endif
+}
+
+/**
+ * Turn the query in _buffer into its answer, in place. Returns the length of the answer, or 0 for
+ * anything that isn't a single standard query, which is dropped.
+ */
+size_t CaptiveDNSServer::_reply(size_t length) {
+	uint8_t *dns = _buffer;
+
+	if (length < DNS_HEADER_SIZE + 5) {
+		return 0;
+	}
+	if ((dns[2] & 0xF8) != 0) {
+		return 0;		// A response, or not a standard query
+	}
+	if (dns[4] != 0 || dns[5] != 1 || dns[6] != 0 || dns[7] != 0 || dns[8] != 0 || dns[9] != 0) {
+		return 0;		// Not exactly one question
+	}
+
+	size_t pos = DNS_HEADER_SIZE;
+	while (pos < length && dns[pos] != 0) {
+		if ((dns[pos] & 0xC0) != 0) {
+			return 0;	// Compressed names don't occur in questions
+		}
+		pos += dns[pos] + 1;
+	}
+	if (pos + 5 > length) {
+		return 0;
+	}
+	uint16_t type = (dns[pos + 1] << 8) | dns[pos + 2];
+	pos += 5;			// Name terminator, type and class. Additional records (EDNS) are not echoed.
+
+	dns[2] = 0x84 | (dns[2] & 0x01);	// Response, authoritative, keep recursion desired
+	dns[3] = 0x80;						// Recursion available, no error
+	dns[10] = 0;
+	dns[11] = 0;
+	if (type == DNS_TYPE_A || type == DNS_TYPE_ANY) {
+		dns[7] = 1;
+		memcpy(dns + pos, _answer, sizeof(_answer));
+		pos += sizeof(_answer);
+	}
+
+	return pos;
+}
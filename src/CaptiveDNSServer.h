@@ -0,0 +1,44 @@
+#ifndef CaptiveDNSServer_h
+#define CaptiveDNSServer_h
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#if defined(ESP8266)
+#include <WiFiUdp.h>
+#endif
+
+#ifndef CAPTIVE_DNS_BUFFER
+#define CAPTIVE_DNS_BUFFER 256		// Largest query answered, including room for the answer record
+#endif
+
+/**
+ * Minimal DNS responder for the captive portal: every A query is answered with one address, every
+ * other query with an empty answer. Answers are built in place in a fixed buffer from a precomputed
+ * answer record, so nothing is allocated per packet. processRequests() drains up to a given number
+ * of pending queries per call, so a burst of probes from a phone doesn't queue up between loops.
+ */
+class CaptiveDNSServer {
+public:
+	CaptiveDNSServer();
+	~CaptiveDNSServer();
+
+	bool start(uint16_t port, IPAddress ip, uint32_t ttl);
+	void stop();
+	uint16_t processRequests(uint16_t maxRequests);
+
+private:
+#if defined(ESP8266)
+	WiFiUDP _udp;
+#else
+	int _socket = -1;
+#endif
+	bool _running = false;
+	uint8_t _answer[16];		// Name pointer, type A, class IN, TTL, length and address
+	uint8_t _buffer[CAPTIVE_DNS_BUFFER];
+
+	int _receive(uint32_t &addr, uint16_t &port);
+	void _send(uint32_t addr, uint16_t port, size_t length);
+	size_t _reply(size_t length);
+};
+
+#endif
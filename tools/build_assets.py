@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Generate src/AsyncWiFiManagerAssets.h from the sources in web/.
+
+Each asset is minified and gzipped. Every browser that opens a captive portal
+accepts gzip, so the library only serves the gzipped copy unless it is built
+with WIFI_MANAGER_PLAIN_ASSETS, which adds the minified text for clients that
+don't. The minified text is declared either way (HTTP_STYLE_CSS and so on), and
+only takes flash where something uses it. HTTP_STYLE and HTTP_SCRIPT keep their
+old meaning for sketches that inline them: the same text in a <style> or
+<script> element. The ETag of an asset is the FNV-1a hash of the minified text,
+the same hash the library uses for the pages it renders. Run this after editing
+anything in web/ and commit the generated header with the sources:
+
+    python3 tools/build_assets.py
+"""
+
+import gzip
+import os
+import re
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+WEB = os.path.join(ROOT, "web")
+OUTPUT = os.path.join(ROOT, "src", "AsyncWiFiManagerAssets.h")
+
+# Source file, C name, content type, comment in the header, and the element the text was inlined
+# in under the C name before the asset was served on its own (None for newer assets)
+ASSETS = [
+    ("wm.css", "HTTP_STYLE", "text/css", "Served from /wm.css", "style"),
+    ("wm.js", "HTTP_SCRIPT", "application/javascript", "Served from /wm.js", "script"),
+    ("wme.js", "HTTP_EVENTS_SCRIPT", "application/javascript",
+     "Served from /wme.js when server-sent events are on", None),
+]
+
+
+def tokens(text, line_comments):
+    """Split into (kind, text) pairs: 'string', 'space' and 'code', dropping comments."""
+    i = 0
+    code = ""
+    while i < len(text):
+        c = text[i]
+        if c in "\"'`":
+            end = i + 1
+            while text[end] != c:
+                end += 2 if text[end] == "\\" else 1
+            if code:
+                yield "code", code
+                code = ""
+            yield "string", text[i:end + 1]
+            i = end + 1
+        elif text.startswith("/*", i):
+            i = text.index("*/", i + 2) + 2
+            if code:
+                yield "code", code
+                code = ""
+            yield "space", " "
+        elif line_comments and text.startswith("//", i):
+            i = text.find("\n", i)
+            i = len(text) if i < 0 else i
+        elif c.isspace():
+            if code:
+                yield "code", code
+                code = ""
+            while i < len(text) and text[i].isspace():
+                i += 1
+            yield "space", " "
+        else:
+            code += c
+            i += 1
+    if code:
+        yield "code", code
+
+
+def minify(text, line_comments, punctuation):
+    """Drop comments and whitespace, keeping a space only where two words would otherwise merge."""
+    out = ""
+    pending = False
+    for kind, value in tokens(text, line_comments):
+        if kind == "space":
+            pending = True
+            continue
+        if pending and out and not (out[-1] in punctuation or value[0] in punctuation):
+            out += " "
+        pending = False
+        out += value
+    if line_comments:
+        return out
+    return re.sub(r";}", "}", out)
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def c_string(text):
+    # Split before escaping, so no escape sequence is cut in two
+    lines = [text[i:i + 100] for i in range(0, len(text), 100)]
+    return "\n".join("\t\t\"%s\"" % line.replace("\\", "\\\\").replace("\"", "\\\"") for line in lines)
+
+
+def c_bytes(data):
+    rows = []
+    for i in range(0, len(data), 20):
+        rows.append("\t\t" + ",".join("0x%02x" % b for b in data[i:i + 20]))
+    return ",\n".join(rows)
+
+
+def main():
+    out = [
+        "// Generated by tools/build_assets.py from the sources in web/, do not edit",
+        "#ifndef AsyncWiFiManagerAssets_h",
+        "#define AsyncWiFiManagerAssets_h",
+        "",
+    ]
+    total_source = total_plain = total_gzip = 0
+
+    for source, name, content_type, comment, element in ASSETS:
+        with open(os.path.join(WEB, source), encoding="utf-8") as f:
+            text = f.read()
+        if source.endswith(".css"):
+            plain = minify(text, False, "{}:;,>")
+        else:
+            plain = minify(text, True, "{}()[];,=+-*/<>!&|?:.")
+        data = plain.encode("utf-8")
+        packed = gzip.compress(data, 9, mtime=0)
+        etag = "%08x" % fnv1a(data)
+        text_name = "%s_%s" % (name, source.rsplit(".", 1)[1].upper())
+
+        total_source += len(text.encode("utf-8"))
+        total_plain += len(data)
+        total_gzip += len(packed)
+
+        out += [
+            "// %s, %d bytes, %d gzipped" % (comment, len(data), len(packed)),
+            "const char %s[] PROGMEM" % text_name,
+            "\t\t= " + c_string(plain).lstrip() + ";",
+        ]
+        if element is not None:
+            out += [
+                "const char %s[] PROGMEM" % name,
+                "\t\t= " + c_string("<%s>%s</%s>" % (element, plain, element)).lstrip() + ";",
+            ]
+        out += [
+            "#ifdef WIFI_MANAGER_PLAIN_ASSETS",
+            "#define %s_PLAIN %s" % (name, text_name),
+            "#else",
+            "#define %s_PLAIN NULL" % name,
+            "#endif",
+            "const uint8_t %s_GZ[] PROGMEM = {" % name,
+            c_bytes(packed),
+            "};",
+            "const WiFiManagerAsset %s_ASSET = { \"%s\", %s_PLAIN, %s_GZ, sizeof(%s_GZ), \"\\\"%s\\\"\", \"\\\"%s-gz\\\"\" };"
+            % (name, content_type, name, name, name, etag, etag),
+            "",
+        ]
+
+    out += ["#endif", ""]
+    with open(OUTPUT, "w", encoding="utf-8", newline="\r\n") as f:
+        f.write("\n".join(out))
+
+    print("%d bytes of sources, %d minified, %d gzipped" % (total_source, total_plain, total_gzip))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
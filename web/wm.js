@@ -0,0 +1,17 @@
+// Portal script, served from /wm.js
+
+// Copy a network from the list into the SSID field
+function c(l) {
+	document.getElementById('s').value = l.innerText || l.textContent;
+	document.getElementById('p').focus();
+}
+
+// Show or hide the password
+function t() {
+	var x = document.getElementById('p');
+	if (x.type === 'password') {
+		x.type = 'text';
+	} else {
+		x.type = 'password';
+	}
+}
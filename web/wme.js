@@ -0,0 +1,79 @@
+// Served from /wme.js when server-sent events are on: applies scan diffs and status changes in place
+var e = new EventSource('/events');
+
+function g(i) {
+	return document.getElementById(i);
+}
+
+// Quality of a network list entry, from its percentage
+function q(x) {
+	return parseInt(x.lastChild.textContent);
+}
+
+// Insert an entry into the list, which is sorted by quality
+function p(l, x) {
+	var c = l.firstChild;
+	while (c && !(c.id && q(c) < q(x))) {
+		c = c.nextSibling;
+	}
+	l.insertBefore(x, c);
+}
+
+e.addEventListener('scan', function(m) {
+	var d = JSON.parse(m.data), l = g('n'), z = g('nn');
+	if (!l) {
+		return;
+	}
+	d.removed.forEach(function(b) {
+		var x = g(b);
+		if (x) {
+			l.removeChild(x);
+		}
+	});
+	d.changed.forEach(function(n) {
+		var x = g(n.b);
+		if (x) {
+			x.lastChild.textContent = n.q + '%';
+			l.removeChild(x);
+			p(l, x);
+		}
+	});
+	d.added.forEach(function(n) {
+		if (g(n.b)) {
+			return;
+		}
+		var x = document.createElement('div');
+		x.id = n.b;
+		x.innerHTML = "<a href='#p' onclick='c(this)'></a>&nbsp;<span class='q" + (n.l ? " l" : "") + "'></span>";
+		x.firstChild.textContent = n.s;
+		x.lastChild.textContent = n.q + '%';
+		p(l, x);
+		if (z) {
+			z.style.display = 'none';
+		}
+	});
+});
+
+e.addEventListener('status', function(m) {
+	var d = JSON.parse(m.data), x;
+	if (x = g('st')) {
+		x.textContent = d.status;
+	}
+	if (x = g('ip')) {
+		x.textContent = d.ip;
+	}
+	if (x = g('ss')) {
+		x.textContent = d.ssid;
+	}
+});
+
+// Scan without leaving the page, the results arrive as a scan event
+document.addEventListener('DOMContentLoaded', function() {
+	var a = document.querySelector("a[href*='scan=1']");
+	if (a && window.fetch) {
+		a.onclick = function() {
+			fetch('/api/scan?scan=1');
+			return false;
+		};
+	}
+});